@@ -36,6 +36,11 @@ def main():
     parser.add_argument(
         "--static", action="store_true", help="Link libraries statically"
     )
+    parser.add_argument(
+        "--latency-stats",
+        action="store_true",
+        help="Record keystroke latency histograms (F2 overlay, report on exit)",
+    )
     parser.set_defaults(palloc_treap_nodes=True)
     parser.add_argument(
         "--palloc-treap-nodes",
@@ -101,6 +106,7 @@ def main():
         f"-DMINIEDITOR_STATIC_LINKING={'ON' if args.static else 'OFF'}",
         f"-DMINIEDITOR_USE_PALLOC_FOR_TREAP_NODES={'ON' if args.palloc_treap_nodes else 'OFF'}",
         f"-DMINIEDITOR_PALLOC_SINGLE_THREADED={'ON' if args.palloc_single_threaded else 'OFF'}",
+        f"-DMINIEDITOR_ENABLE_LATENCY_STATS={'ON' if args.latency_stats else 'OFF'}",
     ]
 
     # Generator selection: Prefer Ninja if available, else let CMake decide
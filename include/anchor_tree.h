@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace AL
+{
+
+using anchor_id = uint32_t;
+
+/*
+ * Positions that move with edits (bookmarks, selections, search hits, diagnostics).
+ *
+ * A treap over the anchors in document order where every node stores the gap to
+ * the anchor before it instead of its position. An insert only grows the gap of
+ * the first anchor after it, and a remove collapses the anchors inside the range
+ * with a lazy tag, so every edit is O(log k) no matter how many anchors move.
+ * Parent links let an anchor find its position by summing gaps up to the root.
+ *
+ * An anchor right at an insert stays before the inserted text.
+ * Anchors inside a removed range end up where the range started.
+ */
+class anchor_tree
+{
+public:
+    anchor_tree() = default;
+
+    anchor_id add(size_t position);
+    void remove(anchor_id id);
+    void clear();
+
+    size_t get_position(anchor_id id) const;
+    size_t size() const
+    {
+        return m_count;
+    }
+
+    // keep the anchors in step with the text
+    void on_insert(size_t position, size_t length);
+    void on_remove(size_t position, size_t length);
+
+private:
+    constexpr static uint32_t NIL = UINT32_MAX;
+
+    struct node
+    {
+        size_t gap; // from the anchor before (or from 0)
+        size_t sum; // of the gaps in the subtree
+        uint64_t priority;
+        uint32_t count; // anchors in the subtree
+        uint32_t left;
+        uint32_t right;
+        uint32_t parent;
+        bool collapse; // the children's gaps are all 0 but have not been told yet
+    };
+
+    std::vector<node> m_nodes; // indexed by anchor_id
+    std::vector<anchor_id> m_free;
+    uint32_t m_root = NIL;
+    size_t m_count = 0;
+    uint64_t m_seed = 0x9e3779b97f4a7c15ULL;
+
+    size_t get_sum(uint32_t n) const
+    {
+        return n == NIL ? 0 : m_nodes[n].sum;
+    }
+    uint32_t get_count(uint32_t n) const
+    {
+        return n == NIL ? 0 : m_nodes[n].count;
+    }
+
+    uint64_t next_priority();
+    void collapse(uint32_t n); // every gap in the subtree becomes 0
+    void push(uint32_t n);
+    void update(uint32_t n);
+    uint32_t merge(uint32_t l, uint32_t r);
+
+    // l gets the anchors before position (at or before when inclusive), base is the position the subtree's gaps start from
+    void split(uint32_t n, size_t position, bool inclusive, size_t base, uint32_t& l, uint32_t& r);
+    void split_by_rank(uint32_t n, size_t rank, uint32_t& l, uint32_t& r); // l gets the first rank anchors
+    void add_to_first_gap(uint32_t n, size_t delta); // delta wraps, so it can also shrink the gap
+};
+
+} // namespace AL
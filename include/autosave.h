@@ -0,0 +1,69 @@
+#pragma once
+
+#include "piecetable.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace AL
+{
+
+/*
+ * Recovery autosave: a full copy of the document in a sidecar file (<name>.autosave),
+ * written by a thread of its own so a dropped session loses at most one interval of work.
+ *
+ * The editor hands it frozen documents (piece_table::freeze) from its idle tick, never
+ * from an edit. The thread writes the text to <sidecar>.tmp and renames it over the
+ * sidecar, so the sidecar always holds a whole document.
+ *
+ * Writing is held to a budget of bytes per second (a token bucket with one second of
+ * burst), so autosaving a large file trickles out instead of competing with the disk
+ * traffic of everything else. A write that is cancelled stops at the next slice.
+ */
+class autosaver
+{
+public:
+    autosaver();
+    ~autosaver(); // cancels the write in progress and stops the thread
+
+    autosaver(const autosaver&) = delete;
+    autosaver& operator=(const autosaver&) = delete;
+
+    // starts writing document to path. the document must stay frozen until is_idle.
+    // false if the last write is not finished
+    bool write(const std::filesystem::path& path, const frozen_document& document);
+
+    // abandons the write in progress (the sidecar keeps its old contents) and waits for the thread to let go of the document
+    void cancel();
+
+    bool is_idle() const;   // nothing is being written, the last document can be thawed
+    bool succeeded() const; // whether the last write reached the sidecar
+
+    void set_budget(size_t bytes_per_second); // 0 writes as fast as it can
+
+private:
+    // writes at most this much between two looks at the budget and at cancel
+    constexpr static size_t m_slice_length = 256 * 1024;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+    bool m_stop = false;
+    bool m_busy = false;
+    bool m_cancelled = false;
+    bool m_succeeded = false;
+    size_t m_budget = 0;
+    const frozen_document* m_document = nullptr;
+    std::filesystem::path m_path;
+
+    void run();
+    bool write_document(const std::filesystem::path& path, const frozen_document& document, size_t budget);
+
+    // blocks until length bytes fit the budget. false if the write was cancelled meanwhile
+    bool wait_for_budget(size_t length, size_t budget, double& tokens, std::chrono::steady_clock::time_point& refilled);
+};
+
+} // namespace AL
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+namespace AL
+{
+
+// vectorized byte scans over raw buffers.
+// SSE2 on x86/x64, plain loops everywhere else
+
+// number of bytes equal to c in [data, data + length)
+size_t count_byte(const char* data, size_t length, char c);
+
+// last byte equal to c in [data, data + length), or nullptr
+const char* rfind_byte(const char* data, size_t length, char c);
+
+// inclusive range of byte values
+struct byte_range
+{
+    unsigned char lo;
+    unsigned char hi;
+};
+
+// first byte in [data, data + length) that falls in any of the ranges, or nullptr.
+// meant for a handful of ranges, each one costs two instructions per 16 bytes
+const char* find_byte_in_ranges(const char* data, size_t length, const byte_range* ranges, size_t range_count);
+
+} // namespace AL
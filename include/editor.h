@@ -1,12 +1,23 @@
 #pragma once
 
+#include "autosave.h"
+#include "file_loader.h"
+#include "journal.h"
 #include "piecetable.h"
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 namespace AL
 {
 
+class regex;
+
 enum class direction : uint8_t
 {
     UP,
@@ -15,6 +26,15 @@ enum class direction : uint8_t
     RIGHT,
 };
 
+// what editor::poll_save found
+enum class save_status : uint8_t
+{
+    NONE,    // no background save
+    RUNNING, // still writing
+    DONE,    // finished and renamed over the file, reported once
+    FAILED,  // the file was left alone and the document is dirty again, reported once
+};
+
 struct cursor
 {
     size_t global_index;
@@ -29,6 +49,7 @@ struct cursor
         global_index = 0;
         row = 1;
         col = 1;
+        col_internal = 1;
     }
 
     cursor()
@@ -46,12 +67,45 @@ struct cursor
  * - Session state tracking (cursor position, view state)
  * - Text manipulation and editing operations
  *
- * Uses batching for insertions but not for deletions.
+ * Uses batching for insertions and deletions.
  * Batched insertions will be 512 bytes max at a time.
  * If the user types more, then the buffer gets flushed.
+ * Consecutive backspaces on one line are coalesced the same way
+ * and removed with a single piece table call.
+ *
+ * Pasted text (insert_text) does not use the insertion buffer.
+ * It is inserted as a single piece and the cursor is moved past it
+ * using only the newline count and the length of its last line.
+ *
+ * Extra cursors (multi cursor editing) type and backspace along with the main one.
+ * Every cursor types the same thing, so the pending text is kept once and cursor i
+ * is at its base plus (i + 1) times its length: a key costs O(1) however many
+ * cursors there are. Like the insertion buffer it never holds a line break, and
+ * it is flushed as one sorted batch (piece_table::apply_edits) by a newline,
+ * cursor movement and other commands. The tui draws it over the lines.
+ * Other edits (paste, range deletes, replace) drop the extra cursors.
+ *
+ * The clipboard holds pieces, not text (piece_table::copy_range), so copying,
+ * cutting and pasting cost the same for a word as for a gigabyte.
+ *
+ * save_async writes the file on a worker thread. The document is frozen as its
+ * piece list (piece_table::freeze), so starting one costs O(n) for n pieces and
+ * editing goes on while the bytes are written. Anything that replaces the piece
+ * table (open, quit) or writes the file itself (save) waits for it first.
+ *
+ * Autosave (set_autosave) works the same way from the idle loop: a changed
+ * document is frozen and copied to <name>.autosave by the autosaver's thread
+ * within an I/O budget. Edits never wait on it. open() reports a copy left
+ * behind by a session that died (has_recovery).
+ *
+ * begin_open streams the file in (file_loader): it returns once the first chunk
+ * is in and the rest is appended as it arrives (poll_load). Edits work on what
+ * is there. Whatever needs the whole file (saving, searching, sorting, the end
+ * of the document) waits for the rest.
  *
- * Any paste action (not implemented yet) will not use the
- * insertion buffer but will just be directly inserted.
+ * A file whose first line ends in "\r\n" stays a CRLF document: its '\r' are
+ * kept, typed newlines go in as "\r\n" and the cursor steps over a line break
+ * as one character, so saving writes the untouched lines back as they were.
  *
  */
 class editor
@@ -59,15 +113,111 @@ class editor
 public:
     editor();
     ~editor();
+    editor(const editor&) = delete; // owns the original file's descriptor
+    editor& operator=(const editor&) = delete;
 
-    bool open(const std::filesystem::path& path);
+    bool open(const std::filesystem::path& path); // begin_open and wait_for_load
     bool save();
     bool save(const std::filesystem::path& path);
 
+    // opens the file and returns once its first chunk is read. the rest is read on a thread and goes in with poll_load
+    // (from the idle loop). a file with a session snapshot or a journal next to it is read in full right here
+    bool begin_open(const std::filesystem::path& path);
+    bool poll_load();                 // appends what was read since. true while there is more to come
+    bool wait_for_load();             // blocks until all of it is in. false if it could not be read (the document is then empty)
+    bool is_loading() const;
+    size_t get_load_progress() const; // bytes read so far
+    size_t get_load_length() const;
+
+    // saves on a worker thread while editing goes on. a save that only patches the file in place is done right here.
+    // false if the save could not be started (one is already running, the path is not a file)
+    bool save_async();
+    bool save_async(const std::filesystem::path& path);
+    save_status poll_save();          // finishes a save the worker is done with (renames the file, moves the journal)
+    bool wait_for_save();             // blocks until the running save is finished. true if it worked or none was running
+    bool is_saving() const;
+    size_t get_save_progress() const; // bytes of the running save written so far
+    size_t get_save_length() const;   // bytes it writes in all
+
     void insert_char(char c);
-    void delete_char(); // deletes BEFORE the cursor (backspace)
+    void insert_text(std::string_view text); // paste. inserts at the cursor and moves the cursor past the text
+    void delete_char();                        // deletes BEFORE the cursor (backspace)
+    void delete_range(size_t begin, size_t end); // deletes [begin, end) in global indices
     void move_cursor(direction dir);
 
+    // jumps. each one costs a couple of tree descents no matter how far the cursor travels
+    void goto_line(size_t line_number); // 1-indexed. clamped to the document. keeps the remembered column like UP/DOWN
+    void move_page_up(size_t page_height);
+    void move_page_down(size_t page_height);
+    void move_to_line_start();
+    void move_to_line_end();
+    void move_to_document_start();
+    void move_to_document_end();
+    void set_cursor_to_index(size_t global_index); // e.g. a search hit or a compiler error offset. clamped to the document
+
+    // moves the cursor to the next/previous match of pattern, wrapping around the document.
+    // returns false (and leaves the cursor alone) if there is no match at all
+    bool find_next(std::string_view pattern);
+    bool find_prev(std::string_view pattern);
+    bool find_next(const regex& pattern);
+    bool find_prev(const regex& pattern);
+
+    // replaces every non overlapping match of pattern in one pass over the pieces. returns how many were replaced.
+    // the cursor keeps its place in the text around it (a cursor inside a match moves to where the match was)
+    size_t replace_all(std::string_view pattern, std::string_view replacement);
+
+    // sorts the lines of the whole file on the shared thread pool (see piece_table::sort_lines).
+    // the cursor stays on its row, at the start of whatever line is there now. returns the number of lines left
+    size_t sort_lines(bool unique = false);
+
+    // applies a sorted batch of edits (see piece_table::apply_edits) and marks the file dirty once.
+    // edits that end at or before the cursor shift it, a cursor inside a deleted range moves to its start
+    bool apply_edits(const std::vector<text_edit>& edits);
+
+    // multi cursor editing. typing and backspace then happen at the main cursor and at every extra cursor
+    void add_cursor(size_t global_index); // clamped to the document. ignored if a cursor is already there
+    void add_cursor_below();              // leaves an extra cursor here and moves down a line (column editing)
+    void clear_extra_cursors();
+    size_t get_cursor_count() const;                // including the main cursor
+    std::vector<size_t> get_cursor_indices() const; // every cursor in order, text that is still pending included
+    void flush_cursor_batch();                      // writes the text typed at the cursors to the piece table
+
+    // clipboard. [begin, end) in global indices, pasted at the cursor, which moves past it.
+    // paste returns false if the clipboard was copied from a file that has since been closed
+    void copy_range(size_t begin, size_t end);
+    void cut_range(size_t begin, size_t end);
+    bool paste();
+    size_t get_clipboard_length() const;
+
+    // edit journal next to the file (<name>.journal), so unsaved edits survive a crash (see journal).
+    // starts on a saved file. open() replays a journal it finds and keeps it going, save() starts it over
+    bool start_journal(journal_sync sync = journal_sync::INTERVAL);
+    void stop_journal(); // and removes it
+    bool is_journaling() const;
+
+    // session snapshot next to the file (<name>.session, see snapshot.h). open() restores the document and the cursor
+    // from it while the file is unchanged, in time proportional to the pieces. save() and quit() drop it
+    bool save_session();
+
+    // recovery autosave to <name>.autosave (see autosaver), off until this is called with an interval above 0.
+    // bytes_per_second limits how fast a copy is written (0 for no limit)
+    void set_autosave(std::chrono::milliseconds interval, size_t bytes_per_second);
+    void autosave_tick();       // from the idle loop. starts a copy when the interval is up and the document changed since the last one
+    bool is_autosaving() const; // a copy is being written
+
+    // an autosave open() found next to the file, left by a session that did not save or quit.
+    // recover() makes it the document (dirty, the file is untouched), discard_recovery() removes it.
+    // autosave waits until one of them is called
+    bool has_recovery() const;
+    bool recover();
+    void discard_recovery();
+
+    // marks that move with the text (bookmarks, diagnostics, ...). pending typing is flushed first so they are exact
+    anchor_id add_anchor(size_t global_index);
+    void remove_anchor(anchor_id id);
+    size_t get_anchor_index(anchor_id id);
+    text_position get_anchor_position(anchor_id id);
+
     size_t get_total_lines() const;
     size_t get_cursor_row() const; // 1-indexed
     size_t get_cursor_col() const; // 1-indexed
@@ -75,7 +225,11 @@ public:
     std::string get_filename() const;
     std::string get_line(size_t line_number) const; // refers to the 1-indexed line number
     const std::string& get_insert_buffer() const;
+    size_t get_delete_buffer_length() const; // pending backspaces. the batch starts at the cursor
     size_t get_insert_buffer_start_col() const; // returns the column where insert buffer starts (1-indexed), or 0 if buffer is empty
+    const std::string& get_cursor_batch_text() const; // text typed at every cursor, not yet in the piece table
+    // 1-indexed columns of the line, as the piece table has it, where the batch text goes. ascending
+    void get_cursor_batch_columns(size_t line_number, std::vector<size_t>& cols) const;
 
 private:
     piece_table m_piece_table;
@@ -91,6 +245,78 @@ private:
     std::string m_insert_buffer; // the temporary insert buffer
     size_t m_insert_position;    // the global index where the text in the insert buffer is inserted into the piece table
 
+    // pending backspaces. never crosses a newline so it always covers [cursor, cursor + m_delete_length) on the cursor line
+    constexpr static size_t m_max_delete_buffer_length = 512;
+    size_t m_delete_length;
+
+    // extra cursors, sorted. while a batch is pending they are stale and the batch has them
+    std::vector<size_t> m_extra_cursors;
+
+    piece_range m_clipboard;
+
+    journal m_journal;
+    journal_sync m_journal_sync = journal_sync::INTERVAL;
+
+    // the running background save. the worker writes m_save_document to <m_save_path>.tmp and sets m_save_finished,
+    // finish_save renames it on this thread. edits made meanwhile set m_dirty again
+    std::thread m_save_thread;
+    std::atomic<bool> m_save_finished{false};
+    std::atomic<size_t> m_save_written{0};
+    bool m_save_succeeded = false; // set by the worker before m_save_finished
+    frozen_document m_save_document;
+    std::filesystem::path m_save_path;
+    uint64_t m_save_journal_checkpoint = 0; // the journal records after this are not in the file being written
+    bool finish_save();                     // joins the worker and puts the file in place
+
+    std::chrono::milliseconds m_autosave_interval{0};
+    std::chrono::steady_clock::time_point m_last_autosave;
+    frozen_document m_autosave_document; // frozen while m_autosave_running
+    bool m_autosave_running = false;
+    uint64_t m_autosave_version = 0;           // piece_table::get_version of the copy being written
+    uint64_t m_autosaved_version = UINT64_MAX; // and of the one in the sidecar, if any
+    bool m_has_recovery = false;
+    autosaver m_autosaver; // after what its thread reads, so it stops first
+
+    // streaming open (begin_open). the loader's thread writes into the piece table's original buffer
+    file_loader m_loader;
+    std::vector<piece> m_loaded_pieces; // reused by poll_load
+    bool m_loading = false;
+    bool m_load_failed = false;
+    void finish_load(); // once the loader is done: the file descriptor, the buffer's length
+    void stop_loading(); // cancels the loader, the document keeps what it has
+    void finish_autosave(); // thaws the document once the autosaver is done with it
+    void stop_autosave();   // cancels a copy in progress, the sidecar stays
+    void drop_autosave();   // and removes the sidecar, the file is the document now
+    void on_saved();         // drops the session and starts the journal over for the file as it is now
+    bool is_file_original() const; // whether the file on disk is still the original buffer byte for byte
+
+#if MINIEDITOR_POSIX_IO
+    // the file the original buffer was read from, kept open so a save can copy the unchanged parts from it in the kernel
+    // (piece_table::write_to_fd). -1 when there is none, or when the buffer is not the file byte for byte ('\r' stripped).
+    // it still holds the old text after a save renames a new file over the path
+    int m_original_fd = -1;
+    int m_loading_fd = -1; // becomes m_original_fd when a streaming open finishes with the file unchanged
+    int64_t m_original_size = 0;
+    int64_t m_original_mtime_ns = 0; // if the size or this changes, someone else wrote to the file and it is not used
+    void close_original_file();
+    int get_original_fd() const; // -1 unless the file is still what was read, or what the in place saves made of it
+
+    // saves that changed at most this many bytes, and not the length, patch the file in place (save_in_place)
+    constexpr static size_t m_max_in_place_save_length = 16 * 1024 * 1024;
+    std::vector<text_range> m_disk_patches; // written into the original file in place, it differs from the original buffer there
+
+    // pwrites the changed ranges into the original file, after putting them in a write-ahead log next to it.
+    // false, leaving the file as it was, if it does not apply or fails (then save rewrites the whole file)
+    bool save_in_place();
+#endif
+
+    // pending multi cursor batch: every cursor (the main one too) and the text typed at all of them since the last flush.
+    // cursor i is at m_batch_bases[i] + (i + 1) * m_batch_text.length()
+    std::vector<size_t> m_batch_bases;
+    std::string m_batch_text;
+    size_t m_batch_main;             // the main cursor's index in the batch
+    size_t m_batch_same_line_before; // cursors before the main one on its line, their typing moves its column too
+
     // handles closing the file for i/o gracefully
     // return true for quitting successfully
     // force quitting means data loss.
@@ -99,6 +325,8 @@ private:
 public:
 #endif
     void flush_insert_buffer();
+    void flush_delete_buffer();
+    void flush_buffers(); // both of the above
 
 private:
     // cursor movement helpers
@@ -106,5 +334,14 @@ private:
     void handle_cursor_down();
     void handle_cursor_left();
     void handle_cursor_right();
+
+    // moves the cursor to the row, clamping the remembered column to the line length
+    void place_cursor_on_line(size_t row);
+    size_t outside_line_break(size_t global_index) const; // an index between '\r' and '\n' moves in front of the '\r'
+
+    // multi cursor versions of insert_char and delete_char
+    void begin_cursor_batch();
+    void insert_char_at_cursors(char c);
+    void delete_char_at_cursors();
 };
 } // namespace AL
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "piecetable.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AL
+{
+
+/*
+ * Streaming open: a thread reads a file chunk by chunk into a buffer sized for all of it
+ * (piece_table::begin_original), strips the '\r' of each chunk in place and cuts it into
+ * ORIGINAL pieces with their newline counts, spread over the shared thread pool
+ * (piece_table::load_original).
+ *
+ * The editor takes the pieces of the chunks that are done (take_pieces) and appends them
+ * to the document, so the first screen shows once the first chunk is in instead of once
+ * the whole file is. Bytes the thread is still writing are past every piece handed out.
+ *
+ * Stripped partitions of a chunk leave their last bytes unused, the pieces skip over them.
+ * A file whose first line ends in "\r\n" is a CRLF document and keeps every byte.
+ */
+class file_loader
+{
+public:
+    file_loader() = default;
+    ~file_loader(); // cancels
+
+    file_loader(const file_loader&) = delete;
+    file_loader& operator=(const file_loader&) = delete;
+
+    // starts reading size bytes of path into buffer, which must stay valid until is_done or cancel
+    bool start(const std::filesystem::path& path, char* buffer, size_t size);
+
+    // moves the pieces read since the last call to the end of out. true if there were any
+    bool take_pieces(std::vector<piece>& out);
+
+    // blocks until there are pieces to take or the read is over
+    void wait_for_pieces();
+
+    void cancel(); // stops after the chunk being read and waits for the thread
+
+    bool is_done() const; // the thread is finished (all of the file, an error, or cancelled)
+    bool failed() const;  // the file could not be read to its end
+    bool has_carriage_returns() const; // some '\r' were stripped, the buffer is not the file byte for byte
+    line_ending get_line_ending() const; // known once the first pieces are there
+    size_t get_bytes_read() const;
+    size_t get_size() const;
+
+private:
+    // big enough that a chunk is one cheap read, small enough that the first screen is there in a few milliseconds
+    constexpr static size_t m_chunk_length = 4 * 1024 * 1024;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ready_changed;
+    std::thread m_thread;
+    std::vector<piece> m_ready; // cut but not taken yet
+    bool m_done = false;
+    bool m_failed = false;
+    bool m_carriage_returns = false;
+    line_ending m_line_ending = line_ending::LF;
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<size_t> m_bytes_read{0};
+    size_t m_size = 0;
+
+    void run(std::filesystem::path path, char* buffer, size_t size);
+};
+
+} // namespace AL
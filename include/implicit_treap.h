@@ -69,6 +69,14 @@ struct node
     {}
 };
 
+// one edit of a batch, positioned in the tree as it was before the batch. an empty insert piece inserts nothing
+struct piece_edit
+{
+    size_t position;
+    size_t delete_length;
+    piece insert;
+};
+
 // concepts to restrict the callback to correct signature for the for_each function
 template<typename T>
 concept piece_callback = requires(T func, const piece& p) {
@@ -134,9 +142,11 @@ private:
     node* find(size_t index, node* current) const;
     void find_by_line(size_t line_number, node* current, node*& n, size_t& byte_offset) const;
     void find_by_byte(size_t index, node* current, node*& n, size_t& byte_offset) const;
+    void find_by_byte(size_t index, node* current, node*& n, size_t& byte_offset, size_t& newlines_before) const;
     void find_line_position(size_t target_line, node* current, size_t lines_before, node*& n, size_t& byte_offset, size_t& line_in_piece) const;
     void delete_nodes(node* n);
     node* copy_nodes(const node* n); // performs deep copy
+    node* build_nodes(const std::vector<piece>& pieces); // a new subtree holding pieces in order, O(n)
     void get_pieces(node* n, std::vector<piece>& pieces) const;
 
     // helper function allows you traverse through all nodes in the subtree of the specified node in in-order
@@ -193,6 +203,54 @@ private:
         return for_each_internal(current->right, std::forward<func_callback>(callback));
     }
 
+    // reverse in-order (right, node, left)
+    template<piece_callback func_callback>
+    bool for_each_reverse_internal(node* current, func_callback&& callback) const
+    {
+        if (!current)
+            return false;
+
+        if (for_each_reverse_internal(current->right, std::forward<func_callback>(callback)))
+            return true;
+
+        if (callback(current->data))
+            return true;
+
+        return for_each_reverse_internal(current->left, std::forward<func_callback>(callback));
+    }
+
+    // mirror of for_each_from_byte_internal. O(log n) skip to the piece containing end_byte - 1, then emit backwards from there
+    template<piece_callback func_callback>
+    bool for_each_reverse_before_byte_internal(node* current, size_t end_byte, size_t accum, func_callback&& callback) const
+    {
+        if (!current)
+            return false;
+
+        const size_t node_start = accum + get_subtree_length(current->left);
+        const size_t node_end = node_start + current->data.length;
+
+        if (end_byte <= node_start)
+        {
+            // this node and the right subtree are entirely at or after end_byte: skip both, go left
+            return for_each_reverse_before_byte_internal(current->left, end_byte, accum, std::forward<func_callback>(callback));
+        }
+
+        if (end_byte <= node_end)
+        {
+            // end_byte - 1 lands in this node's piece: skip right subtree, emit from here
+            if (callback(current->data))
+                return true;
+            return for_each_reverse_internal(current->left, std::forward<func_callback>(callback));
+        }
+
+        // end_byte - 1 is somewhere in the right subtree
+        if (for_each_reverse_before_byte_internal(current->right, end_byte, node_end, std::forward<func_callback>(callback)))
+            return true;
+        if (callback(current->data))
+            return true;
+        return for_each_reverse_internal(current->left, std::forward<func_callback>(callback));
+    }
+
 public:
     implicit_treap();
     ~implicit_treap();
@@ -207,6 +265,9 @@ public:
     void find_by_line(size_t line_number, node*& n, size_t& byte_offset) const;
     void find_by_byte(size_t index, node*& n, size_t& byte_offset) const;
 
+    // same as above, but also returns how many newlines are in the pieces before n
+    void find_by_byte(size_t index, node*& n, size_t& byte_offset, size_t& newlines_before) const;
+
     // find which node contains the start of target_line and return the line number relative to that piece
     // returns byte_offset to start of piece, and line_in_piece (1-indexed within piece)
     void find_line_position(size_t target_line, node*& n, size_t& byte_offset, size_t& line_in_piece) const;
@@ -217,6 +278,10 @@ public:
     void clear();
     void get_pieces(std::vector<AL::piece>& pieces) const;
 
+    // replaces the whole tree with pieces, in order, in O(n).
+    // much cheaper than n inserts when a lot of the document changes at once (e.g. replace all)
+    void build(const std::vector<AL::piece>& pieces);
+
     // allows you traverse through all nodes in in-order
     // and run a callback function on each of them
     // allows short-circuit with the return value
@@ -245,6 +310,14 @@ public:
         for_each_from_byte_internal(m_root, start_byte, 0, std::forward<func_callback>(callback));
     }
 
+    // Traverses in reverse in-order starting from the piece containing end_byte - 1,
+    // so the first piece emitted is the one holding the last byte before end_byte.
+    template<piece_callback func_callback>
+    void for_each_reverse_before_byte(size_t end_byte, func_callback&& callback) const
+    {
+        for_each_reverse_before_byte_internal(m_root, end_byte, 0, std::forward<func_callback>(callback));
+    }
+
     template<typename split_strategy>
     void insert(size_t index, const piece& value, split_strategy&& callback)
     {
@@ -258,6 +331,20 @@ public:
         m_root = merge(merge(l, new_node), r);
     }
 
+    // inserts pieces, in order, at index. they are built into their own subtree first,
+    // so k pieces cost O(k + log n) instead of k separate inserts
+    template<typename split_strategy>
+    void insert_pieces(size_t index, const std::vector<piece>& pieces, split_strategy&& callback)
+    {
+        node* subtree = build_nodes(pieces);
+        if (!subtree)
+            return;
+
+        node *l = nullptr, *r = nullptr;
+        split(m_root, index, l, r, std::forward<split_strategy>(callback));
+        m_root = merge(merge(l, subtree), r);
+    }
+
     template<typename split_strategy>
     void erase(size_t index, size_t length, split_strategy&& callback)
     {
@@ -271,6 +358,31 @@ public:
         m_root = merge(l, r);
     }
 
+    // applies sorted, non overlapping edits in one left to right sweep. the rest of the tree is split at each edit
+    // and the finished part is only ever merged on its right, so k edits cost O(k log n) with no index shifting
+    template<typename split_strategy>
+    void apply_edits(const std::vector<piece_edit>& edits, split_strategy&& callback)
+    {
+        node* done = nullptr;
+        node* rest = m_root;
+        size_t consumed = 0; // bytes of the old tree that are already in done or deleted
+
+        for (const piece_edit& e : edits)
+        {
+            node *kept, *removed;
+            split(rest, e.position - consumed, kept, rest, callback);
+            split(rest, e.delete_length, removed, rest, callback);
+            delete_nodes(removed);
+
+            done = merge(done, kept);
+            if (e.insert.length > 0)
+                done = merge(done, allocate_node(e.insert));
+            consumed = e.position + e.delete_length;
+        }
+
+        m_root = merge(done, rest);
+    }
+
     // callback should handle how the right node should be split
     // 1. Modify the original piece to become the "Left Half".
     // 2. Create and return a new piece that represents the "Right Half".
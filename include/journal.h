@@ -0,0 +1,119 @@
+#pragma once
+
+#include "piecetable.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace AL
+{
+
+// when appended records are forced to disk
+enum class journal_sync : uint8_t
+{
+    NONE,     // left to the kernel
+    INTERVAL, // with the first record after journal::m_sync_interval without a sync
+    ALWAYS,   // after every record
+};
+
+/*
+ * Append-only log of the edits made to a document since it was last saved.
+ *
+ * Every edit that reaches the piece table is appended as one small binary record
+ * (type, payload length, payload, checksum), so a record costs the size of the
+ * edit, not of the document. Clipboard copies and pastes are logged as positions,
+ * and sort_lines as just its flag, since replaying them gives the same result.
+ *
+ * The journal starts with the size and mtime of the file it applies to. Replaying
+ * it on top of that file rebuilds the document as it was, up to the last whole
+ * record, so a crash only loses what the kernel had not written yet.
+ *
+ * A failed write switches the journal off and removes it, since one lost record
+ * would make everything after it replay at the wrong place.
+ */
+class journal
+{
+public:
+    journal() = default;
+    ~journal();
+
+    journal(const journal&) = delete;
+    journal& operator=(const journal&) = delete;
+
+    // starts an empty journal at path for the file as it is now
+    bool create(const std::filesystem::path& path, uint64_t base_size, int64_t base_mtime_ns, journal_sync sync);
+
+    // replays the journal at path onto document, which must hold the file as it was read, then keeps appending to it.
+    // a torn record at the end is cut off. returns the records replayed, or -1 (and removes it) if the journal
+    // belongs to another version of the file or cannot be read
+    int64_t resume(const std::filesystem::path& path, uint64_t base_size, int64_t base_mtime_ns, piece_table& document, journal_sync sync);
+
+    void close();   // stops appending, the file stays for the next open
+    void discard(); // stops appending and removes the file
+    bool sync();    // forces what was appended to disk
+
+    // marks the document as it is now, for rebase. pastes are logged as text until the next copy,
+    // so the records after the mark replay without anything before it
+    uint64_t checkpoint();
+
+    // once the document as it was at the checkpoint is the file (base_size, base_mtime_ns), the journal moves to path
+    // with only the records after the checkpoint. it is written next to path and renamed over it
+    bool rebase(const std::filesystem::path& path, uint64_t checkpoint, uint64_t base_size, int64_t base_mtime_ns);
+
+    bool is_open() const
+    {
+        return m_file != nullptr;
+    }
+
+    const std::filesystem::path& get_path() const
+    {
+        return m_path;
+    }
+
+    // positions are in the document as it was just before the edit
+    void record_insert(size_t position, std::string_view text);
+    void record_remove(size_t position, size_t length);
+    void record_replace_all(const std::vector<size_t>& positions, size_t match_length, std::string_view replacement);
+    void record_edits(const std::vector<text_edit>& edits);
+    void record_sort_lines(bool unique);
+    void record_copy(size_t position, size_t length);
+    void record_paste(size_t position);
+
+    // whether the clipboard was copied since the journal started, so a paste can be logged as a position
+    bool has_clipboard() const
+    {
+        return m_has_clipboard;
+    }
+
+private:
+    enum class record_type : uint8_t
+    {
+        INSERT = 1,
+        REMOVE,
+        REPLACE_ALL,
+        EDITS,
+        SORT_LINES,
+        COPY,
+        PASTE,
+    };
+
+    constexpr static std::chrono::milliseconds m_sync_interval{1000};
+
+    std::FILE* m_file = nullptr;
+    std::filesystem::path m_path;
+    journal_sync m_sync = journal_sync::INTERVAL;
+    std::chrono::steady_clock::time_point m_last_sync;
+    std::string m_record; // reused for every record
+    uint64_t m_length = 0; // bytes in the file, header included
+    bool m_has_clipboard = false;
+
+    void begin_record(record_type type);
+    void end_record(); // checksums and appends m_record
+};
+
+} // namespace AL
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace AL
+{
+
+// operation types that get their own latency histogram
+enum class latency_op : uint8_t
+{
+    TICK,
+    HANDLE_INPUT,
+    RENDER,
+    REFRESH,
+    INSERT_CHAR,
+    DELETE_CHAR,
+    MOVE_CURSOR,
+    SAVE,
+    PT_INSERT,
+    PT_REMOVE,
+    PT_GET_LINE,
+    PT_REPLACE_ALL,
+    PT_APPLY_EDITS,
+    PT_PASTE_RANGE,
+    PT_SORT_LINES,
+    SEARCH,
+    COUNT
+};
+
+const char* latency_op_name(latency_op op);
+
+/*
+ * HDR-style latency histogram over nanosecond samples.
+ *
+ * Every power of two range is split into SUB_BUCKET_COUNT linear sub buckets,
+ * so recording is O(1) and any reported percentile is within ~3% of the real value.
+ * Values below SUB_BUCKET_COUNT * 2 are recorded exactly.
+ */
+class latency_histogram
+{
+public:
+    constexpr static size_t SUB_BUCKET_BITS = 5;
+    constexpr static size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+    constexpr static size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    latency_histogram();
+
+    void record(uint64_t ns);
+    void reset();
+
+    // p is in [0, 100]. returns 0 if nothing was recorded
+    uint64_t percentile(double p) const;
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    uint64_t mean() const;
+
+    static size_t bucket_index(uint64_t value);
+    static uint64_t bucket_highest_value(size_t index); // highest value that maps to the bucket
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> m_counts;
+    uint64_t m_count;
+    uint64_t m_min;
+    uint64_t m_max;
+    uint64_t m_total;
+};
+
+/*
+ * One histogram per latency_op.
+ * Only touched from the ui thread, so nothing here is synchronized.
+ */
+class latency_registry
+{
+public:
+    latency_histogram& get(latency_op op);
+    const latency_histogram& get(latency_op op) const;
+    bool empty() const;
+    void reset();
+
+    // one compact "name p50/p99/max" entry per op with samples, in microseconds. used by the status bar overlay
+    void write_summary(std::ostream& os) const;
+
+    // full table: count, min, mean, p50, p90, p99, p99.9, max for every op with samples
+    void write_report(std::ostream& os) const;
+
+private:
+    std::array<latency_histogram, static_cast<size_t>(latency_op::COUNT)> m_histograms;
+};
+
+latency_registry& get_latency_registry();
+
+// records the lifetime of the object into the histogram of op
+class scoped_latency_timer
+{
+public:
+    explicit scoped_latency_timer(latency_op op) : m_op(op), m_start(std::chrono::steady_clock::now())
+    {}
+
+    ~scoped_latency_timer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - m_start;
+        get_latency_registry().get(m_op).record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    scoped_latency_timer(const scoped_latency_timer&) = delete;
+    scoped_latency_timer& operator=(const scoped_latency_timer&) = delete;
+
+private:
+    latency_op m_op;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace AL
+
+// compiled out entirely unless MINIEDITOR_LATENCY_STATS is defined
+#if MINIEDITOR_LATENCY_STATS
+#define MINIEDITOR_LATENCY_CONCAT_INNER(a, b) a##b
+#define MINIEDITOR_LATENCY_CONCAT(a, b)       MINIEDITOR_LATENCY_CONCAT_INNER(a, b)
+#define MINIEDITOR_LATENCY_SCOPE(op)          AL::scoped_latency_timer MINIEDITOR_LATENCY_CONCAT(latency_timer_, __LINE__)(op)
+#else
+#define MINIEDITOR_LATENCY_SCOPE(op) ((void)0)
+#endif
@@ -1,34 +1,141 @@
 #pragma once
 
+#include "anchor_tree.h"
 #include "implicit_treap.h"
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MINIEDITOR_POSIX_IO 1
+#endif
 
 namespace AL
 {
 
+class thread_pool;
+
+// how lines end. a CRLF document keeps its "\r\n" byte for byte, and the '\r' counts as part of the line break
+enum class line_ending
+{
+    LF,
+    CRLF
+};
+
+// where a line lives in the document
+struct line_info
+{
+    size_t start_byte;  // global index of the first byte of the line
+    size_t length;      // bytes, without the line break
+    bool has_newline;   // false for the last line
+    size_t newline_length = 0; // 1 for "\n", 2 for "\r\n", 0 for the last line
+};
+
+// 1-indexed line and column of a byte
+struct text_position
+{
+    size_t line;
+    size_t col;
+};
+
+// one edit of a batch. position is in the document as it was before the batch
+struct text_edit
+{
+    size_t position;
+    size_t delete_length;
+    std::string_view insert_text; // inserted at position, after the deleted bytes are gone
+};
+
+// bytes [start, start + length) of the document
+struct text_range
+{
+    size_t start;
+    size_t length;
+};
+
+// a range of the document held as the pieces it is made of, not as text (see piece_table::copy_range).
+// the bytes stay in the buffers, which are only ever appended to, so the pieces stay valid.
+// only the piece_table that made it can paste it, and only until that table is cleared
+struct piece_range
+{
+    std::vector<piece> pieces;
+    size_t length = 0;
+    uint64_t buffer_id = 0; // which buffers the pieces point into
+};
+
+// the document at one moment, as its pieces in order and the buffers they point into (piece_table::freeze).
+// it can be read from any thread while the table goes on being edited, until piece_table::thaw
+struct frozen_document
+{
+    std::vector<piece> pieces;
+    std::string_view original;
+    std::string_view add; // as far as the add buffer went when it was frozen
+    size_t length = 0;
+};
+
 /*
  * Piece table created using an Implicit Treap
  */
 class piece_table
 {
 private:
-    std::string m_original_buffer;
+    // the text the document was loaded from. it is held by m_original_text when the table is built from a string, or by
+    // m_original_block when it is read in place (begin_original), which is never zero-filled before the file is read into it
+    std::string_view m_original_buffer;
+    std::string m_original_text;
+    std::unique_ptr<char[]> m_original_block;
     std::string m_add_buffer;
     AL::implicit_treap m_treap;
+    AL::anchor_tree m_anchors; // moved by every edit
+    uint64_t m_buffer_id;      // new whenever the buffers are replaced, so stale piece_ranges can be told apart
+
+    // while frozen documents are out (freeze), the add buffer never moves: when it has to grow the old storage
+    // is kept here, untouched, and let go when the last one is thawed
+    size_t m_buffer_pins = 0;
+    std::vector<std::string> m_retired_add_buffers;
+
+    // the original buffer is loaded as pieces of at most this many bytes
+    constexpr static size_t m_max_original_piece_length = 16 * 1024;
+
+    // load_original gives every thread at least this much, in whole pieces
+    constexpr static size_t m_min_load_partition_length = 1024 * 1024;
+
+    // shorter runs of ORIGINAL pieces are cheaper to write from memory than to copy with a syscall of their own
+    constexpr static size_t m_min_copy_file_range_length = 64 * 1024;
 
     // file reconstruction cache for to_string()
     mutable std::string m_cached_string;
     mutable bool m_needs_rebuild;
+    uint64_t m_version = 0; // goes up with every change to the document
+    line_ending m_line_ending = line_ending::LF;
 
-    // normalizes string IN PLACE
-    // replaces OS specific line endings with '\n'
-    // returns new lines ('\n') encountered while doing the pass
-    size_t normalize(std::string& text);
     size_t count_newlines(const piece& p) const;
     size_t count_newlines(const std::string& str) const;
 
+    // appends text to the add buffer (stripping '\r', and writing "\r\n" for '\n' in a CRLF document), returns where it starts
+    size_t append_to_add_buffer(std::string_view text, size_t& newline_count);
+    void reserve_add_buffer(size_t needed); // grows it by doubling, without moving bytes a frozen document points at
+    static uint64_t next_buffer_id();
+    void take_original(piece_table& other); // for the moves, the view follows the storage
+
+    std::string_view get_piece_view(const piece& p) const
+    {
+        return {(p.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer).data() + p.start, p.length};
+    }
+
+    // offset inside the piece just past its nth '\n' (1-indexed). p.length if there are fewer
+    size_t find_nth_newline(const piece& p, size_t nth) const;
+
+    // finds the line with one descent and scans forward to its '\n',
+    // passing every chunk of the line's content to on_segment along the way
+    template<typename segment_callback>
+    line_info scan_line(size_t line_number, segment_callback&& on_segment) const;
+
 #if MINIEDITOR_TESTING
 public:
 #endif // MINIEDITOR_TESTING
@@ -68,13 +175,64 @@ public:
     piece_table& operator=(piece_table&& other) noexcept;
     ~piece_table();
 
-    piece_table(const std::string initial_content);
-    void insert(size_t position, std::string text);
+    piece_table(const std::string initial_content); // load_original on the shared pool
+    piece_table(std::string initial_content, thread_pool& pool);
+    void insert(size_t position, std::string_view text);
     void remove(size_t position, size_t length);
     void clear();
+
+    // replaces the match_length bytes at each of positions (sorted, non overlapping) with replacement.
+    // the replacement is appended to the add buffer once and every match points at that same piece,
+    // then the tree is rebuilt from the new piece list in one pass. returns how many were replaced
+    size_t replace_all(const std::vector<size_t>& positions, size_t match_length, std::string_view replacement);
+
+    // applies a batch of edits sorted by position (deleted ranges must not overlap) in one sweep over the tree.
+    // the inserted text is appended to the add buffer back to back (text pointing into the add buffer is copied first).
+    // returns false, changing nothing, if the batch is not sorted
+    bool apply_edits(const std::vector<text_edit>& edits);
+
+    // clipboard without copying text. a range is copied as its pieces in O(k + log n) for k pieces,
+    // and pasting splices those pieces back into the tree in O(k + log n), however many bytes they cover
+    piece_range copy_range(size_t position, size_t length) const;
+    piece_range cut_range(size_t position, size_t length);
+    bool paste_range(size_t position, const piece_range& range); // false, changing nothing, if the range is from other buffers
+
+    // cut and paste in one go. destination is a position in the document before the move and must not be inside the range
+    bool move_range(size_t position, size_t length, size_t destination);
+
+    // sorts the lines byte wise (like LC_ALL=C sort), keeping only the first of equal lines when unique is set.
+    // line boundaries are found and the lines merge sorted in parallel as views into the buffers, then the
+    // tree is rebuilt as a permutation of the old pieces. only lines that cross pieces are ever copied.
+    // anchors keep their byte offsets. returns the number of lines left
+    size_t sort_lines(thread_pool& pool, bool unique = false);
+
     size_t get_index_for_line(size_t target_line) const;
 
     void write_to(std::ostream& os) const;
+
+    // the ranges (sorted, merged) where the document differs from the original buffer at the same offsets,
+    // from the piece list alone: everything but ORIGINAL pieces still at their own offset. O(n) for n pieces.
+    // returns false if the length changed, since then nothing lines up with the original anymore
+    bool get_changed_ranges(std::vector<text_range>& out) const;
+#if MINIEDITOR_POSIX_IO
+    // writes the document to fd with writev, up to IOV_MAX pieces per call straight from the buffers.
+    // no stream buffer in between. returns false (errno is set) if a write fails
+    bool write_to_fd(int fd) const;
+
+    // same, but original_fd holds the original buffer byte for byte (the file it was read from).
+    // long runs of ORIGINAL pieces are copied from it with copy_file_range, so those bytes never pass through
+    // user space, and filesystems that can share blocks (btrfs, xfs) clone them instead of copying
+    bool write_to_fd(int fd, int original_fd) const;
+
+    // same as write_to_fd(fd, original_fd) for a frozen document, from any thread. written counts the bytes as they reach the file
+    static bool write_frozen(int fd, const frozen_document& document, int original_fd, std::atomic<size_t>& written);
+#endif
+
+    // the document as it is now, for writing it out on another thread while editing goes on. O(n) for n pieces and no text
+    // is copied: the buffers stay where they are until thaw (appending to the add buffer copies it instead of moving it).
+    // clear, restore and moving the table must wait for the thaw. freeze and thaw belong to the thread that edits
+    frozen_document freeze();
+    void thaw();
     std::string to_string() const;
     std::string get_line(size_t line_number) const;
     size_t length() const;
@@ -82,6 +240,101 @@ public:
     char get_char_at(size_t byte_index) const;
     size_t get_line_length(size_t line_number) const;
 
+    // start, length and terminator of a line in a single descent.
+    // lines past the end report {length(), 0, false}
+    line_info get_line_info(size_t line_number) const;
+
+    // LF documents hold no '\r' at all. CRLF ones keep the file's bytes as they are and write "\r\n" for every '\n' inserted
+    line_ending get_line_ending() const { return m_line_ending; }
+    std::string_view get_line_break() const { return m_line_ending == line_ending::CRLF ? "\r\n" : "\n"; }
+    size_t get_inserted_length(std::string_view text) const; // bytes text takes once inserted
+
+    // CRLF when the first line of text ends in "\r\n"
+    static line_ending detect_line_ending(std::string_view text);
+
+    // positions that move with the text (see anchor_tree). each edit moves all of them in O(log k).
+    // clear() drops them
+    anchor_id add_anchor(size_t byte_index);
+    void remove_anchor(anchor_id id);
+    size_t get_anchor_index(anchor_id id) const;
+    text_position get_anchor_position(anchor_id id) const; // O(log k + log n)
+
+    // number of '\n' in [0, byte_index). O(log n) using the subtree newline counts
+    size_t get_newline_count_before(size_t byte_index) const;
+
+    // line and column of a byte in O(log n). indices past the end map to the end of the document
+    text_position get_line_col_for_index(size_t byte_index) const;
+
     void get_pieces(std::vector<piece>& out) const { m_treap.get_pieces(out); }
+
+    // changes whenever the document does, so a caller can tell whether anything happened since it last looked
+    uint64_t get_version() const { return m_version; }
+
+    // streaming load (see file_loader). begin_original empties the table and sizes the original buffer for the whole file,
+    // returning where its bytes go. another thread may fill it while append_original adds the pieces of what arrived
+    // at the end of the document, O(k log n) for k pieces (O(k) into an empty table). end_original drops the bytes past used
+    // (a file that got shorter)
+    char* begin_original(size_t size);
+    void set_line_ending(line_ending ending); // the loader tells it from the first chunk, before any piece is appended
+    void append_original(const std::vector<piece>& pieces);
+    void end_original(size_t used);
+
+    // cuts [start, start + length) of an original buffer into ORIGINAL pieces of bounded length, with their newline counts.
+    // touches nothing else, so any thread can call it
+    static void cut_original(const char* buffer, size_t start, size_t length, std::vector<piece>& out);
+
+    // cut_original for text straight from a file: [start, start + length) is split into partitions that strip their '\r'
+    // in place (LF) and cut themselves on the pool's threads. a partition that lost '\r' leaves unused bytes at its end, which
+    // no piece covers. CRLF text is only cut, never copied. returns how many '\r' were stripped
+    static size_t load_original(char* buffer, size_t start, size_t length, line_ending ending, thread_pool& pool, std::vector<piece>& out);
+
+    // the buffers as they are, for session snapshots (snapshot.h)
+    std::string_view get_original_buffer() const { return m_original_buffer; }
+    const std::string& get_add_buffer() const { return m_add_buffer; }
+
+    // puts a document back from its buffers and its pieces in order, newline counts included, in O(n) for n pieces.
+    // no text is scanned, so the counts are trusted. false, leaving the table and the strings alone, if a piece reaches past its buffer
+    bool restore(std::string&& original, std::string&& add, const std::vector<piece>& pieces, line_ending ending);
+
+    // hands out the document as views straight into the buffers, in order, starting at byte `from`.
+    // nothing is copied. return true from the callback to stop
+    template<typename chunk_callback>
+    void for_each_chunk(size_t from, chunk_callback&& callback) const
+    {
+        if (from >= length())
+            return;
+
+        node* n = nullptr;
+        size_t piece_offset = 0;
+        m_treap.find_by_byte(from, n, piece_offset);
+
+        size_t skip = from - piece_offset; // only the first piece starts part way in
+        m_treap.for_each_from_byte(from, [&](const piece& p) {
+            std::string_view view = get_piece_view(p).substr(skip);
+            skip = 0;
+            return static_cast<bool>(callback(view));
+        });
+    }
+
+    // same as above but backwards, starting with the bytes just before `end`
+    template<typename chunk_callback>
+    void for_each_chunk_reverse(size_t end, chunk_callback&& callback) const
+    {
+        if (end > length())
+            end = length();
+        if (end == 0)
+            return;
+
+        node* n = nullptr;
+        size_t piece_offset = 0;
+        m_treap.find_by_byte(end - 1, n, piece_offset);
+
+        size_t keep = end - piece_offset; // only the first piece ends part way in
+        m_treap.for_each_reverse_before_byte(end, [&](const piece& p) {
+            std::string_view view = get_piece_view(p).substr(0, keep);
+            keep = std::string_view::npos;
+            return static_cast<bool>(callback(view));
+        });
+    }
 };
 } // namespace AL
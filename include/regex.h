@@ -0,0 +1,206 @@
+#pragma once
+
+#include "byte_scan.h"
+#include "piecetable.h"
+#include "search.h"
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace AL
+{
+
+// half open byte range of a match, plus the line and column it starts on
+struct regex_match
+{
+    size_t begin;
+    size_t end;
+    text_position position;
+};
+
+/*
+ * Regular expressions over a piece table, matched with a lazily built DFA.
+ *
+ * Syntax: literals, '.', [classes] with ranges and '^' negation, \d \w \s (and \D \W \S),
+ * \n \t \r \xHH, (groups) and (?:groups), '|', * + ? {m} {m,} {m,n} (greedy, or lazy with a trailing '?'),
+ * '^' and '$' as line anchors. '.' does not match '\n'. There are no captures or backreferences.
+ *
+ * The pattern is compiled into an NFA and an NFA of the reversed pattern. DFA states are made from
+ * the NFA the first time a scan reaches them and cached, so a scan is one table lookup per byte.
+ * Pieces are fed through one after another and the state simply carries over a piece boundary.
+ *
+ * A search runs the forward DFA to find where the leftmost match ends (Perl priorities: the first
+ * alternative and greedy repeats win), then the reverse DFA back from there to find where it starts.
+ * Patterns that start with a literal skip ahead with the SSE2 searcher instead of stepping the DFA
+ * over bytes that cannot start a match, and patterns whose first byte falls in a few ranges
+ * ([0-9], (cat|dog), ...) skip ahead with find_byte_in_ranges.
+ *
+ * Anchors look at the real neighbours of a range, so searching [begin, end) does not pretend
+ * there is a line break at either end of it.
+ *
+ * The DFA cache is updated by const searches, so a regex must not be shared between threads.
+ */
+class regex
+{
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    explicit regex(std::string_view pattern);
+
+    bool is_valid() const;
+    const std::string& get_error() const; // why the pattern did not compile
+    const std::string& get_pattern() const;
+
+    // leftmost match starting at or after `from`. begin is npos if there is none
+    regex_match find_next(const piece_table& pt, size_t from) const;
+
+    // last match inside [0, before), found as if the document ended at `before`
+    regex_match find_prev(const piece_table& pt, size_t before) const;
+
+    // every non overlapping match inside [begin, end), in order
+    void find_all(const piece_table& pt, size_t begin, size_t end, std::vector<regex_match>& out) const;
+
+    // number of non overlapping matches inside [begin, end)
+    size_t count(const piece_table& pt, size_t begin, size_t end) const;
+
+private:
+    using byte_set = std::bitset<256>;
+
+    struct ast_node;
+    class parser;
+    class compiler;
+
+    struct nfa_state
+    {
+        enum class kind : uint8_t
+        {
+            BYTES,     // consumes one byte of sets[set], then goes to out
+            SPLIT,     // out first, then out1
+            EMPTY,     // goes to out
+            LOOK_PREV, // goes to out if the byte before is '\n' or there is none
+            LOOK_NEXT, // goes to out if the byte after is '\n' or there is none
+            MATCH,
+        };
+
+        kind type;
+        uint32_t out;
+        uint32_t out1;
+        uint32_t set;
+    };
+
+    struct program
+    {
+        std::vector<nfa_state> states;
+        std::vector<byte_set> sets;
+        std::array<uint8_t, 256> byte_class; // bytes no set tells apart share a class (and a DFA column)
+        uint32_t class_count = 0;
+        uint32_t start = 0;
+        bool uses_look_prev = false;
+    };
+
+    /*
+     * DFA states are built on demand out of NFA state lists.
+     * A DFA state is the ordered list of NFA states that the previous byte led to (its kernel)
+     * plus whether that byte was a '\n'. The epsilon closure is taken when the next byte is known,
+     * so '$' can be decided by looking at it.
+     *
+     * In leftmost first mode the closure stops at the first MATCH, which drops every lower priority
+     * thread, including the ones a later start position would have begun.
+     *
+     * States are handed out as their row offset in the transition table (id << m_shift), which keeps
+     * a multiply out of the byte loop. Rows are a power of two wide, leaving bit 0 free for the match flag.
+     */
+    class lazy_dfa
+    {
+    public:
+        lazy_dfa() = default;
+        lazy_dfa(program prog, bool leftmost_first);
+
+        uint32_t get_start_state(bool after_newline);
+
+        // state after consuming c. matched is set if a match ends right before c
+        uint32_t step(uint32_t state, unsigned char c, bool& matched)
+        {
+            uint32_t t = m_table[state + m_prog.byte_class[c]];
+            if (t == m_unknown)
+                t = compute(state, c);
+            matched = t & 1;
+            return t & ~1u;
+        }
+
+        // whether a match ends here when the scan stops (the next byte is '\n' or there is none)
+        bool matches_at_end(uint32_t state, bool before_newline);
+
+        bool is_dead(uint32_t state) const
+        {
+            return state == 0;
+        }
+
+        // no thread is half way through a match
+        bool is_start(uint32_t state) const
+        {
+            return m_is_start[state >> m_shift];
+        }
+
+    private:
+        program m_prog;
+        bool m_leftmost_first = true;
+        uint32_t m_shift = 0; // log2 of the row width
+        size_t m_flush_count = 0;
+
+        // transitions, one row per state. next state | matched, or m_unknown if not built yet
+        std::vector<uint32_t> m_table;
+        constexpr static uint32_t m_unknown = UINT32_MAX;
+        std::vector<uint32_t> m_kernels;       // all kernels back to back
+        std::vector<uint32_t> m_kernel_offset; // state i owns [m_kernel_offset[i], m_kernel_offset[i + 1])
+        std::vector<uint8_t> m_after_newline;
+        std::vector<uint8_t> m_is_start;
+        std::unordered_map<std::string, uint32_t> m_state_ids;
+        uint32_t m_start_states[2] = {m_unknown, m_unknown}; // by after_newline
+
+        // scratch
+        std::vector<uint32_t> m_closure;
+        std::vector<uint32_t> m_next_kernel;
+        std::vector<uint32_t> m_stack;
+        std::vector<uint32_t> m_seen;
+        uint32_t m_stamp = 0;
+        std::string m_key;
+
+        // the cache is thrown away and rebuilt from the current state past this many states
+        constexpr static size_t m_max_states = 4096;
+
+        uint32_t compute(uint32_t state, unsigned char c);
+        uint32_t intern(const std::vector<uint32_t>& kernel, bool after_newline);
+        void close(uint32_t state, bool after_newline, bool before_newline, bool& matched);
+        bool close_kernel(uint32_t id, bool before_newline); // closure of a whole kernel, true if it reaches MATCH
+        void flush();
+    };
+
+    std::string m_pattern;
+    std::string m_error;
+    searcher m_prefix; // every match starts with this literal. may be empty
+    std::array<byte_range, 3> m_first_bytes;  // every match starts with a byte in one of these
+    size_t m_first_byte_range_count = 0;       // 0 if it takes more ranges than that
+    bool m_can_match_empty = false;
+    mutable lazy_dfa m_forward;
+    mutable lazy_dfa m_reverse;
+
+    // smallest window find_prev scans backwards before growing it
+    constexpr static size_t m_min_prev_window = 64 * 1024;
+
+    // calls on_match(begin, end) for each non overlapping match inside [begin, end), in order, until it returns true.
+    // begin is npos unless need_begin is set (or the pattern can match empty, which needs it to step over those)
+    template<typename match_callback>
+    void scan_forward(const piece_table& pt, size_t begin, size_t end, bool need_begin, match_callback&& on_match) const;
+
+    // where the longest match that ends at match_end and starts at or after from starts, or npos.
+    // starts in chunk (which begins at chunk_start) when that holds match_end, saving a descent
+    size_t scan_for_start(const piece_table& pt, size_t from, size_t match_end, std::string_view chunk, size_t chunk_start) const;
+};
+
+} // namespace AL
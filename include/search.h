@@ -0,0 +1,96 @@
+#pragma once
+
+#include "piecetable.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace AL
+{
+
+class thread_pool;
+
+/*
+ * Substring search over a piece table.
+ *
+ * Walks the pieces in place, so the document is never copied into one string.
+ * Matches that span piece boundaries are found by carrying the last
+ * (pattern length - 1) bytes of one piece over into the next.
+ *
+ * Inside a piece, candidates are found 16 positions at a time by comparing the
+ * first and last byte of the pattern (SSE2), then verified with memcmp.
+ * Without SSE2, and for the tail of each piece, Horspool is used instead.
+ *
+ * The parallel overloads split the range into byte partitions and scan them on a
+ * thread_pool. Each partition reads m - 1 bytes past its end so matches that cross
+ * a seam are not lost, and the seams are repaired afterwards so the results are
+ * exactly the same as the single threaded ones.
+ *
+ * All offsets are global byte indices.
+ */
+class searcher
+{
+public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    explicit searcher(std::string_view pattern);
+
+    // first match starting at or after `from`
+    size_t find_next(const piece_table& pt, size_t from) const;
+
+    // last match starting before `before`
+    size_t find_prev(const piece_table& pt, size_t before) const;
+
+    // every non overlapping match that lies inside [begin, end), in order
+    void find_all(const piece_table& pt, size_t begin, size_t end, std::vector<size_t>& out) const;
+
+    // number of non overlapping matches inside [begin, end)
+    size_t count(const piece_table& pt, size_t begin, size_t end) const;
+
+    // same as above, scanned in parallel
+    void find_all(const piece_table& pt, size_t begin, size_t end, std::vector<size_t>& out, thread_pool& pool) const;
+    size_t count(const piece_table& pt, size_t begin, size_t end, thread_pool& pool) const;
+
+    // searches inside one contiguous buffer. returns the match offset or npos
+    size_t find_in(const char* data, size_t length) const;
+    size_t rfind_in(const char* data, size_t length) const;
+
+    size_t length() const
+    {
+        return m_pattern.length();
+    }
+
+private:
+    std::string m_pattern;
+    std::array<uint32_t, 256> m_shift;         // Horspool shifts, window moving right
+    std::array<uint32_t, 256> m_reverse_shift; // Horspool shifts, window moving left
+
+    // smaller ranges are not worth handing to another thread
+    constexpr static size_t m_min_partition_length = 1 << 20;
+
+    struct partition
+    {
+        size_t begin;
+        size_t end;
+        size_t count;
+        size_t first; // first and last match, npos if there are none
+        size_t last;
+        std::vector<size_t> matches;
+    };
+
+    size_t horspool(const char* data, size_t length) const;
+    size_t reverse_horspool(const char* data, size_t length) const;
+
+    // calls on_match(global index) for each non overlapping match in [begin, end) until it returns true
+    template<typename match_callback>
+    void scan_forward(const piece_table& pt, size_t begin, size_t end, match_callback&& on_match) const;
+
+    // non overlapping matches that start inside [part.begin, part.end) and end by limit
+    void scan_partition(const piece_table& pt, size_t limit, partition& part, bool keep_matches) const;
+    void scan_parallel(const piece_table& pt, size_t begin, size_t end, thread_pool& pool, bool keep_matches, std::vector<partition>& parts) const;
+};
+
+} // namespace AL
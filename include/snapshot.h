@@ -0,0 +1,75 @@
+#pragma once
+
+#include "piecetable.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace AL
+{
+
+/*
+ * Session snapshot: a piece table saved as it is, so a heavily edited document
+ * comes back without reading its text twice or parsing any of it.
+ *
+ * Layout (native byte order, every section 8 byte aligned so the file can be mapped):
+ *   snapshot_header
+ *   snapshot_piece[piece_count]  in document order, with their newline counts
+ *   add buffer                   add_length bytes
+ *   original buffer              only when the file on disk is not the original buffer byte for byte
+ *
+ * Otherwise the original buffer is the file itself. It is tied to the snapshot by the
+ * file's size and mtime and by a hash of a few sampled blocks, so checking it is O(1).
+ *
+ * Loading maps the file, copies the add buffer out and builds the tree from the
+ * piece array in one pass (implicit_treap::build), O(n) for n pieces.
+ */
+struct snapshot_header
+{
+    char magic[8];
+    uint32_t header_length; // sizeof(snapshot_header)
+    uint32_t piece_length;  // sizeof(snapshot_piece)
+    uint64_t byte_order;    // snapshot_byte_order as written, anything else was written on another machine
+    uint64_t file_size;     // the file as it was when the snapshot was taken
+    int64_t file_mtime_ns;
+    uint64_t original_fingerprint; // snapshot_fingerprint of the original buffer
+    uint64_t original_embedded;    // 1 if the original buffer follows the add buffer
+    uint64_t original_length;
+    uint64_t piece_count;
+    uint64_t pieces_offset;
+    uint64_t add_offset;
+    uint64_t add_length;
+    uint64_t original_offset;
+    uint64_t document_length; // sum of the piece lengths
+    uint64_t cursor;
+    uint64_t line_ending;     // AL::line_ending, so a CRLF document goes on writing "\r\n"
+    uint64_t pieces_checksum; // FNV-1a of the piece array
+};
+
+struct snapshot_piece
+{
+    uint64_t start;
+    uint64_t length;
+    uint64_t newline_count;
+    uint64_t buffer; // buffer_type
+};
+
+constexpr uint64_t snapshot_byte_order = 0x0102030405060708ULL;
+
+// hash of up to 16 blocks of 4 KB spread over the buffer, and of its length
+uint64_t snapshot_fingerprint(std::string_view buffer);
+
+// writes the document to path (through a .tmp and a rename). the file at file_size and file_mtime_ns is the
+// original buffer byte for byte unless embed_original is set, in which case the snapshot carries it
+bool write_snapshot(const std::filesystem::path& path, const piece_table& document, uint64_t file_size, int64_t file_mtime_ns,
+                    bool embed_original, size_t cursor);
+
+// restores the document from the snapshot at path if it was taken of the file as it is now (file_size, file_mtime_ns).
+// file_bytes are the file's bytes as read, and become the original buffer unless the snapshot carries its own.
+// header gets the snapshot's header (cursor, original_embedded). false, leaving document and file_bytes alone,
+// if the snapshot is missing, stale or damaged
+bool read_snapshot(const std::filesystem::path& path, std::string& file_bytes, uint64_t file_size, int64_t file_mtime_ns, piece_table& document,
+                   snapshot_header& header);
+
+} // namespace AL
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AL
+{
+
+/*
+ * Fixed size pool of worker threads for data parallel jobs.
+ *
+ * run(count, task) calls task(0) ... task(count - 1) spread over the workers
+ * and the calling thread, and returns once every call has finished.
+ * One job runs at a time. Concurrent callers take turns.
+ *
+ * Tasks must not touch the treap slab (single threaded). Read only piece table
+ * access is fine, but every treap mutation has to stay on the main thread.
+ */
+class thread_pool
+{
+public:
+    // worker_count extra threads. the caller of run() is always one more
+    explicit thread_pool(size_t worker_count);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // threads that work on a job, including the caller
+    size_t concurrency() const
+    {
+        return m_workers.size() + 1;
+    }
+
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_run_mutex; // serializes run() callers
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    // current job. guarded by m_mutex except m_next
+    const std::function<void(size_t)>* m_task;
+    size_t m_count;
+    std::atomic<size_t> m_next;
+    size_t m_completed;
+    size_t m_active; // workers inside the current job
+    uint64_t m_generation;
+    bool m_stop;
+
+    void worker_loop();
+    void work(const std::function<void(size_t)>& task, size_t count);
+};
+
+// shared pool sized to the machine (hardware threads - 1 workers)
+thread_pool& get_thread_pool();
+
+} // namespace AL
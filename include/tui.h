@@ -1,9 +1,15 @@
 #pragma once
 
 #include "editor.h"
+#include "regex.h"
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <curses.h>
 #include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace AL
 {
@@ -37,6 +43,7 @@ private:
     // optimization
     char m_gutter_buffer[32];
     std::string m_line_buffer;
+    std::vector<size_t> m_batch_columns; // where the text typed at several cursors goes on the line being drawn
 
     size_t m_viewport_top_line;
     size_t m_viewport_height;
@@ -46,6 +53,25 @@ private:
     std::string m_status_message;
     bool m_show_status_message;
 
+    // single line input shown in place of the status bar
+    enum class prompt_kind : uint8_t
+    {
+        NONE,
+        GOTO_LINE, // Ctrl+G
+        FIND,      // Ctrl+F
+        REGEX,     // Ctrl+R
+        RECOVER,   // after opening a file with an autosave next to it, y or n
+    };
+    prompt_kind m_prompt;
+    std::string m_prompt_input;
+    std::string m_last_search; // repeated with Ctrl+N / Ctrl+P
+    std::optional<regex> m_last_regex; // set when the last search was a regex
+
+#if MINIEDITOR_LATENCY_STATS
+    // F2 toggles p50/p99/max per operation in the status bar
+    bool m_show_latency_overlay = false;
+#endif
+
     void update_values();
     void render();
     void render_status_bar(size_t col_offset);
@@ -53,6 +79,21 @@ private:
     void handle_input(const int ch);
     void clear_status_message();
     void set_status_message(const std::string& msg);
+    bool update_save_status(); // shows how far the background save got. true if the status bar changed
+
+    // autosave every m_autosave_interval, writing at most m_autosave_budget bytes a second
+    constexpr static std::chrono::seconds m_autosave_interval{30};
+    constexpr static size_t m_autosave_budget = 8 * 1024 * 1024;
+
+    // the edit journal is started once the file is all in and saved, with no recovery waiting. tried once, from the idle loop
+    bool m_journal_tried = false;
+    void start_journal();
+
+    void open_prompt(prompt_kind kind);
+    void handle_prompt_input(const int ch);
+    void submit_prompt();
+    const char* get_prompt_label() const;
+    void repeat_search(bool forward);
 };
 
 } // namespace AL
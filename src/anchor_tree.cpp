@@ -0,0 +1,238 @@
+#include "anchor_tree.h"
+
+namespace AL
+{
+
+uint64_t anchor_tree::next_priority()
+{
+    // SplitMix64, same as the piece treap
+    uint64_t z = (m_seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void anchor_tree::collapse(uint32_t n)
+{
+    if (n == NIL)
+        return;
+    m_nodes[n].gap = 0;
+    m_nodes[n].sum = 0;
+    m_nodes[n].collapse = true;
+}
+
+void anchor_tree::push(uint32_t n)
+{
+    if (!m_nodes[n].collapse)
+        return;
+    collapse(m_nodes[n].left);
+    collapse(m_nodes[n].right);
+    m_nodes[n].collapse = false;
+}
+
+void anchor_tree::update(uint32_t n)
+{
+    node& x = m_nodes[n];
+    x.sum = get_sum(x.left) + x.gap + get_sum(x.right);
+    x.count = get_count(x.left) + 1 + get_count(x.right);
+    if (x.left != NIL)
+        m_nodes[x.left].parent = n;
+    if (x.right != NIL)
+        m_nodes[x.right].parent = n;
+}
+
+uint32_t anchor_tree::merge(uint32_t l, uint32_t r)
+{
+    if (l == NIL || r == NIL)
+        return l == NIL ? r : l;
+
+    if (m_nodes[l].priority > m_nodes[r].priority)
+    {
+        push(l);
+        m_nodes[l].right = merge(m_nodes[l].right, r);
+        update(l);
+        return l;
+    }
+
+    push(r);
+    m_nodes[r].left = merge(l, m_nodes[r].left);
+    update(r);
+    return r;
+}
+
+void anchor_tree::split(uint32_t n, size_t position, bool inclusive, size_t base, uint32_t& l, uint32_t& r)
+{
+    if (n == NIL)
+    {
+        l = r = NIL;
+        return;
+    }
+
+    push(n);
+    const size_t at = base + get_sum(m_nodes[n].left) + m_nodes[n].gap;
+    if (at < position || (inclusive && at == position))
+    {
+        split(m_nodes[n].right, position, inclusive, at, m_nodes[n].right, r);
+        l = n;
+    }
+    else
+    {
+        split(m_nodes[n].left, position, inclusive, base, l, m_nodes[n].left);
+        r = n;
+    }
+    update(n);
+}
+
+void anchor_tree::split_by_rank(uint32_t n, size_t rank, uint32_t& l, uint32_t& r)
+{
+    if (n == NIL)
+    {
+        l = r = NIL;
+        return;
+    }
+
+    push(n);
+    const size_t left_count = get_count(m_nodes[n].left);
+    if (rank > left_count)
+    {
+        split_by_rank(m_nodes[n].right, rank - left_count - 1, m_nodes[n].right, r);
+        l = n;
+    }
+    else
+    {
+        split_by_rank(m_nodes[n].left, rank, l, m_nodes[n].left);
+        r = n;
+    }
+    update(n);
+}
+
+void anchor_tree::add_to_first_gap(uint32_t n, size_t delta)
+{
+    push(n);
+    if (m_nodes[n].left != NIL)
+        add_to_first_gap(m_nodes[n].left, delta);
+    else
+        m_nodes[n].gap += delta;
+    update(n);
+}
+
+anchor_id anchor_tree::add(size_t position)
+{
+    anchor_id id;
+    if (!m_free.empty())
+    {
+        id = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        id = static_cast<anchor_id>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    m_nodes[id] = {.gap = 0, .sum = 0, .priority = next_priority(), .count = 1, .left = NIL, .right = NIL, .parent = NIL, .collapse = false};
+
+    // goes after the anchors already at position. its gap is from the last of them, and the next one's gap shrinks by as much
+    uint32_t l, r;
+    split(m_root, position, true, 0, l, r);
+    const size_t before = get_sum(l);
+    m_nodes[id].gap = position - before;
+    update(id);
+    if (r != NIL)
+        add_to_first_gap(r, before - position);
+
+    m_root = merge(merge(l, id), r);
+    m_nodes[m_root].parent = NIL;
+    ++m_count;
+    return id;
+}
+
+void anchor_tree::remove(anchor_id id)
+{
+    // rank of the anchor, counting up to the root
+    size_t rank = get_count(m_nodes[id].left);
+    for (uint32_t n = id; m_nodes[n].parent != NIL; n = m_nodes[n].parent)
+    {
+        const uint32_t parent = m_nodes[n].parent;
+        if (m_nodes[parent].right == n)
+            rank += get_count(m_nodes[parent].left) + 1;
+    }
+
+    uint32_t l, middle, r;
+    split_by_rank(m_root, rank, l, r);
+    split_by_rank(r, 1, middle, r);
+
+    // the next anchor takes over the gap
+    if (r != NIL)
+        add_to_first_gap(r, m_nodes[middle].gap);
+
+    m_root = merge(l, r);
+    if (m_root != NIL)
+        m_nodes[m_root].parent = NIL;
+    m_free.push_back(id);
+    --m_count;
+}
+
+void anchor_tree::clear()
+{
+    m_nodes.clear();
+    m_free.clear();
+    m_root = NIL;
+    m_count = 0;
+}
+
+size_t anchor_tree::get_position(anchor_id id) const
+{
+    // the gaps before the anchor, collected on the way up. a collapse tag means the sums below it are stale and really 0
+    const node& self = m_nodes[id];
+    size_t position = (self.collapse ? 0 : get_sum(self.left)) + self.gap;
+    for (uint32_t n = id; m_nodes[n].parent != NIL; n = m_nodes[n].parent)
+    {
+        const node& parent = m_nodes[m_nodes[n].parent];
+        if (parent.collapse)
+            position = parent.right == n ? parent.gap : 0;
+        else if (parent.right == n)
+            position += get_sum(parent.left) + parent.gap;
+    }
+    return position;
+}
+
+void anchor_tree::on_insert(size_t position, size_t length)
+{
+    if (m_root == NIL || length == 0)
+        return;
+
+    uint32_t l, r;
+    split(m_root, position, true, 0, l, r);
+    if (r != NIL)
+        add_to_first_gap(r, length);
+    m_root = merge(l, r);
+    m_nodes[m_root].parent = NIL;
+}
+
+void anchor_tree::on_remove(size_t position, size_t length)
+{
+    if (m_root == NIL || length == 0)
+        return;
+
+    uint32_t before, inside, after;
+    split(m_root, position, false, 0, before, after);
+    const size_t before_end = get_sum(before);
+    split(after, position + length, false, before_end, inside, after);
+    const size_t inside_sum = get_sum(inside);
+
+    // the first anchor after the range keeps its place in the text
+    if (after != NIL)
+        add_to_first_gap(after, before_end + inside_sum - length - (inside != NIL ? position : before_end));
+
+    // everything inside lands on position
+    if (inside != NIL)
+    {
+        collapse(inside);
+        add_to_first_gap(inside, position - before_end);
+    }
+
+    m_root = merge(merge(before, inside), after);
+    m_nodes[m_root].parent = NIL;
+}
+
+} // namespace AL
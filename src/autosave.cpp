@@ -0,0 +1,151 @@
+#include "autosave.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace AL
+{
+
+autosaver::autosaver()
+{
+    m_thread = std::thread([this]() { run(); }); // once the members it reads are set up
+}
+
+autosaver::~autosaver()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+        m_cancelled = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+bool autosaver::write(const std::filesystem::path& path, const frozen_document& document)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_busy)
+            return false;
+        m_busy = true;
+        m_cancelled = false;
+        m_document = &document;
+        m_path = path;
+    }
+    m_wake.notify_all();
+    return true;
+}
+
+void autosaver::cancel()
+{
+    std::unique_lock lock(m_mutex);
+    m_cancelled = true;
+    m_wake.notify_all();
+    m_wake.wait(lock, [this]() { return !m_busy; });
+}
+
+bool autosaver::is_idle() const
+{
+    std::lock_guard lock(m_mutex);
+    return !m_busy;
+}
+
+bool autosaver::succeeded() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_succeeded;
+}
+
+void autosaver::set_budget(size_t bytes_per_second)
+{
+    std::lock_guard lock(m_mutex);
+    m_budget = bytes_per_second;
+}
+
+void autosaver::run()
+{
+    std::unique_lock lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [this]() { return m_stop || m_document; });
+        if (m_stop)
+            break;
+
+        const frozen_document& document = *m_document;
+        const std::filesystem::path path = m_path;
+        const size_t budget = m_budget;
+        lock.unlock();
+        const bool written = write_document(path, document, budget);
+        lock.lock();
+
+        m_succeeded = written;
+        m_document = nullptr;
+        m_busy = false;
+        m_wake.notify_all(); // cancel waits for this
+    }
+}
+
+bool autosaver::write_document(const std::filesystem::path& path, const frozen_document& document, size_t budget)
+{
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    std::ofstream ofs(temp_path, std::ios::binary);
+
+    double tokens = static_cast<double>(budget); // a second's worth to start with
+    auto refilled = std::chrono::steady_clock::now();
+    bool ok = static_cast<bool>(ofs);
+    for (size_t i = 0; ok && i < document.pieces.size(); ++i)
+    {
+        const piece& p = document.pieces[i];
+        const std::string_view buffer = p.buf_type == buffer_type::ORIGINAL ? document.original : document.add;
+        for (size_t offset = 0; ok && offset < p.length; offset += m_slice_length)
+        {
+            const size_t length = std::min(m_slice_length, p.length - offset);
+            ok = wait_for_budget(length, budget, tokens, refilled) &&
+                 ofs.write(buffer.data() + p.start + offset, static_cast<std::streamsize>(length));
+        }
+    }
+    ofs.close();
+
+    // renamed under the lock, so a cancel that returned never sees the sidecar change after it
+    std::lock_guard lock(m_mutex);
+    std::error_code ec;
+    ok = ok && ofs && !m_cancelled;
+    if (ok)
+        std::filesystem::rename(temp_path, path, ec);
+    if (!ok || ec)
+    {
+        if (!m_cancelled)
+            std::cerr << "ERROR: Autosave failed. Path: " << path << '\n';
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+bool autosaver::wait_for_budget(size_t length, size_t budget, double& tokens, std::chrono::steady_clock::time_point& refilled)
+{
+    std::unique_lock lock(m_mutex);
+    if (budget == 0)
+        return !m_cancelled;
+
+    // the bucket holds at most a second of budget, and a slice bigger than that still goes once it is full
+    const double needed = std::min(static_cast<double>(length), static_cast<double>(budget));
+    while (!m_cancelled)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double refill = std::chrono::duration<double>(now - refilled).count() * static_cast<double>(budget);
+        tokens = std::min(static_cast<double>(budget), tokens + refill);
+        refilled = now;
+        if (tokens >= needed)
+        {
+            tokens -= static_cast<double>(length);
+            return true;
+        }
+        m_wake.wait_for(lock, std::chrono::duration<double>((needed - tokens) / static_cast<double>(budget)));
+    }
+    return false;
+}
+
+} // namespace AL
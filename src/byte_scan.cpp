@@ -0,0 +1,117 @@
+#include "byte_scan.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINIEDITOR_BYTE_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace AL
+{
+
+size_t count_byte(const char* data, size_t length, char c)
+{
+    size_t count = 0;
+    size_t i = 0;
+
+#if MINIEDITOR_BYTE_SCAN_SSE2
+    const __m128i needle = _mm_set1_epi8(c);
+    const __m128i zero = _mm_setzero_si128();
+
+    while (length - i >= 16)
+    {
+        // each lane counts up to 255 matches before it has to be widened
+        const size_t blocks = std::min<size_t>((length - i) / 16, 255);
+        __m128i acc = zero;
+        for (size_t b = 0; b < blocks; ++b, i += 16)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(chunk, needle)); // a match is -1
+        }
+
+        // horizontal sum of the 16 lanes into two 64 bit halves
+        const __m128i sums = _mm_sad_epu8(acc, zero);
+        count += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+#endif
+
+    for (; i < length; ++i)
+        count += data[i] == c;
+
+    return count;
+}
+
+const char* rfind_byte(const char* data, size_t length, char c)
+{
+#if MINIEDITOR_BYTE_SCAN_SSE2
+    const __m128i needle = _mm_set1_epi8(c);
+    while (length >= 16)
+    {
+        length -= 16;
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + length));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        if (mask)
+            return data + length + std::bit_width(mask) - 1;
+    }
+#endif
+
+    while (length > 0)
+    {
+        --length;
+        if (data[length] == c)
+            return data + length;
+    }
+
+    return nullptr;
+}
+
+const char* find_byte_in_ranges(const char* data, size_t length, const byte_range* ranges, size_t range_count)
+{
+    size_t i = 0;
+
+#if MINIEDITOR_BYTE_SCAN_SSE2
+    // b is in [lo, hi] when (b - lo) <= (hi - lo) unsigned, which is max(b - lo, hi - lo) == hi - lo
+    __m128i lows[4];
+    __m128i widths[4];
+    const size_t vector_ranges = std::min<size_t>(range_count, 4);
+    for (size_t r = 0; r < vector_ranges; ++r)
+    {
+        lows[r] = _mm_set1_epi8(static_cast<char>(ranges[r].lo));
+        widths[r] = _mm_set1_epi8(static_cast<char>(ranges[r].hi - ranges[r].lo));
+    }
+
+    if (range_count == vector_ranges)
+    {
+        for (; i + 16 <= length; i += 16)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i hits = _mm_setzero_si128();
+            for (size_t r = 0; r < vector_ranges; ++r)
+            {
+                const __m128i offset = _mm_sub_epi8(chunk, lows[r]);
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(_mm_max_epu8(offset, widths[r]), widths[r]));
+            }
+
+            const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask)
+                return data + i + std::countr_zero(mask);
+        }
+    }
+#endif
+
+    for (; i < length; ++i)
+    {
+        const auto b = static_cast<unsigned char>(data[i]);
+        for (size_t r = 0; r < range_count; ++r)
+        {
+            if (b >= ranges[r].lo && b <= ranges[r].hi)
+                return data + i;
+        }
+    }
+
+    return nullptr;
+}
+
+} // namespace AL
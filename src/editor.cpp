@@ -1,42 +1,399 @@
 #include "editor.h"
+#include "journal.h"
+#include "latency.h"
 #include "piecetable.h"
+#include "regex.h"
+#include "search.h"
+#include "snapshot.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <ios>
+#include <iterator>
 #include <iostream>
+#include <vector>
+
+#if MINIEDITOR_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace AL
 {
 
 constexpr char NEWLINE = '\n';
 
-editor::editor() : m_dirty(false), m_insert_position(0)
+editor::editor() : m_dirty(false), m_insert_position(0), m_delete_length(0), m_batch_main(0), m_batch_same_line_before(0)
 {
     m_cursor.reset();
     m_insert_buffer.reserve(m_max_insert_buffer_length);
 }
 
 editor::~editor()
-{}
+{
+    stop_loading();
+    wait_for_save();
+    stop_autosave(); // the copy stays, this may be a session going down
+#if MINIEDITOR_POSIX_IO
+    close_original_file();
+#endif
+}
+
+#if MINIEDITOR_POSIX_IO
+static int64_t get_mtime_ns(const struct stat& st)
+{
+#if defined(__APPLE__)
+    return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1'000'000'000 + st.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+void editor::close_original_file()
+{
+    if (m_original_fd >= 0)
+        ::close(m_original_fd);
+    m_original_fd = -1;
+    m_disk_patches.clear();
+}
+
+// fd still is the file at path, with the size and mtime it had when it was opened
+static bool is_same_file(int fd, const std::filesystem::path& path, int64_t size, int64_t mtime_ns)
+{
+    struct stat fd_stat;
+    struct stat path_stat;
+    return ::fstat(fd, &fd_stat) == 0 && ::stat(path.c_str(), &path_stat) == 0 && fd_stat.st_dev == path_stat.st_dev &&
+           fd_stat.st_ino == path_stat.st_ino && fd_stat.st_size == size && get_mtime_ns(fd_stat) == mtime_ns;
+}
+
+int editor::get_original_fd() const
+{
+    struct stat st;
+    if (m_original_fd < 0 || ::fstat(m_original_fd, &st) != 0)
+        return -1;
+    return st.st_size == m_original_size && get_mtime_ns(st) == m_original_mtime_ns ? m_original_fd : -1;
+}
+
+// write-ahead log of an in-place save, next to the file as <name>.wal: magic, size of the file, record count,
+// then offset, length and new bytes of every record, then an FNV-1a hash of all that.
+// the file is only patched once the log is on disk and the log is removed once the file is. so a log with a good
+// hash was cut off part way through patching and is applied again on open, and one with a bad hash never got that far
+constexpr char WAL_MAGIC[8] = {'M', 'E', 'W', 'A', 'L', '0', '0', '1'};
+
+static std::filesystem::path get_wal_path(const std::filesystem::path& path)
+{
+    std::filesystem::path wal_path = path;
+    wal_path += ".wal";
+    return wal_path;
+}
+
+static uint64_t fnv1a(std::string_view bytes)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : bytes)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    return hash;
+}
+
+static void append_u64(std::string& out, uint64_t value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool read_u64(std::string_view& in, uint64_t& value)
+{
+    if (in.size() < sizeof(value))
+        return false;
+    std::memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+// write and pwrite may stop part way
+static bool write_fully(int fd, const char* data, size_t length)
+{
+    while (length > 0)
+    {
+        const ssize_t written = ::write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static bool pwrite_fully(int fd, const char* data, size_t length, size_t offset)
+{
+    while (length > 0)
+    {
+        const ssize_t written = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// a new file is only durable once the directory entry pointing at it is
+static bool sync_parent_directory(const std::filesystem::path& path)
+{
+    const std::filesystem::path parent = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+    const int fd = ::open(parent.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+// finishes an in-place save that was cut off. false if the log is good but could not be applied
+static bool replay_write_ahead_log(const std::filesystem::path& path)
+{
+    const std::filesystem::path wal_path = get_wal_path(path);
+    std::error_code ec;
+    if (!std::filesystem::exists(wal_path, ec))
+        return true;
+
+    std::string log;
+    {
+        std::ifstream ifs(wal_path, std::ios::binary);
+        log.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+
+    std::string_view in = log;
+    uint64_t file_size = 0;
+    uint64_t count = 0;
+    uint64_t hash = 0;
+    std::vector<std::pair<uint64_t, std::string_view>> records;
+    bool valid = log.size() >= sizeof(WAL_MAGIC) + sizeof(hash) && std::memcmp(log.data(), WAL_MAGIC, sizeof(WAL_MAGIC)) == 0;
+    if (valid)
+    {
+        std::memcpy(&hash, log.data() + log.size() - sizeof(hash), sizeof(hash));
+        valid = fnv1a(in.substr(0, log.size() - sizeof(hash))) == hash;
+        in = in.substr(sizeof(WAL_MAGIC), log.size() - sizeof(WAL_MAGIC) - sizeof(hash));
+    }
+    valid = valid && read_u64(in, file_size) && read_u64(in, count);
+    for (uint64_t i = 0; valid && i < count; ++i)
+    {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        valid = read_u64(in, offset) && read_u64(in, length) && length <= in.size() && offset + length <= file_size;
+        if (valid)
+        {
+            records.emplace_back(offset, in.substr(0, length));
+            in.remove_prefix(length);
+        }
+    }
+
+    // a torn log, or a file that was replaced since, is left alone
+    struct stat st;
+    if (!valid || ::stat(path.c_str(), &st) != 0 || static_cast<uint64_t>(st.st_size) != file_size)
+    {
+        std::filesystem::remove(wal_path, ec);
+        return true;
+    }
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    bool applied = fd >= 0;
+    for (const auto& [offset, bytes] : records)
+        applied = applied && pwrite_fully(fd, bytes.data(), bytes.size(), offset);
+    applied = applied && ::fsync(fd) == 0;
+    if (fd >= 0)
+        ::close(fd);
+    if (!applied)
+    {
+        std::cerr << "ERROR: Could not apply the write-ahead log of an unfinished save. Path: " << wal_path << NEWLINE;
+        return false;
+    }
+
+    std::filesystem::remove(wal_path, ec);
+    return true;
+}
+
+bool editor::save_in_place()
+{
+    const int original_fd = get_original_fd();
+    std::vector<text_range> changed;
+    if (original_fd < 0 || !m_piece_table.get_changed_ranges(changed))
+        return false;
+
+    // the ranges earlier in place saves wrote differ from the original buffer whatever the pieces say
+    std::vector<text_range> ranges;
+    ranges.reserve(changed.size() + m_disk_patches.size());
+    std::merge(changed.begin(), changed.end(), m_disk_patches.begin(), m_disk_patches.end(), std::back_inserter(ranges),
+               [](const text_range& a, const text_range& b) { return a.start < b.start; });
+    size_t merged = 0;
+    size_t total = 0;
+    for (const text_range& range : ranges)
+    {
+        if (merged > 0 && ranges[merged - 1].start + ranges[merged - 1].length >= range.start)
+        {
+            text_range& last = ranges[merged - 1];
+            last.length = std::max(last.start + last.length, range.start + range.length) - last.start;
+        }
+        else
+        {
+            ranges[merged++] = range;
+        }
+    }
+    ranges.resize(merged);
+    for (const text_range& range : ranges)
+        total += range.length;
+    if (total > m_max_in_place_save_length)
+        return false;
+
+    const int fd = ::open(m_current_file_path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat file_stat;
+    struct stat original_stat;
+    if (::fstat(fd, &file_stat) != 0 || ::fstat(original_fd, &original_stat) != 0 || file_stat.st_dev != original_stat.st_dev ||
+        file_stat.st_ino != original_stat.st_ino)
+    {
+        ::close(fd); // a save renamed another file over the path since it was opened
+        return false;
+    }
+
+    std::string log(WAL_MAGIC, sizeof(WAL_MAGIC));
+    append_u64(log, static_cast<uint64_t>(m_original_size));
+    append_u64(log, ranges.size());
+    std::vector<size_t> payloads; // where the new bytes of each range are in the log
+    payloads.reserve(ranges.size());
+    for (const text_range& range : ranges)
+    {
+        append_u64(log, range.start);
+        append_u64(log, range.length);
+        payloads.push_back(log.size());
+        size_t remaining = range.length;
+        m_piece_table.for_each_chunk(range.start, [&](std::string_view chunk) {
+            const size_t take = std::min(chunk.size(), remaining);
+            log.append(chunk.data(), take);
+            remaining -= take;
+            return remaining == 0;
+        });
+    }
+    append_u64(log, fnv1a(log));
+
+    const std::filesystem::path wal_path = get_wal_path(m_current_file_path);
+    std::error_code ec;
+    const int wal_fd = ::open(wal_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    bool logged = wal_fd >= 0 && write_fully(wal_fd, log.data(), log.size()) && ::fsync(wal_fd) == 0;
+    if (wal_fd >= 0 && ::close(wal_fd) != 0)
+        logged = false;
+    if (!logged || !sync_parent_directory(wal_path))
+    {
+        ::close(fd);
+        std::filesystem::remove(wal_path, ec);
+        return false;
+    }
+
+    // the log is on disk, so a crash from here on is finished by replay_write_ahead_log
+    bool patched = true;
+    for (size_t i = 0; i < ranges.size() && patched; ++i)
+        patched = pwrite_fully(fd, log.data() + payloads[i], ranges[i].length, ranges[i].start);
+    patched = patched && ::fsync(fd) == 0 && ::fstat(fd, &file_stat) == 0;
+    ::close(fd);
+    if (!patched)
+    {
+        std::cerr << "ERROR: Patching the file in place failed, its write-ahead log is kept. Path: " << m_current_file_path << NEWLINE;
+        return false;
+    }
+
+    std::filesystem::remove(wal_path, ec);
+    m_disk_patches = std::move(ranges);
+    m_original_mtime_ns = get_mtime_ns(file_stat); // our own write
+    return true;
+}
+#endif // MINIEDITOR_POSIX_IO
+
+static std::filesystem::path get_journal_path(const std::filesystem::path& path)
+{
+    std::filesystem::path journal_path = path;
+    journal_path += ".journal";
+    return journal_path;
+}
+
+static std::filesystem::path get_session_path(const std::filesystem::path& path)
+{
+    std::filesystem::path session_path = path;
+    session_path += ".session";
+    return session_path;
+}
+
+static std::filesystem::path get_autosave_path(const std::filesystem::path& path)
+{
+    std::filesystem::path autosave_path = path;
+    autosave_path += ".autosave";
+    return autosave_path;
+}
+
+// what a journal or a snapshot is tied to: the file's size and modification time
+static bool get_file_version(const std::filesystem::path& path, uint64_t& size, int64_t& mtime_ns)
+{
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+    return !ec;
+}
 
 bool editor::open(const std::filesystem::path& path)
 {
-    // TODO: add a feature where it searches if there is a .tmp counterpart to this file we want to open.
-    // then we can prompt the user if they want to open this tmp file or to delete the temp file and open the real file
+    return begin_open(path) && wait_for_load();
+}
+
+bool editor::begin_open(const std::filesystem::path& path)
+{
     if (path.empty())
         return false;
+    wait_for_save();
+    stop_autosave();
+    stop_loading();
+    m_load_failed = false;
 
+    // a copy autosaved by a session that never saved or quit. the caller offers it (recover, discard_recovery)
     std::error_code ec;
+    m_has_recovery = std::filesystem::exists(get_autosave_path(path), ec);
+    m_autosaved_version = UINT64_MAX;
     bool file_exists = std::filesystem::exists(path, ec);
 
+#if MINIEDITOR_POSIX_IO
+    // a save that was cut off while patching the file in place is finished first
+    if (file_exists && !replay_write_ahead_log(path))
+        return false;
+#endif
+
     // create new empty document
     if (!file_exists && !ec)
     {
+#if MINIEDITOR_POSIX_IO
+        close_original_file();
+#endif
+        m_journal.close();
         m_current_file_path = path;
         m_dirty = true;
         m_piece_table = piece_table();
+        m_insert_buffer.clear();
+        m_delete_length = 0;
+        m_extra_cursors.clear();
+        m_batch_bases.clear();
+        m_batch_text.clear();
         m_cursor.col = 1;
         m_cursor.col_internal = 1;
         m_cursor.row = 1;
@@ -56,10 +413,67 @@ bool editor::open(const std::filesystem::path& path)
         return false;
     }
 
+#if MINIEDITOR_POSIX_IO
+    // opened before reading, so it can be checked to be the file that was read
+    const int original_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat original_stat;
+    const bool original_ok = original_fd >= 0 && ::fstat(original_fd, &original_stat) == 0;
+#endif
+
+    // streamed when nothing has to be put on top of the whole text first (a session snapshot, a journal)
+    const std::filesystem::path session_path = get_session_path(path);
+    const std::filesystem::path journal_path = get_journal_path(path);
+    if (size_known && !std::filesystem::exists(session_path, ec) && !std::filesystem::exists(journal_path, ec))
+    {
+#if MINIEDITOR_POSIX_IO
+        close_original_file();
+        if (original_ok)
+        {
+            m_loading_fd = original_fd;
+            m_original_size = original_stat.st_size;
+            m_original_mtime_ns = get_mtime_ns(original_stat);
+        }
+        else if (original_fd >= 0)
+        {
+            ::close(original_fd);
+        }
+#endif
+        m_journal.close();
+        m_current_file_path = path;
+        m_dirty = false;
+        m_insert_buffer.clear();
+        m_delete_length = 0;
+        m_extra_cursors.clear();
+        m_batch_bases.clear();
+        m_batch_text.clear();
+        m_cursor.reset();
+
+        char* buffer = m_piece_table.begin_original(static_cast<size_t>(size));
+        if (!m_loader.start(path, buffer, static_cast<size_t>(size)))
+        {
+            std::cerr << "ERROR: Could not open file " << path << NEWLINE;
+            m_loading = true; // so stop_loading lets go of the descriptor
+            stop_loading();
+            m_piece_table = piece_table();
+            return false;
+        }
+
+        // back as soon as the first screen is there
+        m_loading = true;
+        m_loader.wait_for_pieces();
+        m_piece_table.set_line_ending(m_loader.get_line_ending());
+        poll_load();
+        return true;
+    }
+
     std::ifstream ifs(path, std::ios::binary);
     if (!ifs)
     {
         std::cerr << "ERROR: Could not open file " << path << NEWLINE;
+#if MINIEDITOR_POSIX_IO
+        if (original_fd >= 0)
+            ::close(original_fd);
+#endif
         return false;
     }
 
@@ -81,30 +495,155 @@ bool editor::open(const std::filesystem::path& path)
         str.append(chunk, ifs.gcount());
     }
 
+#if MINIEDITOR_POSIX_IO
+    // kept for saving when nothing replaced or changed the file while it was read, and the buffer will be its exact bytes
+    // (a CRLF document keeps its '\r', an LF one has them stripped)
+    close_original_file();
+    if (original_ok && is_same_file(original_fd, path, original_stat.st_size, get_mtime_ns(original_stat)) &&
+        static_cast<size_t>(original_stat.st_size) == str.size() &&
+        (piece_table::detect_line_ending(str) == line_ending::CRLF || str.find('\r') == std::string::npos))
+    {
+        m_original_fd = original_fd;
+        m_original_size = original_stat.st_size;
+        m_original_mtime_ns = get_mtime_ns(original_stat);
+    }
+    else if (original_fd >= 0)
+    {
+        ::close(original_fd);
+    }
+#endif
+
     m_current_file_path = path;
     m_dirty = false;
 
-    m_piece_table = piece_table(str);
-    m_cursor.col = 1;
-    m_cursor.col_internal = 1;
-    m_cursor.row = 1;
-    m_cursor.global_index = 0;
+    // a session snapshot of the file as it is now puts the edited document back without parsing the text
+    uint64_t file_size = 0;
+    int64_t mtime_ns = 0;
+    bool versioned = get_file_version(path, file_size, mtime_ns);
+    snapshot_header session;
+    const bool restored = versioned && read_snapshot(session_path, str, file_size, mtime_ns, m_piece_table, session);
+    if (!restored)
+        m_piece_table = piece_table(std::move(str));
+#if MINIEDITOR_POSIX_IO
+    if (restored && session.original_embedded)
+        close_original_file(); // the original buffer is not the file
+#endif
+
+    m_insert_buffer.clear();
+    m_delete_length = 0;
+    m_extra_cursors.clear();
+    m_batch_bases.clear();
+    m_batch_text.clear();
+    m_cursor.reset();
+    if (restored)
+    {
+        m_dirty = true;
+        set_cursor_to_index(session.cursor);
+
+        // a journal goes on top of the snapshot it was restarted with
+        versioned = get_file_version(session_path, file_size, mtime_ns);
+    }
+
+    // edits a session made and never saved. a journal for another version of the file is dropped
+    m_journal.close();
+    if (versioned && std::filesystem::exists(journal_path, ec) &&
+        m_journal.resume(journal_path, file_size, mtime_ns, m_piece_table, m_journal_sync) > 0)
+        m_dirty = true;
     return true;
 }
 
-bool editor::save()
+bool editor::poll_load()
 {
-    flush_insert_buffer();
-    return save(m_current_file_path);
+    if (!m_loading)
+        return false;
+
+    // looked at before taking, so whatever came in before the end is taken with it
+    const bool done = m_loader.is_done();
+    m_loaded_pieces.clear();
+    if (m_loader.take_pieces(m_loaded_pieces))
+        m_piece_table.append_original(m_loaded_pieces);
+    if (done)
+        finish_load();
+    return m_loading;
 }
 
-// can be optimized by using mmap, but that is not cross-platform
-// will need to refactor the function to call OS-specific functions
-bool editor::save(const std::filesystem::path& path)
+bool editor::wait_for_load()
 {
-    if (!m_dirty)
-        return true;
+    while (poll_load())
+        m_loader.wait_for_pieces();
+    return !m_load_failed;
+}
+
+bool editor::is_loading() const
+{
+    return m_loading;
+}
+
+size_t editor::get_load_progress() const
+{
+    return m_loader.get_bytes_read();
+}
+
+size_t editor::get_load_length() const
+{
+    return m_loader.get_size();
+}
+
+void editor::finish_load()
+{
+    const size_t bytes_read = m_loader.get_bytes_read();
+    m_load_failed = m_loader.failed();
+    const bool stripped = m_loader.has_carriage_returns();
+    m_loader.cancel(); // only joins, it is done
+    m_loading = false;
+
+    if (m_load_failed)
+    {
+        // half a file must not be saved over the whole one
+        std::cerr << "ERROR: Could not read file " << m_current_file_path << NEWLINE;
+#if MINIEDITOR_POSIX_IO
+        if (m_loading_fd >= 0)
+            ::close(m_loading_fd);
+        m_loading_fd = -1;
+#endif
+        m_piece_table = piece_table();
+        m_current_file_path.clear();
+        m_dirty = false;
+        m_cursor.reset();
+        return;
+    }
+    m_piece_table.end_original(bytes_read);
+
+#if MINIEDITOR_POSIX_IO
+    // kept for saving when nothing replaced or changed the file while it was read, and the buffer is its exact bytes
+    if (m_loading_fd >= 0 && bytes_read == m_loader.get_size() && !stripped &&
+        is_same_file(m_loading_fd, m_current_file_path, m_original_size, m_original_mtime_ns))
+        m_original_fd = m_loading_fd;
+    else if (m_loading_fd >= 0)
+        ::close(m_loading_fd);
+    m_loading_fd = -1;
+#else
+    (void)stripped;
+#endif
+}
+
+void editor::stop_loading()
+{
+    if (!m_loading)
+        return;
+
+    m_loader.cancel();
+    m_loading = false;
+#if MINIEDITOR_POSIX_IO
+    if (m_loading_fd >= 0)
+        ::close(m_loading_fd);
+    m_loading_fd = -1;
+#endif
+}
 
+// a new file, or a regular one to save over
+static bool is_savable_path(const std::filesystem::path& path)
+{
     if (path.empty())
         return false;
 
@@ -119,10 +658,60 @@ bool editor::save(const std::filesystem::path& path)
             return false;
         }
     }
+    return true;
+}
+
+bool editor::save()
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SAVE);
+    flush_buffers();
+    return save(m_current_file_path);
+}
+
+// POSIX systems write the pieces with writev and copy_file_range (piece_table::write_to_fd), anything else goes through an ofstream
+bool editor::save(const std::filesystem::path& path)
+{
+    wait_for_save();
+    if (!wait_for_load())
+        return false;
+    if (!m_dirty)
+        return true;
+
+    if (!is_savable_path(path))
+        return false;
+
+#if MINIEDITOR_POSIX_IO
+    // same length and only a few changed bytes: patch them into the file instead of writing all of it
+    if (path == m_current_file_path && save_in_place())
+    {
+        m_dirty = false;
+        on_saved();
+        return true;
+    }
+#endif
 
     std::filesystem::path temp_file_path = path;
     temp_file_path += ".tmp";
+    std::error_code ec;
+
+#if MINIEDITOR_POSIX_IO
+    // the pieces go to the file with writev straight from the buffers, no stream buffer in between
+    const int fd = ::open(temp_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        std::cerr << "ERROR: Could not open file to save. Path: " << path << NEWLINE;
+        return false;
+    }
 
+    // unchanged parts of the file that was opened are copied from it in the kernel
+    const bool written = m_piece_table.write_to_fd(fd, m_disk_patches.empty() ? get_original_fd() : -1);
+    if (::close(fd) != 0 || !written)
+    {
+        std::cerr << "ERROR: Writing the file failed. Path: " << temp_file_path << NEWLINE;
+        std::filesystem::remove(temp_file_path, ec);
+        return false;
+    }
+#else
     std::ofstream ofs(temp_file_path, std::ios::binary);
     if (!ofs)
     {
@@ -140,6 +729,7 @@ bool editor::save(const std::filesystem::path& path)
     // }
 
     ofs.close();
+#endif
 
     // then we try to write to the actual file
     std::filesystem::rename(temp_file_path, path, ec);
@@ -149,48 +739,216 @@ bool editor::save(const std::filesystem::path& path)
         return false;
     }
 
+#if MINIEDITOR_POSIX_IO
+    // left over by a failed in-place save, and it does not belong to the new file
+    std::filesystem::remove(get_wal_path(path), ec);
+#endif
+
     m_current_file_path = path;
     m_dirty = false;
+    on_saved();
     return true;
 }
 
-bool editor::quit(bool force_quit, bool save_automatically)
+bool editor::save_async()
 {
-    if (force_quit)
-        goto quit;
-
-    if (save_automatically)
-        save();
+    return save_async(m_current_file_path);
+}
 
-    if (m_dirty)
+bool editor::save_async(const std::filesystem::path& path)
+{
+    flush_buffers();
+    if (!wait_for_load())
+        return false;
+    if (m_save_thread.joinable())
     {
-        std::cerr << "ERROR: Save current file before opening another\n";
+        std::cerr << "ERROR: A save is already running. Path: " << m_save_path << NEWLINE;
         return false;
     }
+    if (!m_dirty)
+        return true;
+    if (!is_savable_path(path))
+        return false;
 
-quit:
-    m_piece_table.clear();
-    m_cursor.reset();
-    m_current_file_path.clear();
+#if MINIEDITOR_POSIX_IO
+    // a few changed bytes are patched in right away, that is no slower than starting a thread
+    if (path == m_current_file_path && save_in_place())
+    {
+        m_dirty = false;
+        on_saved();
+        return true;
+    }
+#endif
+
+    std::filesystem::path temp_file_path = path;
+    temp_file_path += ".tmp";
+
+#if MINIEDITOR_POSIX_IO
+    const int fd = ::open(temp_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        std::cerr << "ERROR: Could not open file to save. Path: " << path << NEWLINE;
+        return false;
+    }
+    const int original_fd = m_disk_patches.empty() ? get_original_fd() : -1; // stays open, open() and the destructor wait
+#endif
+
+    // the file will hold the document as it is now. any edit from here on makes it dirty again
+    m_save_document = m_piece_table.freeze();
+    m_save_path = path;
+    m_save_journal_checkpoint = m_journal.checkpoint();
+    m_save_written.store(0, std::memory_order_relaxed);
+    m_save_finished.store(false, std::memory_order_relaxed);
+    m_dirty = false;
 
+#if MINIEDITOR_POSIX_IO
+    m_save_thread = std::thread([this, fd, original_fd]() {
+        const bool written = piece_table::write_frozen(fd, m_save_document, original_fd, m_save_written);
+        m_save_succeeded = ::close(fd) == 0 && written;
+        m_save_finished.store(true, std::memory_order_release);
+    });
+#else
+    m_save_thread = std::thread([this, temp_file_path]() {
+        std::ofstream ofs(temp_file_path, std::ios::binary);
+        for (const piece& p : m_save_document.pieces)
+        {
+            if (!ofs)
+                break;
+            const std::string_view buffer = p.buf_type == buffer_type::ORIGINAL ? m_save_document.original : m_save_document.add;
+            ofs.write(buffer.data() + p.start, static_cast<std::streamsize>(p.length));
+            m_save_written.fetch_add(p.length, std::memory_order_relaxed);
+        }
+        ofs.close();
+        m_save_succeeded = static_cast<bool>(ofs);
+        m_save_finished.store(true, std::memory_order_release);
+    });
+#endif
     return true;
 }
 
-std::string editor::get_line(size_t line_number) const
+save_status editor::poll_save()
 {
-    if (line_number == 0 || line_number > m_piece_table.get_line_count())
-        return "";
+    if (!m_save_thread.joinable())
+        return save_status::NONE;
+    if (!m_save_finished.load(std::memory_order_acquire))
+        return save_status::RUNNING;
+    return finish_save() ? save_status::DONE : save_status::FAILED;
+}
 
-    return m_piece_table.get_line(line_number);
+bool editor::wait_for_save()
+{
+    return !m_save_thread.joinable() || finish_save();
 }
 
-void editor::insert_char(char c)
+bool editor::is_saving() const
 {
-    m_dirty = true;
+    return m_save_thread.joinable();
+}
 
-    if (m_insert_buffer.empty())
-    {
-        m_insert_position = m_cursor.global_index;
+size_t editor::get_save_progress() const
+{
+    return m_save_written.load(std::memory_order_relaxed);
+}
+
+size_t editor::get_save_length() const
+{
+    return m_save_document.length;
+}
+
+bool editor::finish_save()
+{
+    m_save_thread.join();
+    m_piece_table.thaw();
+    m_save_document = frozen_document();
+
+    std::filesystem::path temp_file_path = m_save_path;
+    temp_file_path += ".tmp";
+    std::error_code ec;
+    if (!m_save_succeeded)
+    {
+        std::cerr << "ERROR: Writing the file failed. Path: " << temp_file_path << NEWLINE;
+        std::filesystem::remove(temp_file_path, ec);
+        m_dirty = true;
+        return false;
+    }
+
+    std::filesystem::rename(temp_file_path, m_save_path, ec);
+    if (ec)
+    {
+        std::cerr << "ERROR: Saving to file failed. Path: " << m_save_path << NEWLINE;
+        std::filesystem::remove(temp_file_path, ec);
+        m_dirty = true;
+        return false;
+    }
+
+#if MINIEDITOR_POSIX_IO
+    std::filesystem::remove(get_wal_path(m_save_path), ec);
+#endif
+
+    // the journal keeps only the edits made while the file was being written, on top of the new file
+    m_current_file_path = m_save_path;
+    std::filesystem::remove(get_session_path(m_current_file_path), ec);
+    drop_autosave();
+    uint64_t file_size = 0;
+    int64_t mtime_ns = 0;
+    if (m_journal.is_open() && get_file_version(m_current_file_path, file_size, mtime_ns))
+        m_journal.rebase(get_journal_path(m_current_file_path), m_save_journal_checkpoint, file_size, mtime_ns);
+    return true;
+}
+
+bool editor::quit(bool force_quit, bool save_automatically)
+{
+    wait_for_save();
+    if (force_quit)
+        goto quit;
+
+    if (save_automatically)
+        save();
+
+    if (m_dirty)
+    {
+        std::cerr << "ERROR: Save current file before opening another\n";
+        return false;
+    }
+
+quit:
+    stop_loading();
+    m_journal.discard(); // what it held is saved or thrown away
+    drop_autosave();
+    std::error_code ec;
+    std::filesystem::remove(get_session_path(m_current_file_path), ec);
+    m_piece_table.clear();
+    m_insert_buffer.clear();
+    m_delete_length = 0;
+    m_extra_cursors.clear();
+    m_batch_bases.clear();
+    m_batch_text.clear();
+    m_cursor.reset();
+    m_current_file_path.clear();
+
+    return true;
+}
+
+std::string editor::get_line(size_t line_number) const
+{
+    return m_piece_table.get_line(line_number);
+}
+
+void editor::insert_char(char c)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::INSERT_CHAR);
+    if (!m_extra_cursors.empty())
+    {
+        insert_char_at_cursors(c);
+        return;
+    }
+
+    m_dirty = true;
+    flush_delete_buffer();
+
+    if (m_insert_buffer.empty())
+    {
+        m_insert_position = m_cursor.global_index;
     }
 
     m_insert_buffer.push_back(c);
@@ -200,7 +958,7 @@ void editor::insert_char(char c)
         flush_insert_buffer();
         m_cursor.row++;
         m_cursor.col = 1;
-        m_cursor.global_index++;
+        m_cursor.global_index += m_piece_table.get_line_break().length();
         return;
     }
 
@@ -213,32 +971,124 @@ void editor::insert_char(char c)
     m_cursor.global_index++;
 }
 
+void editor::insert_text(std::string_view text)
+{
+    if (text.empty())
+        return;
+
+    flush_buffers();
+    m_extra_cursors.clear();
+    m_dirty = true;
+
+    const size_t length_before = m_piece_table.length();
+    m_piece_table.insert(m_cursor.global_index, text);
+    m_journal.record_insert(m_cursor.global_index, text);
+    const size_t inserted = m_piece_table.length() - length_before; // '\r' is stripped on the way in
+
+    // only the text after the last newline decides the new column
+    const size_t last_newline = text.rfind(NEWLINE);
+    if (last_newline == std::string_view::npos)
+    {
+        m_cursor.col += inserted;
+    }
+    else
+    {
+        const std::string_view last_line = text.substr(last_newline + 1);
+        m_cursor.row += std::count(text.begin(), text.end(), NEWLINE);
+        m_cursor.col = last_line.length() - std::count(last_line.begin(), last_line.end(), '\r') + 1;
+    }
+
+    m_cursor.col_internal = m_cursor.col;
+    m_cursor.global_index += inserted;
+}
+
 void editor::delete_char()
 {
-    flush_insert_buffer();
+    MINIEDITOR_LATENCY_SCOPE(latency_op::DELETE_CHAR);
+    if (!m_extra_cursors.empty())
+    {
+        delete_char_at_cursors();
+        return;
+    }
 
     m_dirty = true;
     if (m_cursor.global_index == 0)
         return;
 
-    if (char deleted_char = m_piece_table.get_char_at(m_cursor.global_index - 1); deleted_char == NEWLINE)
+    // backspacing over text that is still in the insert buffer never reaches the piece table
+    if (!m_insert_buffer.empty())
     {
-        m_piece_table.remove(m_cursor.global_index - 1, 1);
+        m_insert_buffer.pop_back();
         m_cursor.global_index--;
+        m_cursor.col--;
+        return;
+    }
+
+    if (m_piece_table.get_char_at(m_cursor.global_index - 1) == NEWLINE)
+    {
+        // joining two lines ends the batch, the same way typing a newline does. a "\r\n" goes as a whole
+        flush_delete_buffer();
+        const size_t removed = m_cursor.global_index >= 2 && m_piece_table.get_char_at(m_cursor.global_index - 2) == '\r' ? 2 : 1;
+        m_piece_table.remove(m_cursor.global_index - removed, removed);
+        m_journal.record_remove(m_cursor.global_index - removed, removed);
+        m_cursor.global_index -= removed;
         m_cursor.row--;
-        m_cursor.col = m_piece_table.get_line_length(m_cursor.row) + 1;
+        m_cursor.col = m_cursor.global_index - m_piece_table.get_index_for_line(m_cursor.row) + 1;
+        return;
     }
-    else
+
+    // the batch always starts at the cursor, so every backspace just grows it to the left
+    m_cursor.global_index--;
+    m_cursor.col--;
+    m_delete_length++;
+
+    if (m_delete_length == m_max_delete_buffer_length)
     {
-        m_piece_table.remove(m_cursor.global_index - 1, 1);
-        m_cursor.global_index--;
-        m_cursor.col--;
+        flush_delete_buffer();
+    }
+}
+
+void editor::delete_range(size_t begin, size_t end)
+{
+    flush_buffers();
+    m_extra_cursors.clear();
+
+    end = std::min(end, m_piece_table.length());
+    if (begin >= end)
+        return;
+
+    m_dirty = true;
+
+    // rows that disappear before the cursor, read from the newline aggregates before the text is removed
+    const size_t removed_before_cursor_end = std::min(m_cursor.global_index, end);
+    const size_t removed_rows = removed_before_cursor_end > begin ? m_piece_table.get_newline_count_before(removed_before_cursor_end) -
+                                                                        m_piece_table.get_newline_count_before(begin)
+                                                                  : 0;
+
+    m_piece_table.remove(begin, end - begin);
+    m_journal.record_remove(begin, end - begin);
+
+    if (m_cursor.global_index > begin)
+    {
+        m_cursor.global_index = m_cursor.global_index >= end ? m_cursor.global_index - (end - begin) : begin;
+        m_cursor.row -= removed_rows;
+        m_cursor.col = m_cursor.global_index - m_piece_table.get_index_for_line(m_cursor.row) + 1;
+        m_cursor.col_internal = m_cursor.col;
+    }
+
+    // the removed bytes may have brought a '\r' and a '\n' together around the cursor, it stays in front of both
+    if (outside_line_break(m_cursor.global_index) != m_cursor.global_index)
+    {
+        --m_cursor.global_index;
+        --m_cursor.col;
+        m_cursor.col_internal = m_cursor.col;
     }
 }
 
 void editor::move_cursor(direction dir)
 {
-    flush_insert_buffer();
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
     switch (dir)
     {
         case direction::UP:
@@ -270,57 +1120,26 @@ void editor::handle_cursor_up()
         return;
     }
 
-    m_cursor.row--;
-
-    size_t line_len = m_piece_table.get_line_length(m_cursor.row);
-    if (m_cursor.col_internal > line_len + 1)
-    {
-        m_cursor.col = line_len + 1;
-    }
-    else
-    {
-        m_cursor.col = m_cursor.col_internal;
-    }
-
-    m_cursor.global_index = m_piece_table.get_index_for_line(m_cursor.row) + m_cursor.col - 1;
+    place_cursor_on_line(m_cursor.row - 1);
 }
 
 void editor::handle_cursor_down()
 {
-    size_t line_cnt = m_piece_table.get_line_count();
-    if (line_cnt == 0)
-    {
-        m_cursor.row = 1;
-        m_cursor.col = 1;
-        m_cursor.global_index = 0;
-        return;
-    }
+    const line_info info = m_piece_table.get_line_info(m_cursor.row);
 
-    if (line_cnt == m_cursor.row)
+    // the empty line after a trailing newline can't be reached with DOWN
+    if (!info.has_newline || info.start_byte + info.length + info.newline_length >= m_piece_table.length())
     {
-        size_t line_len = m_piece_table.get_line_length(m_cursor.row);
-        if (m_cursor.col > line_len + 1)
+        if (m_cursor.col > info.length + 1)
         {
-            m_cursor.col = line_len + 1;
-            m_cursor.col_internal = line_len + 1;
+            m_cursor.col = info.length + 1;
+            m_cursor.col_internal = info.length + 1;
         }
-        m_cursor.global_index = m_piece_table.get_index_for_line(m_cursor.row) + m_cursor.col - 1;
+        m_cursor.global_index = info.start_byte + m_cursor.col - 1;
         return;
     }
 
-    m_cursor.row++;
-
-    size_t line_len = m_piece_table.get_line_length(m_cursor.row);
-    if (m_cursor.col_internal > line_len + 1)
-    {
-        m_cursor.col = line_len + 1;
-    }
-    else
-    {
-        m_cursor.col = m_cursor.col_internal;
-    }
-
-    m_cursor.global_index = m_piece_table.get_index_for_line(m_cursor.row) + m_cursor.col - 1;
+    place_cursor_on_line(m_cursor.row + 1);
 }
 
 void editor::handle_cursor_left()
@@ -330,17 +1149,19 @@ void editor::handle_cursor_left()
 
     if (m_cursor.col == 1)
     {
-        // move to last line
+        // move to last line, in front of its line break
         m_cursor.row--;
-        m_cursor.col = m_piece_table.get_line_length(m_cursor.row) + 1;
+        const line_info info = m_piece_table.get_line_info(m_cursor.row);
+        m_cursor.col = info.length + 1;
         m_cursor.col_internal = m_cursor.col;
+        m_cursor.global_index -= info.newline_length;
     }
     else
     {
         m_cursor.col--;
         m_cursor.col_internal = m_cursor.col;
+        m_cursor.global_index--;
     }
-    m_cursor.global_index--;
 }
 
 void editor::handle_cursor_right()
@@ -348,16 +1169,16 @@ void editor::handle_cursor_right()
     if (m_cursor.global_index >= m_piece_table.length())
         return;
 
-    size_t line_len = m_piece_table.get_line_length(m_cursor.row);
-    if (m_cursor.col > line_len)
+    const line_info info = m_piece_table.get_line_info(m_cursor.row);
+    if (m_cursor.col > info.length)
     {
         // at end of line, move to next line if available
-        if (m_cursor.row < m_piece_table.get_line_count())
+        if (info.has_newline && info.start_byte + info.length + info.newline_length < m_piece_table.length())
         {
             m_cursor.row++;
             m_cursor.col = 1;
             m_cursor.col_internal = 1;
-            m_cursor.global_index++;
+            m_cursor.global_index += info.newline_length;
         }
     }
     else
@@ -368,17 +1189,734 @@ void editor::handle_cursor_right()
     }
 }
 
+void editor::place_cursor_on_line(size_t row)
+{
+    m_cursor.row = row;
+
+    const line_info info = m_piece_table.get_line_info(row);
+    m_cursor.col = std::min(m_cursor.col_internal, info.length + 1);
+    m_cursor.global_index = info.start_byte + m_cursor.col - 1;
+}
+
+void editor::goto_line(size_t line_number)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+    if (line_number >= get_total_lines())
+        wait_for_load(); // the line may not be read yet
+    place_cursor_on_line(std::clamp<size_t>(line_number, 1, get_total_lines()));
+}
+
+void editor::move_page_up(size_t page_height)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+    if (m_cursor.row <= page_height)
+    {
+        move_to_document_start();
+        return;
+    }
+
+    place_cursor_on_line(m_cursor.row - page_height);
+}
+
+void editor::move_page_down(size_t page_height)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+    const size_t total_lines = get_total_lines();
+    if (m_cursor.row + page_height >= total_lines)
+    {
+        // the last page keeps the column when it can, like the last DOWN would
+        place_cursor_on_line(total_lines);
+        return;
+    }
+
+    place_cursor_on_line(m_cursor.row + page_height);
+}
+
+void editor::move_to_line_start()
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+
+    // the line start is exactly col - 1 bytes behind the cursor
+    m_cursor.global_index -= m_cursor.col - 1;
+    m_cursor.col = 1;
+    m_cursor.col_internal = 1;
+}
+
+void editor::move_to_line_end()
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+
+    size_t line_len = m_piece_table.get_line_length(m_cursor.row);
+    m_cursor.global_index += line_len + 1 - m_cursor.col;
+    m_cursor.col = line_len + 1;
+    m_cursor.col_internal = m_cursor.col;
+}
+
+void editor::move_to_document_start()
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+    m_cursor.reset();
+}
+
+void editor::move_to_document_end()
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+    wait_for_load();
+
+    // the last line may be the empty line after a trailing newline
+    m_cursor.row = get_total_lines();
+    m_cursor.global_index = m_piece_table.length();
+    m_cursor.col = m_cursor.global_index - m_piece_table.get_index_for_line(m_cursor.row) + 1;
+    m_cursor.col_internal = m_cursor.col;
+}
+
+void editor::set_cursor_to_index(size_t global_index)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::MOVE_CURSOR);
+    flush_buffers();
+
+    global_index = outside_line_break(std::min(global_index, m_piece_table.length()));
+    const text_position pos = m_piece_table.get_line_col_for_index(global_index);
+    m_cursor.global_index = global_index;
+    m_cursor.row = pos.line;
+    m_cursor.col = pos.col;
+    m_cursor.col_internal = pos.col;
+}
+
+size_t editor::outside_line_break(size_t global_index) const
+{
+    if (m_piece_table.get_line_ending() == line_ending::CRLF && global_index > 0 && m_piece_table.get_char_at(global_index) == NEWLINE &&
+        m_piece_table.get_char_at(global_index - 1) == '\r')
+        return global_index - 1;
+    return global_index;
+}
+
+bool editor::find_next(std::string_view pattern)
+{
+    flush_buffers();
+    wait_for_load(); // the search wraps around all of it
+
+    const searcher search(pattern);
+    size_t match = search.find_next(m_piece_table, m_cursor.global_index + 1);
+    if (match == searcher::npos)
+        match = search.find_next(m_piece_table, 0); // wrap around
+
+    if (match == searcher::npos)
+        return false;
+
+    set_cursor_to_index(match);
+    return true;
+}
+
+bool editor::find_prev(std::string_view pattern)
+{
+    flush_buffers();
+    wait_for_load();
+
+    const searcher search(pattern);
+    size_t match = search.find_prev(m_piece_table, m_cursor.global_index);
+    if (match == searcher::npos)
+        match = search.find_prev(m_piece_table, m_piece_table.length()); // wrap around
+
+    if (match == searcher::npos)
+        return false;
+
+    set_cursor_to_index(match);
+    return true;
+}
+
+bool editor::find_next(const regex& pattern)
+{
+    flush_buffers();
+    wait_for_load();
+
+    regex_match match = pattern.find_next(m_piece_table, m_cursor.global_index + 1);
+    if (match.begin == regex::npos)
+        match = pattern.find_next(m_piece_table, 0); // wrap around
+
+    if (match.begin == regex::npos)
+        return false;
+
+    set_cursor_to_index(match.begin);
+    return true;
+}
+
+bool editor::find_prev(const regex& pattern)
+{
+    flush_buffers();
+    wait_for_load();
+
+    regex_match match = pattern.find_prev(m_piece_table, m_cursor.global_index);
+    if (match.begin == regex::npos)
+        match = pattern.find_prev(m_piece_table, m_piece_table.length()); // wrap around
+
+    if (match.begin == regex::npos)
+        return false;
+
+    set_cursor_to_index(match.begin);
+    return true;
+}
+
+size_t editor::replace_all(std::string_view pattern, std::string_view replacement)
+{
+    flush_buffers();
+    wait_for_load();
+    m_extra_cursors.clear();
+    if (pattern.empty())
+        return 0;
+
+    std::vector<size_t> matches;
+    searcher(pattern).find_all(m_piece_table, 0, m_piece_table.length(), matches);
+    if (matches.empty())
+        return 0;
+
+    // the cursor shifts by the length change of every match that ends at or before it
+    const size_t replacement_length = m_piece_table.get_inserted_length(replacement);
+    size_t new_cursor = m_cursor.global_index;
+    auto matches_before = static_cast<size_t>(std::upper_bound(matches.begin(), matches.end(), new_cursor) - matches.begin());
+    if (matches_before > 0 && matches[matches_before - 1] + pattern.length() > new_cursor)
+        new_cursor = matches[--matches_before]; // inside a match
+    new_cursor = new_cursor - matches_before * pattern.length() + matches_before * replacement_length;
+
+    const size_t replaced = m_piece_table.replace_all(matches, pattern.length(), replacement);
+    m_journal.record_replace_all(matches, pattern.length(), replacement);
+    m_dirty = true;
+    set_cursor_to_index(new_cursor);
+    return replaced;
+}
+
+size_t editor::sort_lines(bool unique)
+{
+    flush_buffers();
+    wait_for_load();
+    m_extra_cursors.clear();
+
+    const size_t lines = m_piece_table.sort_lines(get_thread_pool(), unique);
+    if (lines == 0)
+        return 0;
+    m_journal.record_sort_lines(unique);
+
+    m_dirty = true;
+    goto_line(m_cursor.row);
+    move_to_line_start();
+    return lines;
+}
+
+bool editor::apply_edits(const std::vector<text_edit>& edits)
+{
+    flush_buffers();
+    m_extra_cursors.clear();
+
+    const size_t old_length = m_piece_table.length();
+    size_t new_cursor = m_cursor.global_index;
+    for (const text_edit& e : edits)
+    {
+        if (e.position > m_cursor.global_index)
+            break;
+
+        const size_t end = std::min(e.position + e.delete_length, old_length);
+        const size_t inserted = m_piece_table.get_inserted_length(e.insert_text);
+        if (end <= m_cursor.global_index)
+            new_cursor = new_cursor + inserted - (end - e.position);
+        else
+            new_cursor -= m_cursor.global_index - e.position; // inside the deleted range
+    }
+
+    if (!m_piece_table.apply_edits(edits))
+        return false;
+    m_journal.record_edits(edits);
+
+    if (!edits.empty())
+        m_dirty = true;
+    set_cursor_to_index(new_cursor);
+    return true;
+}
+
 void editor::flush_insert_buffer()
 {
     if (m_insert_buffer.empty())
         return;
 
     m_piece_table.insert(m_insert_position, m_insert_buffer);
+    m_journal.record_insert(m_insert_position, m_insert_buffer);
 
     m_insert_position += m_insert_buffer.length();
     m_insert_buffer.clear();
 }
 
+void editor::flush_delete_buffer()
+{
+    if (m_delete_length == 0)
+        return;
+
+    // the pending range is [cursor, cursor + m_delete_length)
+    m_piece_table.remove(m_cursor.global_index, m_delete_length);
+    m_journal.record_remove(m_cursor.global_index, m_delete_length);
+    m_delete_length = 0;
+}
+
+void editor::flush_buffers()
+{
+    flush_insert_buffer();
+    flush_delete_buffer();
+    flush_cursor_batch();
+}
+
+void editor::add_cursor(size_t global_index)
+{
+    flush_buffers();
+
+    global_index = outside_line_break(std::min(global_index, m_piece_table.length()));
+    const auto it = std::lower_bound(m_extra_cursors.begin(), m_extra_cursors.end(), global_index);
+    if (global_index == m_cursor.global_index || (it != m_extra_cursors.end() && *it == global_index))
+        return;
+    m_extra_cursors.insert(it, global_index);
+}
+
+void editor::add_cursor_below()
+{
+    if (m_cursor.row >= get_total_lines())
+        return;
+
+    const size_t here = m_cursor.global_index;
+    move_cursor(direction::DOWN);
+    add_cursor(here);
+
+    // the main cursor may have landed on an extra one
+    const auto it = std::lower_bound(m_extra_cursors.begin(), m_extra_cursors.end(), m_cursor.global_index);
+    if (it != m_extra_cursors.end() && *it == m_cursor.global_index)
+        m_extra_cursors.erase(it);
+}
+
+void editor::clear_extra_cursors()
+{
+    flush_buffers();
+    m_extra_cursors.clear();
+}
+
+size_t editor::get_cursor_count() const
+{
+    return m_batch_bases.empty() ? m_extra_cursors.size() + 1 : m_batch_bases.size();
+}
+
+std::vector<size_t> editor::get_cursor_indices() const
+{
+    std::vector<size_t> out;
+    if (m_batch_bases.empty())
+    {
+        out = m_extra_cursors;
+        out.insert(std::lower_bound(out.begin(), out.end(), m_cursor.global_index), m_cursor.global_index);
+        return out;
+    }
+
+    for (size_t i = 0; i < m_batch_bases.size(); ++i)
+        out.push_back(m_batch_bases[i] + (i + 1) * m_batch_text.length());
+    return out;
+}
+
+void editor::begin_cursor_batch()
+{
+    m_batch_bases = m_extra_cursors;
+    const auto main = std::lower_bound(m_batch_bases.begin(), m_batch_bases.end(), m_cursor.global_index);
+    m_batch_main = static_cast<size_t>(main - m_batch_bases.begin());
+    if (main == m_batch_bases.end() || *main != m_cursor.global_index) // the main cursor may have been moved onto an extra one
+        m_batch_bases.insert(main, m_cursor.global_index);
+
+    m_batch_text.clear();
+
+    const size_t line_start = m_cursor.global_index - (m_cursor.col - 1);
+    m_batch_same_line_before = m_batch_main - static_cast<size_t>(std::lower_bound(m_batch_bases.begin(), m_batch_bases.end(), line_start) -
+                                                                  m_batch_bases.begin());
+}
+
+void editor::flush_cursor_batch()
+{
+    if (m_batch_bases.empty())
+        return;
+
+    if (!m_batch_text.empty())
+    {
+        std::vector<text_edit> edits;
+        edits.reserve(m_batch_bases.size());
+        for (const size_t base : m_batch_bases)
+            edits.push_back({.position = base, .delete_length = 0, .insert_text = m_batch_text});
+        m_piece_table.apply_edits(edits);
+        m_journal.record_edits(edits);
+    }
+
+    m_extra_cursors.clear();
+    for (size_t i = 0; i < m_batch_bases.size(); ++i)
+    {
+        if (i != m_batch_main)
+            m_extra_cursors.push_back(m_batch_bases[i] + (i + 1) * m_batch_text.length());
+    }
+
+    m_batch_bases.clear();
+    m_batch_text.clear();
+}
+
+void editor::insert_char_at_cursors(char c)
+{
+    m_dirty = true;
+    flush_insert_buffer();
+    flush_delete_buffer();
+    if (m_batch_bases.empty())
+        begin_cursor_batch();
+
+    // a newline is kept the way the piece table will write it, so the positions are right
+    m_batch_text.append(c == NEWLINE ? m_piece_table.get_line_break() : std::string_view(&c, 1));
+
+    // every cursor typed the same thing, so the main one only moves by what was typed on its own line
+    m_cursor.global_index = m_batch_bases[m_batch_main] + (m_batch_main + 1) * m_batch_text.length();
+    if (c == NEWLINE)
+    {
+        m_cursor.row += m_batch_main + 1;
+        m_cursor.col = 1;
+        m_cursor.col_internal = m_cursor.col;
+        flush_cursor_batch(); // like the insert buffer, the batch never holds a line break, so the tui can draw it over the lines
+        return;
+    }
+
+    m_cursor.col += m_batch_same_line_before + 1;
+    m_cursor.col_internal = m_cursor.col;
+    if (m_batch_text.length() == m_max_insert_buffer_length)
+        flush_cursor_batch();
+}
+
+void editor::delete_char_at_cursors()
+{
+    m_dirty = true;
+    flush_insert_buffer();
+    flush_delete_buffer();
+
+    // backspacing over pending text never reaches the piece table
+    if (!m_batch_text.empty())
+    {
+        m_batch_text.pop_back();
+        m_cursor.global_index = m_batch_bases[m_batch_main] + (m_batch_main + 1) * m_batch_text.length();
+        m_cursor.col -= m_batch_same_line_before + 1;
+        m_cursor.col_internal = m_cursor.col;
+        return;
+    }
+
+    // otherwise the character before every cursor goes in one batch ("\r\n" as a whole). cursors that end up together merge
+    flush_cursor_batch();
+    std::vector<size_t> cursors = get_cursor_indices();
+    std::vector<text_edit> edits;
+    edits.reserve(cursors.size());
+    for (size_t position : cursors)
+    {
+        if (position == 0)
+            continue;
+        const bool line_break =
+            position >= 2 && m_piece_table.get_char_at(position - 1) == NEWLINE && m_piece_table.get_char_at(position - 2) == '\r';
+        const size_t length = line_break ? 2 : 1;
+        edits.push_back({.position = position - length, .delete_length = length, .insert_text = {}});
+    }
+    m_piece_table.apply_edits(edits);
+    m_journal.record_edits(edits);
+
+    size_t removed = 0;
+    size_t main = m_cursor.global_index;
+    m_extra_cursors.clear();
+    size_t edit = 0;
+    for (size_t position : cursors)
+    {
+        if (position > 0)
+            removed += edits[edit++].delete_length;
+        const size_t moved = position - removed;
+        if (position == m_cursor.global_index)
+            main = moved;
+        else if (m_extra_cursors.empty() || m_extra_cursors.back() != moved)
+            m_extra_cursors.push_back(moved);
+    }
+
+    const auto it = std::lower_bound(m_extra_cursors.begin(), m_extra_cursors.end(), main);
+    if (it != m_extra_cursors.end() && *it == main)
+        m_extra_cursors.erase(it);
+    set_cursor_to_index(main);
+}
+
+void editor::copy_range(size_t begin, size_t end)
+{
+    flush_buffers();
+    m_clipboard = m_piece_table.copy_range(begin, end > begin ? end - begin : 0);
+    m_journal.record_copy(begin, end > begin ? end - begin : 0);
+}
+
+void editor::cut_range(size_t begin, size_t end)
+{
+    copy_range(begin, end);
+    delete_range(begin, end);
+}
+
+bool editor::paste()
+{
+    flush_buffers();
+    m_extra_cursors.clear();
+    if (!m_piece_table.paste_range(m_cursor.global_index, m_clipboard))
+        return false;
+
+    // a clipboard copied before the journal started is not in it, so the text goes in instead
+    if (m_journal.has_clipboard())
+    {
+        m_journal.record_paste(m_cursor.global_index);
+    }
+    else if (m_journal.is_open())
+    {
+        std::string text;
+        text.reserve(m_clipboard.length);
+        m_piece_table.for_each_chunk(m_cursor.global_index, [&](std::string_view chunk) {
+            text.append(chunk.substr(0, m_clipboard.length - text.length()));
+            return text.length() == m_clipboard.length;
+        });
+        m_journal.record_insert(m_cursor.global_index, text);
+    }
+
+    if (m_clipboard.length > 0)
+    {
+        m_dirty = true;
+        set_cursor_to_index(m_cursor.global_index + m_clipboard.length);
+    }
+    return true;
+}
+
+size_t editor::get_clipboard_length() const
+{
+    return m_clipboard.length;
+}
+
+bool editor::start_journal(journal_sync sync)
+{
+    flush_buffers();
+    wait_for_save();
+    wait_for_load();
+    uint64_t file_size = 0;
+    int64_t mtime_ns = 0;
+    if (m_dirty || !get_file_version(m_current_file_path, file_size, mtime_ns))
+    {
+        std::cerr << "ERROR: Save the file before starting a journal" << NEWLINE;
+        return false;
+    }
+
+    m_journal_sync = sync;
+    return m_journal.create(get_journal_path(m_current_file_path), file_size, mtime_ns, sync);
+}
+
+void editor::stop_journal()
+{
+    m_journal.discard();
+}
+
+bool editor::is_journaling() const
+{
+    return m_journal.is_open();
+}
+
+bool editor::save_session()
+{
+    flush_buffers();
+    wait_for_save(); // the journal is started over below
+    wait_for_load();
+    const std::filesystem::path session_path = get_session_path(m_current_file_path);
+    std::error_code ec;
+    if (!m_dirty)
+    {
+        std::filesystem::remove(session_path, ec); // the file is the session
+        return true;
+    }
+
+    uint64_t file_size = 0;
+    int64_t mtime_ns = 0;
+    if (!get_file_version(m_current_file_path, file_size, mtime_ns))
+    {
+        std::cerr << "ERROR: Save the file before saving the session" << NEWLINE;
+        return false;
+    }
+    if (!write_snapshot(session_path, m_piece_table, file_size, mtime_ns, !is_file_original(), m_cursor.global_index))
+        return false;
+
+    // the journal now only needs what comes after the snapshot
+    if (m_journal.is_open() && get_file_version(session_path, file_size, mtime_ns))
+        m_journal.create(get_journal_path(m_current_file_path), file_size, mtime_ns, m_journal_sync);
+    return true;
+}
+
+bool editor::is_file_original() const
+{
+#if MINIEDITOR_POSIX_IO
+    struct stat file_stat;
+    struct stat original_stat;
+    const int original_fd = get_original_fd();
+    return original_fd >= 0 && m_disk_patches.empty() && ::stat(m_current_file_path.c_str(), &file_stat) == 0 &&
+           ::fstat(original_fd, &original_stat) == 0 && file_stat.st_dev == original_stat.st_dev && file_stat.st_ino == original_stat.st_ino;
+#else
+    return false; // nothing tells, so snapshots carry the original buffer
+#endif
+}
+
+void editor::on_saved()
+{
+    std::error_code ec;
+    std::filesystem::remove(get_session_path(m_current_file_path), ec);
+    drop_autosave();
+    if (!m_journal.is_open())
+        return;
+
+    // the saved file has every edit, so the journal starts empty (and next to it, after a save as)
+    m_journal.discard();
+    uint64_t file_size = 0;
+    int64_t mtime_ns = 0;
+    if (get_file_version(m_current_file_path, file_size, mtime_ns))
+        m_journal.create(get_journal_path(m_current_file_path), file_size, mtime_ns, m_journal_sync);
+}
+
+void editor::set_autosave(std::chrono::milliseconds interval, size_t bytes_per_second)
+{
+    m_autosave_interval = interval;
+    m_autosaver.set_budget(bytes_per_second);
+    m_last_autosave = std::chrono::steady_clock::now();
+}
+
+void editor::autosave_tick()
+{
+    finish_autosave();
+    const auto now = std::chrono::steady_clock::now();
+    if (m_autosave_interval.count() <= 0 || m_autosave_running || m_has_recovery || now - m_last_autosave < m_autosave_interval)
+        return;
+    m_last_autosave = now;
+    if (m_loading)
+        return; // half the file is no copy of it
+
+    // pending typing goes in with it. a clean document is the file, and an unchanged one is in the sidecar already
+    flush_buffers();
+    if (!m_dirty || m_current_file_path.empty() || m_piece_table.get_version() == m_autosaved_version)
+        return;
+
+    m_autosave_version = m_piece_table.get_version();
+    m_autosave_document = m_piece_table.freeze();
+    m_autosave_running = m_autosaver.write(get_autosave_path(m_current_file_path), m_autosave_document);
+    if (!m_autosave_running)
+    {
+        m_piece_table.thaw();
+        m_autosave_document = frozen_document();
+    }
+}
+
+bool editor::is_autosaving() const
+{
+    return m_autosave_running;
+}
+
+void editor::finish_autosave()
+{
+    if (!m_autosave_running || !m_autosaver.is_idle())
+        return;
+
+    m_piece_table.thaw();
+    m_autosave_document = frozen_document();
+    m_autosave_running = false;
+    if (m_autosaver.succeeded())
+        m_autosaved_version = m_autosave_version;
+}
+
+void editor::stop_autosave()
+{
+    if (!m_autosave_running)
+        return;
+
+    m_autosaver.cancel();
+    m_piece_table.thaw();
+    m_autosave_document = frozen_document();
+    m_autosave_running = false;
+}
+
+void editor::drop_autosave()
+{
+    stop_autosave();
+    m_autosaved_version = UINT64_MAX;
+    m_has_recovery = false;
+    std::error_code ec;
+    std::filesystem::remove(get_autosave_path(m_current_file_path), ec);
+}
+
+bool editor::has_recovery() const
+{
+    return m_has_recovery;
+}
+
+bool editor::recover()
+{
+    if (!m_has_recovery)
+        return false;
+
+    std::ifstream ifs(get_autosave_path(m_current_file_path), std::ios::binary);
+    if (!ifs)
+    {
+        std::cerr << "ERROR: Could not open the autosave. Path: " << get_autosave_path(m_current_file_path) << NEWLINE;
+        return false;
+    }
+    std::string str((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    wait_for_save();
+    stop_autosave();
+    stop_loading();
+#if MINIEDITOR_POSIX_IO
+    close_original_file(); // the original buffer is not the file
+#endif
+    m_journal.discard(); // its edits go on top of the file, not of the copy
+
+    // the sidecar stays until a save, it still is the copy of this document
+    m_piece_table = piece_table(std::move(str));
+    m_autosaved_version = m_piece_table.get_version();
+    m_has_recovery = false;
+    m_dirty = true;
+    m_insert_buffer.clear();
+    m_delete_length = 0;
+    m_extra_cursors.clear();
+    m_batch_bases.clear();
+    m_batch_text.clear();
+    m_cursor.reset();
+    return true;
+}
+
+void editor::discard_recovery()
+{
+    std::error_code ec;
+    std::filesystem::remove(get_autosave_path(m_current_file_path), ec);
+    m_has_recovery = false;
+}
+
+anchor_id editor::add_anchor(size_t global_index)
+{
+    flush_buffers();
+    return m_piece_table.add_anchor(global_index);
+}
+
+void editor::remove_anchor(anchor_id id)
+{
+    m_piece_table.remove_anchor(id);
+}
+
+size_t editor::get_anchor_index(anchor_id id)
+{
+    flush_buffers();
+    return m_piece_table.get_anchor_index(id);
+}
+
+text_position editor::get_anchor_position(anchor_id id)
+{
+    flush_buffers();
+    return m_piece_table.get_anchor_position(id);
+}
+
 size_t editor::get_total_lines() const
 {
     size_t lines = m_piece_table.get_line_count();
@@ -419,6 +1957,11 @@ const std::string& editor::get_insert_buffer() const
     return m_insert_buffer;
 }
 
+size_t editor::get_delete_buffer_length() const
+{
+    return m_delete_length;
+}
+
 size_t editor::get_insert_buffer_start_col() const
 {
     if (m_insert_buffer.empty())
@@ -427,4 +1970,22 @@ size_t editor::get_insert_buffer_start_col() const
     return m_cursor.col - m_insert_buffer.length();
 }
 
+const std::string& editor::get_cursor_batch_text() const
+{
+    return m_batch_text;
+}
+
+void editor::get_cursor_batch_columns(size_t line_number, std::vector<size_t>& cols) const
+{
+    cols.clear();
+    if (m_batch_text.empty())
+        return;
+
+    // the bases are sorted, so the cursors on a line are one run of them
+    const line_info info = m_piece_table.get_line_info(line_number);
+    for (auto it = std::lower_bound(m_batch_bases.begin(), m_batch_bases.end(), info.start_byte);
+         it != m_batch_bases.end() && *it <= info.start_byte + info.length; ++it)
+        cols.push_back(*it - info.start_byte + 1);
+}
+
 } // namespace AL
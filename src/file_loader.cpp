@@ -0,0 +1,136 @@
+#include "file_loader.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <fstream>
+
+namespace AL
+{
+
+file_loader::~file_loader()
+{
+    cancel();
+}
+
+bool file_loader::start(const std::filesystem::path& path, char* buffer, size_t size)
+{
+    cancel();
+    std::ifstream probe(path, std::ios::binary);
+    if (!probe)
+        return false;
+
+    m_ready.clear();
+    m_done = false;
+    m_failed = false;
+    m_carriage_returns = false;
+    m_line_ending = line_ending::LF;
+    m_cancelled.store(false, std::memory_order_relaxed);
+    m_bytes_read.store(0, std::memory_order_relaxed);
+    m_size = size;
+    m_thread = std::thread([this, path, buffer, size]() { run(path, buffer, size); });
+    return true;
+}
+
+void file_loader::run(std::filesystem::path path, char* buffer, size_t size)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    std::vector<piece> pieces;
+    size_t offset = 0;
+    bool stripped = false;
+    line_ending ending = line_ending::LF;
+    bool ok = static_cast<bool>(ifs);
+    while (ok && offset < size && !m_cancelled.load(std::memory_order_relaxed))
+    {
+        const size_t length = std::min(m_chunk_length, size - offset);
+        ifs.read(buffer + offset, static_cast<std::streamsize>(length));
+        const auto got = static_cast<size_t>(ifs.gcount());
+
+        // the first chunk decides how lines end. a file whose first line is longer than a chunk loads as LF
+        if (offset == 0)
+            ending = piece_table::detect_line_ending({buffer, got});
+
+        // the chunk's '\r' are stripped and its newlines counted on the shared pool while the next read waits
+        pieces.clear();
+        stripped = piece_table::load_original(buffer, offset, got, ending, get_thread_pool(), pieces) > 0 || stripped;
+        offset += got;
+        {
+            std::lock_guard lock(m_mutex);
+            m_ready.insert(m_ready.end(), pieces.begin(), pieces.end());
+            m_carriage_returns = stripped;
+            m_line_ending = ending;
+        }
+        m_bytes_read.store(offset, std::memory_order_relaxed);
+        m_ready_changed.notify_all();
+
+        // a file that got shorter since its size was taken ends here, like a blocking read would
+        ok = got == length;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_done = true;
+        m_failed = ifs.bad() || (offset < size && !ifs.eof() && !m_cancelled.load(std::memory_order_relaxed));
+    }
+    m_ready_changed.notify_all();
+}
+
+bool file_loader::take_pieces(std::vector<piece>& out)
+{
+    std::lock_guard lock(m_mutex);
+    if (m_ready.empty())
+        return false;
+    out.insert(out.end(), m_ready.begin(), m_ready.end());
+    m_ready.clear();
+    return true;
+}
+
+void file_loader::wait_for_pieces()
+{
+    std::unique_lock lock(m_mutex);
+    if (m_thread.joinable())
+        m_ready_changed.wait(lock, [this]() { return m_done || !m_ready.empty(); });
+}
+
+void file_loader::cancel()
+{
+    m_cancelled.store(true, std::memory_order_relaxed);
+    if (m_thread.joinable())
+        m_thread.join();
+    std::lock_guard lock(m_mutex);
+    m_ready.clear();
+}
+
+bool file_loader::is_done() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_done;
+}
+
+bool file_loader::failed() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_failed;
+}
+
+bool file_loader::has_carriage_returns() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_carriage_returns;
+}
+
+line_ending file_loader::get_line_ending() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_line_ending;
+}
+
+size_t file_loader::get_bytes_read() const
+{
+    return m_bytes_read.load(std::memory_order_relaxed);
+}
+
+size_t file_loader::get_size() const
+{
+    return m_size;
+}
+
+} // namespace AL
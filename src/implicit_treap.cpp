@@ -114,6 +114,39 @@ void implicit_treap::find_by_byte(size_t index, node*& n, size_t& byte_offset) c
     find_by_byte(index, m_root, n, byte_offset);
 }
 
+void implicit_treap::find_by_byte(size_t index, node* current, node*& n, size_t& byte_offset, size_t& newlines_before) const
+{
+    if (!current)
+        return;
+
+    const size_t left_len = get_subtree_length(current->left);
+
+    if (index < left_len)
+    {
+        find_by_byte(index, current->left, n, byte_offset, newlines_before);
+    }
+    else if (index < left_len + current->data.length)
+    {
+        byte_offset += left_len;
+        newlines_before += get_subtree_newlines(current->left);
+        n = current;
+    }
+    else
+    {
+        byte_offset += left_len + current->data.length;
+        newlines_before += get_subtree_newlines(current->left) + current->data.newline_count;
+        find_by_byte(index - left_len - current->data.length, current->right, n, byte_offset, newlines_before);
+    }
+}
+
+void implicit_treap::find_by_byte(size_t index, node*& n, size_t& byte_offset, size_t& newlines_before) const
+{
+    byte_offset = 0;
+    newlines_before = 0;
+    n = nullptr;
+    find_by_byte(index, m_root, n, byte_offset, newlines_before);
+}
+
 void implicit_treap::find_line_position(size_t target_line, node* current, size_t newlines_before, node*& n, size_t& byte_offset,
                                         size_t& line_in_piece) const
 {
@@ -263,4 +296,43 @@ void implicit_treap::get_pieces(std::vector<piece>& pieces) const
 {
     return get_pieces(m_root, pieces);
 }
+
+node* implicit_treap::build_nodes(const std::vector<piece>& pieces)
+{
+    // the nodes arrive in order, so the tree is built along its right spine (a cartesian tree on the priorities).
+    // a node leaves the spine once everything below it is final, so that is when its sizes are filled in.
+    // each node is pushed and popped once. the priorities are random, so the depth is O(log n) like any other treap
+    std::vector<node*> spine;
+    for (const piece& p : pieces)
+    {
+        if (p.length == 0)
+            continue;
+
+        node* n = allocate_node(p);
+        node* last = nullptr;
+        while (!spine.empty() && spine.back()->priority < n->priority)
+        {
+            last = spine.back();
+            last->update_size();
+            spine.pop_back();
+        }
+
+        n->left = last;
+        if (!spine.empty())
+            spine.back()->right = n;
+        spine.push_back(n);
+    }
+
+    for (auto it = spine.rbegin(); it != spine.rend(); ++it)
+        (*it)->update_size();
+
+    return spine.empty() ? nullptr : spine.front();
+}
+
+void implicit_treap::build(const std::vector<piece>& pieces)
+{
+    node* root = build_nodes(pieces);
+    delete_nodes(m_root);
+    m_root = root;
+}
 } // namespace AL
@@ -0,0 +1,429 @@
+#include "journal.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#if MINIEDITOR_POSIX_IO
+#include <unistd.h>
+#endif
+
+namespace AL
+{
+
+namespace
+{
+
+// header: magic, size and mtime of the file the journal applies to, FNV-1a hash of those
+constexpr char JOURNAL_MAGIC[8] = {'M', 'E', 'J', 'R', 'N', 'L', '0', '1'};
+constexpr size_t HEADER_LENGTH = sizeof(JOURNAL_MAGIC) + 3 * sizeof(uint64_t);
+
+// record: type, payload length, payload, low half of the FNV-1a hash of all of those
+constexpr size_t RECORD_HEADER_LENGTH = 1 + sizeof(uint64_t);
+
+uint64_t fnv1a(std::string_view bytes)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : bytes)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    return hash;
+}
+
+void append_u64(std::string& out, uint64_t value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool read_u64(std::string_view& in, uint64_t& value)
+{
+    if (in.size() < sizeof(value))
+        return false;
+    std::memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+bool read_bytes(std::string_view& in, uint64_t length, std::string_view& bytes)
+{
+    if (in.size() < length)
+        return false;
+    bytes = in.substr(0, length);
+    in.remove_prefix(length);
+    return true;
+}
+
+std::string make_header(uint64_t base_size, int64_t base_mtime_ns)
+{
+    std::string header(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    append_u64(header, base_size);
+    append_u64(header, static_cast<uint64_t>(base_mtime_ns));
+    append_u64(header, fnv1a(header));
+    return header;
+}
+
+} // namespace
+
+journal::~journal()
+{
+    close();
+}
+
+bool journal::create(const std::filesystem::path& path, uint64_t base_size, int64_t base_mtime_ns, journal_sync sync)
+{
+    close();
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        std::cerr << "ERROR: Could not create the journal. Path: " << path << '\n';
+        return false;
+    }
+
+    m_path = path;
+    m_sync = sync;
+    m_has_clipboard = false;
+    const std::string header = make_header(base_size, base_mtime_ns);
+    m_length = header.size();
+    if (std::fwrite(header.data(), 1, header.size(), m_file) != header.size() || !this->sync())
+    {
+        std::cerr << "ERROR: Could not create the journal. Path: " << path << '\n';
+        discard();
+        return false;
+    }
+    return true;
+}
+
+int64_t journal::resume(const std::filesystem::path& path, uint64_t base_size, int64_t base_mtime_ns, piece_table& document, journal_sync sync)
+{
+    close();
+
+    std::string log;
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        log.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+
+    std::error_code ec;
+    if (log.size() < HEADER_LENGTH || log.compare(0, HEADER_LENGTH, make_header(base_size, base_mtime_ns)) != 0)
+    {
+        std::filesystem::remove(path, ec); // written for a version of the file that was saved over since
+        return -1;
+    }
+
+    // replayed up to the first record that is cut off or does not add up
+    piece_range clipboard;
+    int64_t replayed = 0;
+    size_t good_end = HEADER_LENGTH;
+    std::string_view rest = std::string_view(log).substr(HEADER_LENGTH);
+    while (rest.size() >= RECORD_HEADER_LENGTH)
+    {
+        const auto type = static_cast<record_type>(rest[0]);
+        uint64_t payload_length = 0;
+        std::memcpy(&payload_length, rest.data() + 1, sizeof(payload_length));
+        if (payload_length > rest.size() - RECORD_HEADER_LENGTH || rest.size() - RECORD_HEADER_LENGTH - payload_length < sizeof(uint32_t))
+            break;
+
+        const size_t record_length = RECORD_HEADER_LENGTH + payload_length;
+        uint32_t checksum = 0;
+        std::memcpy(&checksum, rest.data() + record_length, sizeof(checksum));
+        if (checksum != static_cast<uint32_t>(fnv1a(rest.substr(0, record_length))))
+            break;
+
+        std::string_view in = rest.substr(RECORD_HEADER_LENGTH, payload_length);
+        const size_t length = document.length();
+        uint64_t position = 0;
+        uint64_t count = 0;
+        bool applied = false;
+        switch (type)
+        {
+        case record_type::INSERT:
+            applied = read_u64(in, position) && position <= length;
+            if (applied)
+                document.insert(position, in);
+            break;
+        case record_type::REMOVE:
+            applied = read_u64(in, position) && read_u64(in, count) && position <= length && count <= length - position;
+            if (applied)
+                document.remove(position, count);
+            break;
+        case record_type::REPLACE_ALL:
+        {
+            uint64_t match_length = 0;
+            applied = read_u64(in, match_length) && read_u64(in, count) && count <= in.size() / sizeof(uint64_t);
+            std::vector<size_t> positions(applied ? count : 0);
+            for (size_t& p : positions)
+            {
+                read_u64(in, position);
+                p = position;
+                applied = applied && position <= length && match_length <= length - position;
+            }
+            if (applied)
+                document.replace_all(positions, match_length, in);
+            break;
+        }
+        case record_type::EDITS:
+        {
+            applied = read_u64(in, count) && count <= in.size() / (3 * sizeof(uint64_t));
+            std::vector<text_edit> edits;
+            edits.reserve(applied ? count : 0);
+            for (uint64_t i = 0; applied && i < count; ++i)
+            {
+                uint64_t delete_length = 0;
+                uint64_t text_length = 0;
+                std::string_view text;
+                applied = read_u64(in, position) && read_u64(in, delete_length) && read_u64(in, text_length) && read_bytes(in, text_length, text) &&
+                          position <= length;
+                edits.push_back({.position = position, .delete_length = delete_length, .insert_text = text});
+            }
+            applied = applied && document.apply_edits(edits);
+            break;
+        }
+        case record_type::SORT_LINES:
+            applied = in.size() == 1;
+            if (applied)
+                document.sort_lines(get_thread_pool(), in[0] != 0);
+            break;
+        case record_type::COPY:
+            applied = read_u64(in, position) && read_u64(in, count) && position <= length;
+            if (applied)
+                clipboard = document.copy_range(position, count);
+            break;
+        case record_type::PASTE:
+            applied = read_u64(in, position) && position <= length && document.paste_range(position, clipboard);
+            break;
+        }
+        if (!applied)
+            break;
+
+        ++replayed;
+        good_end += record_length + sizeof(checksum);
+        rest.remove_prefix(record_length + sizeof(checksum));
+    }
+
+    // what follows the last good record is the tail of a crash, new records go in its place
+    if (good_end < log.size())
+        std::filesystem::resize_file(path, good_end, ec);
+    m_file = ec ? nullptr : std::fopen(path.c_str(), "ab");
+    if (!m_file)
+    {
+        std::cerr << "ERROR: Could not reopen the journal. Path: " << path << '\n';
+        std::filesystem::remove(path, ec);
+        return -1;
+    }
+
+    m_path = path;
+    m_sync = sync;
+    m_length = good_end;
+    m_has_clipboard = false; // the replayed clipboard is gone, the editor has its own
+    m_last_sync = std::chrono::steady_clock::now();
+    return replayed;
+}
+
+void journal::close()
+{
+    if (!m_file)
+        return;
+    sync();
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void journal::discard()
+{
+    if (m_file)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    std::error_code ec;
+    if (!m_path.empty())
+        std::filesystem::remove(m_path, ec);
+    m_path.clear();
+}
+
+bool journal::sync()
+{
+    if (!m_file || std::fflush(m_file) != 0)
+        return false;
+    m_last_sync = std::chrono::steady_clock::now();
+#if MINIEDITOR_POSIX_IO
+#if defined(__linux__)
+    return ::fdatasync(fileno(m_file)) == 0;
+#else
+    return ::fsync(fileno(m_file)) == 0;
+#endif
+#else
+    return true;
+#endif
+}
+
+uint64_t journal::checkpoint()
+{
+    m_has_clipboard = false;
+    return m_length;
+}
+
+bool journal::rebase(const std::filesystem::path& path, uint64_t checkpoint, uint64_t base_size, int64_t base_mtime_ns)
+{
+    if (!m_file)
+        return false;
+
+    // the records after the checkpoint, behind a header for the new base
+    std::string log = make_header(base_size, base_mtime_ns);
+    {
+        std::ifstream ifs(m_path, std::ios::binary);
+        if (std::fflush(m_file) != 0 || !ifs.seekg(static_cast<std::streamoff>(std::min(checkpoint, m_length))))
+        {
+            std::cerr << "ERROR: Could not read the journal, it is switched off. Path: " << m_path << '\n';
+            discard();
+            return false;
+        }
+        log.append(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    bool written = file && std::fwrite(log.data(), 1, log.size(), file) == log.size() && std::fflush(file) == 0;
+#if MINIEDITOR_POSIX_IO
+    written = written && ::fsync(fileno(file)) == 0;
+#endif
+    if (file)
+        written = std::fclose(file) == 0 && written;
+
+    std::error_code ec;
+    if (written)
+        std::filesystem::rename(temp_path, path, ec);
+    if (!written || ec)
+    {
+        std::cerr << "ERROR: Could not move the journal, it is switched off. Path: " << path << '\n';
+        std::filesystem::remove(temp_path, ec);
+        discard();
+        return false;
+    }
+
+    std::fclose(m_file);
+    if (path != m_path)
+        std::filesystem::remove(m_path, ec);
+    m_path = path;
+    m_length = log.size();
+    m_last_sync = std::chrono::steady_clock::now();
+    m_file = std::fopen(path.c_str(), "ab");
+    if (!m_file)
+    {
+        std::cerr << "ERROR: Could not reopen the journal. Path: " << path << '\n';
+        discard();
+        return false;
+    }
+    return true;
+}
+
+void journal::begin_record(record_type type)
+{
+    m_record.clear();
+    m_record.push_back(static_cast<char>(type));
+    append_u64(m_record, 0); // payload length, filled in by end_record
+}
+
+void journal::end_record()
+{
+    const uint64_t payload_length = m_record.size() - RECORD_HEADER_LENGTH;
+    std::memcpy(m_record.data() + 1, &payload_length, sizeof(payload_length));
+    const auto checksum = static_cast<uint32_t>(fnv1a(m_record));
+    m_record.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+    bool written = std::fwrite(m_record.data(), 1, m_record.size(), m_file) == m_record.size();
+    m_length += m_record.size();
+    if (written && (m_sync == journal_sync::ALWAYS ||
+                    (m_sync == journal_sync::INTERVAL && std::chrono::steady_clock::now() - m_last_sync >= m_sync_interval)))
+        written = sync();
+    else if (written)
+        written = std::fflush(m_file) == 0; // in the kernel at least, so it survives the editor crashing
+
+    if (!written)
+    {
+        std::cerr << "ERROR: Writing the journal failed, it is switched off. Path: " << m_path << '\n';
+        discard();
+    }
+}
+
+void journal::record_insert(size_t position, std::string_view text)
+{
+    if (!m_file)
+        return;
+    begin_record(record_type::INSERT);
+    append_u64(m_record, position);
+    m_record.append(text);
+    end_record();
+}
+
+void journal::record_remove(size_t position, size_t length)
+{
+    if (!m_file)
+        return;
+    begin_record(record_type::REMOVE);
+    append_u64(m_record, position);
+    append_u64(m_record, length);
+    end_record();
+}
+
+void journal::record_replace_all(const std::vector<size_t>& positions, size_t match_length, std::string_view replacement)
+{
+    if (!m_file)
+        return;
+    begin_record(record_type::REPLACE_ALL);
+    append_u64(m_record, match_length);
+    append_u64(m_record, positions.size());
+    for (const size_t position : positions)
+        append_u64(m_record, position);
+    m_record.append(replacement);
+    end_record();
+}
+
+void journal::record_edits(const std::vector<text_edit>& edits)
+{
+    if (!m_file || edits.empty())
+        return;
+    begin_record(record_type::EDITS);
+    append_u64(m_record, edits.size());
+    for (const text_edit& e : edits)
+    {
+        append_u64(m_record, e.position);
+        append_u64(m_record, e.delete_length);
+        append_u64(m_record, e.insert_text.size());
+        m_record.append(e.insert_text);
+    }
+    end_record();
+}
+
+void journal::record_sort_lines(bool unique)
+{
+    if (!m_file)
+        return;
+    begin_record(record_type::SORT_LINES);
+    m_record.push_back(unique ? 1 : 0);
+    end_record();
+}
+
+void journal::record_copy(size_t position, size_t length)
+{
+    if (!m_file)
+        return;
+    begin_record(record_type::COPY);
+    append_u64(m_record, position);
+    append_u64(m_record, length);
+    end_record();
+    m_has_clipboard = m_file != nullptr;
+}
+
+void journal::record_paste(size_t position)
+{
+    if (!m_file)
+        return;
+    begin_record(record_type::PASTE);
+    append_u64(m_record, position);
+    end_record();
+}
+
+} // namespace AL
@@ -0,0 +1,218 @@
+#include "latency.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+
+namespace AL
+{
+
+const char* latency_op_name(latency_op op)
+{
+    switch (op)
+    {
+        case latency_op::TICK:
+            return "tick";
+        case latency_op::HANDLE_INPUT:
+            return "input";
+        case latency_op::RENDER:
+            return "render";
+        case latency_op::REFRESH:
+            return "refresh";
+        case latency_op::INSERT_CHAR:
+            return "insert_char";
+        case latency_op::DELETE_CHAR:
+            return "delete_char";
+        case latency_op::MOVE_CURSOR:
+            return "move_cursor";
+        case latency_op::SAVE:
+            return "save";
+        case latency_op::PT_INSERT:
+            return "pt_insert";
+        case latency_op::PT_REMOVE:
+            return "pt_remove";
+        case latency_op::PT_GET_LINE:
+            return "pt_get_line";
+        case latency_op::PT_REPLACE_ALL:
+            return "pt_replace_all";
+        case latency_op::PT_APPLY_EDITS:
+            return "pt_apply_edits";
+        case latency_op::PT_PASTE_RANGE:
+            return "pt_paste_range";
+        case latency_op::PT_SORT_LINES:
+            return "pt_sort_lines";
+        case latency_op::SEARCH:
+            return "search";
+        case latency_op::COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+latency_histogram::latency_histogram()
+{
+    reset();
+}
+
+size_t latency_histogram::bucket_index(uint64_t value)
+{
+    if (value < SUB_BUCKET_COUNT)
+        return static_cast<size_t>(value);
+
+    // keep the top SUB_BUCKET_BITS + 1 bits of the value, the rest only picks the power of two range
+    const size_t shift = static_cast<size_t>(std::bit_width(value)) - 1 - SUB_BUCKET_BITS;
+    const uint64_t top = value >> shift; // in [SUB_BUCKET_COUNT, 2 * SUB_BUCKET_COUNT)
+    return (shift + 1) * SUB_BUCKET_COUNT + static_cast<size_t>(top - SUB_BUCKET_COUNT);
+}
+
+uint64_t latency_histogram::bucket_highest_value(size_t index)
+{
+    if (index < 2 * SUB_BUCKET_COUNT)
+        return index;
+
+    const size_t shift = index / SUB_BUCKET_COUNT - 1;
+    const uint64_t top = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+    return ((top + 1) << shift) - 1;
+}
+
+void latency_histogram::record(uint64_t ns)
+{
+    m_counts[bucket_index(ns)]++;
+    m_count++;
+    m_total += ns;
+    m_min = std::min(m_min, ns);
+    m_max = std::max(m_max, ns);
+}
+
+void latency_histogram::reset()
+{
+    m_counts.fill(0);
+    m_count = 0;
+    m_total = 0;
+    m_min = UINT64_MAX;
+    m_max = 0;
+}
+
+uint64_t latency_histogram::percentile(double p) const
+{
+    if (m_count == 0)
+        return 0;
+
+    p = std::clamp(p, 0.0, 100.0);
+    const auto target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(m_count))));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += m_counts[i];
+        if (seen >= target)
+            return std::clamp(bucket_highest_value(i), m_min, m_max);
+    }
+
+    return m_max;
+}
+
+uint64_t latency_histogram::count() const
+{
+    return m_count;
+}
+
+uint64_t latency_histogram::min() const
+{
+    return m_count ? m_min : 0;
+}
+
+uint64_t latency_histogram::max() const
+{
+    return m_max;
+}
+
+uint64_t latency_histogram::mean() const
+{
+    return m_count ? m_total / m_count : 0;
+}
+
+latency_histogram& latency_registry::get(latency_op op)
+{
+    return m_histograms[static_cast<size_t>(op)];
+}
+
+const latency_histogram& latency_registry::get(latency_op op) const
+{
+    return m_histograms[static_cast<size_t>(op)];
+}
+
+bool latency_registry::empty() const
+{
+    return std::all_of(m_histograms.begin(), m_histograms.end(), [](const latency_histogram& h) { return h.count() == 0; });
+}
+
+void latency_registry::reset()
+{
+    for (auto& h : m_histograms)
+        h.reset();
+}
+
+static double to_us(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1000.0;
+}
+
+void latency_registry::write_summary(std::ostream& os) const
+{
+    const auto flags = os.flags();
+    os << std::fixed << std::setprecision(0);
+
+    bool first = true;
+    for (size_t i = 0; i < m_histograms.size(); ++i)
+    {
+        const auto& h = m_histograms[i];
+        if (h.count() == 0)
+            continue;
+
+        if (!first)
+            os << ' ';
+        first = false;
+
+        os << latency_op_name(static_cast<latency_op>(i)) << ' ' << to_us(h.percentile(50)) << '/' << to_us(h.percentile(99)) << '/'
+           << to_us(h.max());
+    }
+
+    if (!first)
+        os << " us";
+
+    os.flags(flags);
+}
+
+void latency_registry::write_report(std::ostream& os) const
+{
+    const auto flags = os.flags();
+
+    os << "\n--- Latency report (us) ---\n";
+    os << std::left << std::setw(14) << "op" << std::right << std::setw(10) << "count" << std::setw(10) << "min" << std::setw(10) << "mean"
+       << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << '\n';
+
+    os << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < m_histograms.size(); ++i)
+    {
+        const auto& h = m_histograms[i];
+        if (h.count() == 0)
+            continue;
+
+        os << std::left << std::setw(14) << latency_op_name(static_cast<latency_op>(i)) << std::right << std::setw(10) << h.count() << std::setw(10)
+           << to_us(h.min()) << std::setw(10) << to_us(h.mean()) << std::setw(10) << to_us(h.percentile(50)) << std::setw(10)
+           << to_us(h.percentile(90)) << std::setw(10) << to_us(h.percentile(99)) << std::setw(10) << to_us(h.percentile(99.9)) << std::setw(10)
+           << to_us(h.max()) << '\n';
+    }
+
+    os.flags(flags);
+}
+
+latency_registry& get_latency_registry()
+{
+    static latency_registry registry;
+    return registry;
+}
+
+} // namespace AL
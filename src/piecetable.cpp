@@ -1,47 +1,261 @@
 #include "piecetable.h"
+#include "byte_scan.h"
 #include "implicit_treap.h"
+#include "latency.h"
+#include "thread_pool.h"
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
 #include <string>
 #include <string_view>
 
+#if MINIEDITOR_POSIX_IO
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
 namespace AL
 {
-size_t piece_table::normalize(std::string& text)
+namespace
 {
-    if (text.find('\n') != std::string::npos)
-    {}
-    else if (text.find('\r') == std::string::npos)
-        return 0;
+// a line being sorted, without its '\n'. the text points into a buffer, or into a copy when the line crosses pieces.
+// key is 8 bytes of it, big endian (zero past the end), so most comparisons never touch the text
+struct sort_line
+{
+    std::string_view text;
+    uint64_t key;
+};
 
-    size_t newline_count = 0;
-    auto it = text.begin();
+struct sort_line_order
+{
+    size_t common_prefix;
+
+    bool operator()(const sort_line& a, const sort_line& b) const
+    {
+        if (a.key != b.key)
+            return a.key < b.key;
+        return a.text.substr(common_prefix) < b.text.substr(common_prefix);
+    }
+};
+
+// the lines that start in [begin, end)
+struct sort_partition
+{
+    size_t begin;
+    size_t end;
+    std::vector<sort_line> lines;
+    std::deque<std::string> copies; // a deque, so the views into it stay put
+    size_t common_prefix;           // of its lines
+};
+
+constexpr size_t min_sort_partition_length = 1024 * 1024;
+
+void load_keys(sort_line* begin, sort_line* end, size_t depth)
+{
+    for (sort_line* line = begin; line != end; ++line)
+    {
+        line->key = 0;
+        for (size_t k = 0; k < 8; ++k)
+        {
+            const size_t at = depth + k;
+            line->key = line->key << 8 | (at < line->text.size() ? static_cast<unsigned char>(line->text[at]) : 0);
+        }
+    }
+}
 
-    for (auto c : text)
+// lines that all share their first depth bytes, sorted 8 bytes at a time (most significant digit first).
+// each round sorts by the key and only the groups with equal keys read the next 8 bytes, so the text is
+// read once per round instead of at every comparison. ends with the keys loaded at depth again, for merging
+void sort_by_keys(sort_line* begin, sort_line* end, size_t depth)
+{
+    struct range
+    {
+        sort_line* begin;
+        sort_line* end;
+        size_t depth;
+    };
+    const auto by_key = [](const sort_line& a, const sort_line& b) { return a.key < b.key; };
+
+    std::vector<range> pending = {{begin, end, depth}};
+    while (!pending.empty())
     {
-        if (c == '\n')
-            newline_count++;
+        const range r = pending.back();
+        pending.pop_back();
+        load_keys(r.begin, r.end, r.depth);
+        std::sort(r.begin, r.end, by_key);
+
+        for (sort_line* group = r.begin; group != r.end;)
+        {
+            sort_line* group_end = group + 1;
+            while (group_end != r.end && group_end->key == group->key)
+                ++group_end;
+
+            if (group_end - group > 1)
+            {
+                // lines that end inside these 8 bytes are prefixes of the others (the key pads with zeros), shortest first
+                sort_line* rest = std::partition(group, group_end, [&](const sort_line& line) { return line.text.size() <= r.depth + 8; });
+                std::sort(group, rest, [](const sort_line& a, const sort_line& b) { return a.text.size() < b.text.size(); });
+                if (group_end - rest > 1)
+                    pending.push_back({rest, group_end, r.depth + 8});
+            }
+            group = group_end;
+        }
+    }
+
+    load_keys(begin, end, depth);
+}
+
+// length of the prefix a and b share, looking at no more than limit bytes
+size_t shared_prefix(std::string_view a, std::string_view b, size_t limit)
+{
+    limit = std::min({limit, a.size(), b.size()});
+    return static_cast<size_t>(std::mismatch(a.begin(), a.begin() + static_cast<std::ptrdiff_t>(limit), b.begin()).first - a.begin());
+}
+
+// a copied line keeps its global start in front of its text, where a line in a buffer needs nothing
+std::string_view finish_copy(sort_partition& part, std::string& copy)
+{
+    part.copies.push_back(std::move(copy));
+    copy.clear();
+    return std::string_view(part.copies.back()).substr(sizeof(size_t));
+}
+
+size_t copied_line_start(std::string_view text)
+{
+    size_t start;
+    std::memcpy(&start, text.data() - sizeof(size_t), sizeof(size_t));
+    return start;
+}
+
+void index_lines(const piece_table& pt, sort_partition& part)
+{
+    // in a CRLF document the '\r' of "\r\n" belongs to the line break, so it is left out of the text that is compared
+    const bool crlf = pt.get_line_ending() == line_ending::CRLF;
+
+    // a line that started in the partition before belongs to it
+    bool skipping = part.begin > 0 && pt.get_char_at(part.begin - 1) != '\n';
+    bool crossing = false; // the current line started in an earlier chunk and is being copied
+    std::string copy;
+    size_t line_start = part.begin;
+    size_t chunk_start = part.begin;
+
+    pt.for_each_chunk(part.begin, [&](std::string_view chunk) {
+        size_t i = 0;
+        if (skipping)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(chunk.data(), '\n', chunk.size()));
+            if (!newline)
+            {
+                chunk_start += chunk.size();
+                return false;
+            }
+            i = static_cast<size_t>(newline - chunk.data()) + 1;
+            line_start = chunk_start + i;
+            skipping = false;
+        }
+
+        while (i < chunk.size() && line_start < part.end)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(chunk.data() + i, '\n', chunk.size() - i));
+            if (!newline)
+            {
+                if (!crossing)
+                    copy.append(reinterpret_cast<const char*>(&line_start), sizeof(size_t));
+                copy.append(chunk.substr(i));
+                crossing = true;
+                break;
+            }
+
+            const std::string_view text(chunk.data() + i, static_cast<size_t>(newline - chunk.data()) - i);
+            if (crossing)
+            {
+                copy.append(text);
+                if (crlf && copy.length() > sizeof(size_t) && copy.back() == '\r')
+                    copy.pop_back();
+                part.lines.push_back({finish_copy(part, copy), 0});
+                crossing = false;
+            }
+            else
+            {
+                part.lines.push_back({crlf && text.ends_with('\r') ? text.substr(0, text.size() - 1) : text, 0});
+            }
+
+            i += text.size() + 1;
+            line_start = chunk_start + i;
+        }
+
+        chunk_start += chunk.size();
+        return line_start >= part.end;
+    });
+
+    // the last line of the document when it has no '\n'
+    if (crossing && line_start < part.end)
+        part.lines.push_back({finish_copy(part, copy), 0});
 
-        if (c != '\r')
-            *it++ = c;
+    part.common_prefix = part.lines.empty() ? 0 : part.lines.front().text.size();
+    for (const sort_line& line : part.lines)
+    {
+        part.common_prefix = shared_prefix(part.lines.front().text, line.text, part.common_prefix);
+        if (part.common_prefix == 0)
+            break;
     }
+}
 
-    text.erase(it, text.end());
-    return newline_count;
+// merges pairs of sorted runs until one is left. every pair is cut into slices that merge independently:
+// a slice of the first run plus the part of the second that sorts before the next slice
+void merge_runs(std::vector<std::vector<sort_line>>& runs, const sort_line_order& order, thread_pool& pool)
+{
+    while (runs.size() > 1)
+    {
+        const size_t pairs = runs.size() / 2;
+        const size_t slices = std::max<size_t>(1, pool.concurrency() * 2 / pairs);
+
+        std::vector<std::vector<sort_line>> merged(pairs + runs.size() % 2);
+        for (size_t p = 0; p < pairs; ++p)
+            merged[p].resize(runs[2 * p].size() + runs[2 * p + 1].size());
+
+        pool.run(pairs * slices, [&](size_t task) {
+            const size_t p = task / slices;
+            const size_t slice = task % slices;
+            const std::vector<sort_line>& a = runs[2 * p];
+            const std::vector<sort_line>& b = runs[2 * p + 1];
+
+            const size_t a_begin = a.size() * slice / slices;
+            const size_t a_end = a.size() * (slice + 1) / slices;
+            const auto b_split = [&](size_t a_index) {
+                return a_index >= a.size() ? b.size() : static_cast<size_t>(std::lower_bound(b.begin(), b.end(), a[a_index], order) - b.begin());
+            };
+            const size_t b_begin = slice == 0 ? 0 : b_split(a_begin);
+            const size_t b_end = slice + 1 == slices ? b.size() : b_split(a_end);
+
+            std::merge(a.begin() + static_cast<std::ptrdiff_t>(a_begin), a.begin() + static_cast<std::ptrdiff_t>(a_end),
+                       b.begin() + static_cast<std::ptrdiff_t>(b_begin), b.begin() + static_cast<std::ptrdiff_t>(b_end),
+                       merged[p].begin() + static_cast<std::ptrdiff_t>(a_begin + b_begin), order);
+        });
+
+        if (runs.size() % 2)
+            merged.back() = std::move(runs.back());
+        runs = std::move(merged);
+    }
 }
+} // namespace
 
 size_t piece_table::count_newlines(const piece& p) const
 {
     size_t count = 0;
     if (p.buf_type == buffer_type::ORIGINAL)
     {
-        std::string_view str(m_original_buffer.data() + p.start, p.length);
-        count = std::count(str.begin(), str.end(), '\n');
+        count = count_byte(m_original_buffer.data() + p.start, p.length, '\n');
     }
     else if (p.buf_type == buffer_type::ADD)
     {
-        std::string_view str(m_add_buffer.data() + p.start, p.length);
-        count = std::count(str.begin(), str.end(), '\n');
+        count = count_byte(m_add_buffer.data() + p.start, p.length, '\n');
     }
 
     return count;
@@ -49,10 +263,16 @@ size_t piece_table::count_newlines(const piece& p) const
 
 size_t piece_table::count_newlines(const std::string& str) const
 {
-    return std::count(str.begin(), str.end(), '\n');
+    return count_byte(str.data(), str.length(), '\n');
+}
+
+uint64_t piece_table::next_buffer_id()
+{
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
 }
 
-piece_table::piece_table() : m_needs_rebuild(true)
+piece_table::piece_table() : m_buffer_id(next_buffer_id()), m_needs_rebuild(true)
 {}
 
 piece_table::~piece_table()
@@ -61,10 +281,15 @@ piece_table::~piece_table()
 piece_table::piece_table(piece_table&& other) noexcept
 {
     m_add_buffer = std::move(other.m_add_buffer);
-    m_original_buffer = std::move(other.m_original_buffer);
+    take_original(other);
     m_treap = std::move(other.m_treap);
+    m_anchors = std::move(other.m_anchors);
+    other.m_anchors.clear(); // its root would point into the moved nodes
+    m_buffer_id = other.m_buffer_id;
+    other.m_buffer_id = next_buffer_id();
     m_cached_string = std::move(other.m_cached_string);
     m_needs_rebuild = other.m_needs_rebuild;
+    m_line_ending = other.m_line_ending;
 }
 
 piece_table& piece_table::operator=(piece_table&& other) noexcept
@@ -74,67 +299,213 @@ piece_table& piece_table::operator=(piece_table&& other) noexcept
     clear();
 
     m_add_buffer = std::move(other.m_add_buffer);
-    m_original_buffer = std::move(other.m_original_buffer);
+    take_original(other);
     m_treap = std::move(other.m_treap);
+    m_anchors = std::move(other.m_anchors);
+    other.m_anchors.clear(); // its root would point into the moved nodes
+    m_buffer_id = other.m_buffer_id;
+    other.m_buffer_id = next_buffer_id();
     m_cached_string = std::move(other.m_cached_string);
     m_needs_rebuild = other.m_needs_rebuild;
+    m_line_ending = other.m_line_ending;
 
     return *this;
 }
 
-piece_table::piece_table(std::string initial_content) : m_needs_rebuild(true)
+void piece_table::take_original(piece_table& other)
 {
-    // normalize the content before doing anything
-    size_t newline_count = normalize(initial_content);
-    m_original_buffer = std::move(initial_content);
+    // a short string lives inside the string object, so the view is taken again from where the storage ended up
+    const size_t length = other.m_original_buffer.length();
+    m_original_text = std::move(other.m_original_text);
+    m_original_block = std::move(other.m_original_block);
+    m_original_buffer = m_original_block ? std::string_view(m_original_block.get(), length) : std::string_view(m_original_text);
+    other.m_original_buffer = {};
+}
 
-    // dont insert a zero length piece  it breaks treap operations
-    if (m_original_buffer.empty())
-        return;
+piece_table::piece_table(std::string initial_content) : piece_table(std::move(initial_content), get_thread_pool())
+{}
 
-    AL::piece piece;
-    piece.length = m_original_buffer.length();
-    piece.buf_type = AL::buffer_type::ORIGINAL;
-    piece.start = 0;
-    piece.newline_count = newline_count;
+piece_table::piece_table(std::string initial_content, thread_pool& pool) : m_buffer_id(next_buffer_id()), m_needs_rebuild(true)
+{
+    m_original_text = std::move(initial_content);
+    m_original_buffer = m_original_text;
+    m_line_ending = detect_line_ending(m_original_text);
 
-    m_treap.insert(0, piece, get_split_strategy());
+    std::vector<piece> pieces;
+    load_original(m_original_text.data(), 0, m_original_text.length(), m_line_ending, pool, pieces);
+    append_original(pieces);
 }
 
-void piece_table::insert(size_t file_insert_position, std::string text)
+void piece_table::cut_original(const char* buffer, size_t start, size_t length, std::vector<piece>& out)
 {
-    size_t newline_count = 0;
+    // bounded pieces, so that scanning inside a single piece (line lookups, splits) costs the same no matter
+    // how large the file is. empty content gives nothing. a zero length piece breaks treap operations
+    for (size_t offset = 0; offset < length; offset += m_max_original_piece_length)
+    {
+        const size_t piece_length = std::min(m_max_original_piece_length, length - offset);
+        out.push_back({.buf_type = buffer_type::ORIGINAL,
+                       .start = start + offset,
+                       .length = piece_length,
+                       .newline_count = count_byte(buffer + start + offset, piece_length, '\n')});
+    }
+}
 
-    // Only do full normalize (strip \r) if text could be pasted content
-    if (text.find('\r') != std::string::npos)
-        newline_count = normalize(text);
-    else
+size_t piece_table::load_original(char* buffer, size_t start, size_t length, line_ending ending, thread_pool& pool, std::vector<piece>& out)
+{
+    // partitions start on piece boundaries, so a file without '\r' is cut the same however many there are
+    const size_t task_count = std::clamp<size_t>(length / m_min_load_partition_length, 1, pool.concurrency() * 4);
+    const size_t piece_count = (length + m_max_original_piece_length - 1) / m_max_original_piece_length;
+    const size_t step = std::max<size_t>(1, (piece_count + task_count - 1) / task_count) * m_max_original_piece_length;
+
+    std::vector<std::vector<piece>> parts(task_count);
+    std::vector<size_t> stripped(task_count, 0);
+    pool.run(task_count, [&](size_t i) {
+        const size_t begin = std::min(length, i * step);
+        const size_t end = std::min(length, begin + step);
+        char* const first = buffer + start + begin;
+        char* last = buffer + start + end;
+        if (ending == line_ending::LF && std::memchr(first, '\r', end - begin))
+        {
+            char* const kept = std::remove(first, last, '\r');
+            stripped[i] = static_cast<size_t>(last - kept);
+            last = kept;
+        }
+        cut_original(buffer, start + begin, static_cast<size_t>(last - first), parts[i]);
+    });
+
+    size_t total_stripped = 0;
+    for (size_t i = 0; i < task_count; ++i)
     {
-        for (char c : text)
+        out.insert(out.end(), parts[i].begin(), parts[i].end());
+        total_stripped += stripped[i];
+    }
+    return total_stripped;
+}
+
+char* piece_table::begin_original(size_t size)
+{
+    clear();
+    m_original_block = std::make_unique_for_overwrite<char[]>(size);
+    m_original_buffer = {m_original_block.get(), size};
+    return m_original_block.get();
+}
+
+void piece_table::set_line_ending(line_ending ending)
+{
+    m_line_ending = ending;
+}
+
+line_ending piece_table::detect_line_ending(std::string_view text)
+{
+    const size_t newline = text.find('\n');
+    return newline != std::string_view::npos && newline > 0 && text[newline - 1] == '\r' ? line_ending::CRLF : line_ending::LF;
+}
+
+size_t piece_table::get_inserted_length(std::string_view text) const
+{
+    const size_t carriage_returns = count_byte(text.data(), text.length(), '\r');
+    const size_t added = m_line_ending == line_ending::CRLF ? count_byte(text.data(), text.length(), '\n') : 0;
+    return text.length() - carriage_returns + added;
+}
+
+void piece_table::append_original(const std::vector<piece>& pieces)
+{
+    // the chunk becomes a subtree of its own that is joined at the end, O(k + log n) for k pieces
+    m_treap.insert_pieces(m_treap.size(), pieces, get_split_strategy());
+    if (!pieces.empty())
+    {
+        m_needs_rebuild = true;
+        ++m_version;
+    }
+}
+
+void piece_table::end_original(size_t used)
+{
+    m_original_buffer = m_original_buffer.substr(0, used);
+}
+
+void piece_table::reserve_add_buffer(size_t needed)
+{
+    if (needed <= m_add_buffer.capacity())
+        return;
+
+    const size_t capacity = std::max(needed, m_add_buffer.capacity() * 2);
+    if (m_buffer_pins == 0)
+    {
+        m_add_buffer.reserve(capacity);
+        return;
+    }
+
+    // a frozen document may be reading the old bytes right now
+    std::string grown;
+    grown.reserve(capacity);
+    grown.append(m_add_buffer);
+    m_retired_add_buffers.push_back(std::move(m_add_buffer));
+    m_add_buffer = std::move(grown);
+}
+
+size_t piece_table::append_to_add_buffer(std::string_view text, size_t& newline_count)
+{
+    const size_t start_pos = m_add_buffer.length();
+    if (m_line_ending == line_ending::CRLF && text.find('\n') != std::string_view::npos)
+    {
+        // every line break goes in as "\r\n", whichever way the text had it
+        reserve_add_buffer(start_pos + get_inserted_length(text));
+        for (const char c : text)
+        {
+            if (c == '\r')
+                continue;
             if (c == '\n')
-                newline_count++;
+                m_add_buffer.push_back('\r');
+            m_add_buffer.push_back(c);
+        }
+        newline_count = count_byte(m_add_buffer.data() + start_pos, m_add_buffer.length() - start_pos, '\n');
+        return start_pos;
     }
 
+    reserve_add_buffer(start_pos + text.length());
+    m_add_buffer.append(text);
+
+    // strip '\r' from the freshly appended tail only (pasted content)
+    if (text.find('\r') != std::string_view::npos)
+    {
+        auto tail_end = std::remove(m_add_buffer.begin() + static_cast<std::ptrdiff_t>(start_pos), m_add_buffer.end(), '\r');
+        m_add_buffer.erase(tail_end, m_add_buffer.end());
+    }
+
+    newline_count = count_byte(m_add_buffer.data() + start_pos, m_add_buffer.length() - start_pos, '\n');
+    return start_pos;
+}
+
+void piece_table::insert(size_t file_insert_position, std::string_view text)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::PT_INSERT);
+
+    if (text.empty())
+        return;
+
     if (file_insert_position > length())
     {
         // clamp to prevent out of bounds
         file_insert_position = length();
     }
 
-    size_t start_pos = m_add_buffer.length();
-    size_t text_length = text.length();
-
-    m_add_buffer.append(text);
+    size_t newline_count = 0;
+    const size_t start_pos = append_to_add_buffer(text, newline_count);
+    const size_t text_length = m_add_buffer.length() - start_pos;
 
     m_treap.insert(file_insert_position,
                    {.buf_type = AL::buffer_type::ADD, .start = start_pos, .length = text_length, .newline_count = newline_count},
                    get_split_strategy());
+    m_anchors.on_insert(file_insert_position, text_length);
 
     m_needs_rebuild = true;
+    ++m_version;
 }
 
 void piece_table::remove(size_t position, size_t length)
 {
+    MINIEDITOR_LATENCY_SCOPE(latency_op::PT_REMOVE);
     if (position > this->length())
         return;
 
@@ -144,15 +515,421 @@ void piece_table::remove(size_t position, size_t length)
     }
 
     m_treap.erase(position, length, get_split_strategy());
+    m_anchors.on_remove(position, length);
+    m_needs_rebuild = true;
+    ++m_version;
+}
+
+size_t piece_table::replace_all(const std::vector<size_t>& positions, size_t match_length, std::string_view replacement)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::PT_REPLACE_ALL);
+    if (positions.empty() || match_length == 0)
+        return 0;
+
+    size_t replacement_newlines = 0;
+    const size_t replacement_start = append_to_add_buffer(replacement, replacement_newlines);
+    const piece replacement_piece = {.buf_type = buffer_type::ADD,
+                                     .start = replacement_start,
+                                     .length = m_add_buffer.length() - replacement_start,
+                                     .newline_count = replacement_newlines};
+
+    std::vector<piece> pieces;
+    pieces.reserve(positions.size() * 2 + 1);
+
+    // the part of p in [from, to) (piece relative). newlines are only recounted for pieces that get cut
+    auto keep = [&](const piece& p, size_t from, size_t to) {
+        if (from >= to)
+            return;
+        if (from == 0 && to == p.length)
+        {
+            pieces.push_back(p);
+            return;
+        }
+
+        piece part = {.buf_type = p.buf_type, .start = p.start + from, .length = to - from, .newline_count = 0};
+        part.newline_count = count_newlines(part);
+        pieces.push_back(part);
+    };
+
+    size_t replaced = 0;
+    std::vector<size_t> replaced_positions; // only kept when there are anchors to move
+    size_t next = 0;         // next position to replace
+    size_t skip_until = 0;   // end of the last replaced match, bytes before it are dropped
+    size_t piece_offset = 0; // global index of the current piece
+    const size_t document_length = length();
+
+    m_treap.for_each([&](const piece& p) {
+        const size_t piece_end = piece_offset + p.length;
+        size_t from = skip_until > piece_offset ? std::min(skip_until - piece_offset, p.length) : 0;
+
+        while (next < positions.size() && positions[next] < piece_end)
+        {
+            const size_t match = positions[next];
+            if (match < skip_until || match + match_length > document_length)
+            {
+                ++next; // overlaps the previous one or runs off the end
+                continue;
+            }
+
+            keep(p, from, match - piece_offset);
+            if (replacement_piece.length > 0)
+                pieces.push_back(replacement_piece);
+            if (m_anchors.size() > 0)
+                replaced_positions.push_back(match);
+
+            skip_until = match + match_length;
+            from = std::min(skip_until - piece_offset, p.length);
+            ++replaced;
+            ++next;
+        }
+
+        keep(p, from, p.length);
+        piece_offset = piece_end;
+        return false;
+    });
+
+    if (replaced == 0)
+    {
+        m_add_buffer.resize(replacement_start);
+        return 0;
+    }
+
+    m_treap.build(pieces);
+
+    // back to front, so the positions are still the ones from before
+    for (auto it = replaced_positions.rbegin(); it != replaced_positions.rend(); ++it)
+    {
+        m_anchors.on_remove(*it, match_length);
+        m_anchors.on_insert(*it, replacement_piece.length);
+    }
+
+    m_needs_rebuild = true;
+    ++m_version;
+    return replaced;
+}
+
+bool piece_table::apply_edits(const std::vector<text_edit>& edits)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::PT_APPLY_EDITS);
+
+    const size_t document_length = length();
+    size_t previous_end = 0;
+    size_t insert_length = 0;
+    for (const text_edit& e : edits)
+    {
+        if (e.position < previous_end || e.position > document_length)
+        {
+            std::cerr << "ERROR: Edits must be sorted, inside the document and not overlap" << '\n';
+            return false;
+        }
+        previous_end = e.position + std::min(e.delete_length, document_length - e.position);
+        insert_length += get_inserted_length(e.insert_text);
+    }
+
+    // text that points into the add buffer itself (taken from get_add_buffer, say) would dangle once reserving moves it
+    const char* add_begin = m_add_buffer.data();
+    const char* add_end = add_begin + m_add_buffer.length();
+    const auto aliases_add_buffer = [&](std::string_view text) {
+        return !text.empty() && std::less_equal<const char*>()(add_begin, text.data()) && std::less<const char*>()(text.data(), add_end);
+    };
+    const auto aliased = std::count_if(edits.begin(), edits.end(), [&](const text_edit& e) { return aliases_add_buffer(e.insert_text); });
+    std::vector<std::string> copies;
+    copies.reserve(static_cast<size_t>(aliased)); // no reallocation, a short copy's view points into the string itself
+    for (const text_edit& e : edits)
+    {
+        if (aliases_add_buffer(e.insert_text))
+            copies.emplace_back(e.insert_text);
+    }
+
+    // one allocation for all of the inserted text. still doubles so repeated batches stay amortized O(1) per byte
+    reserve_add_buffer(m_add_buffer.length() + insert_length);
+
+    std::vector<piece_edit> piece_edits;
+    piece_edits.reserve(edits.size());
+    size_t copy = 0;
+    for (const text_edit& e : edits)
+    {
+        size_t newline_count = 0;
+        const std::string_view text = aliases_add_buffer(e.insert_text) ? std::string_view(copies[copy++]) : e.insert_text;
+        const size_t start = append_to_add_buffer(text, newline_count);
+        piece_edits.push_back({.position = e.position,
+                               .delete_length = std::min(e.delete_length, document_length - e.position),
+                               .insert = {.buf_type = buffer_type::ADD, .start = start, .length = m_add_buffer.length() - start, .newline_count = newline_count}});
+    }
+
+    m_treap.apply_edits(piece_edits, get_split_strategy());
+    for (auto it = piece_edits.rbegin(); it != piece_edits.rend(); ++it)
+    {
+        m_anchors.on_remove(it->position, it->delete_length);
+        m_anchors.on_insert(it->position, it->insert.length);
+    }
+
+    m_needs_rebuild = true;
+    ++m_version;
+    return true;
+}
+
+piece_range piece_table::copy_range(size_t position, size_t length) const
+{
+    piece_range range;
+    range.buffer_id = m_buffer_id;
+    if (position >= this->length())
+        return range;
+
+    length = std::min(length, this->length() - position);
+    if (length == 0)
+        return range;
+
+    node* n = nullptr;
+    size_t piece_offset = 0;
+    m_treap.find_by_byte(position, n, piece_offset);
+
+    // only the first and last pieces can be cut short. their newlines are counted on whichever side is shorter
+    size_t skip = position - piece_offset;
+    size_t remaining = length;
+    m_treap.for_each_from_byte(position, [&](const piece& p) {
+        piece part = p;
+        part.start += skip;
+        part.length = std::min(p.length - skip, remaining);
+        if (part.length != p.length)
+        {
+            const size_t tail_start = part.start + part.length;
+            const piece head = {.buf_type = p.buf_type, .start = p.start, .length = skip, .newline_count = 0};
+            const piece tail = {.buf_type = p.buf_type, .start = tail_start, .length = p.start + p.length - tail_start, .newline_count = 0};
+            part.newline_count =
+                part.length < p.length - part.length ? count_newlines(part) : p.newline_count - count_newlines(head) - count_newlines(tail);
+        }
+
+        range.pieces.push_back(part);
+        remaining -= part.length;
+        skip = 0;
+        return remaining == 0;
+    });
+
+    range.length = length;
+    return range;
+}
+
+piece_range piece_table::cut_range(size_t position, size_t length)
+{
+    piece_range range = copy_range(position, length);
+    remove(position, range.length);
+    return range;
+}
+
+bool piece_table::paste_range(size_t position, const piece_range& range)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::PT_PASTE_RANGE);
+    if (range.buffer_id != m_buffer_id)
+    {
+        std::cerr << "ERROR: The range was copied from other buffers" << '\n';
+        return false;
+    }
+
+    if (range.length == 0)
+        return true;
+
+    position = std::min(position, length());
+    m_treap.insert_pieces(position, range.pieces, get_split_strategy());
+    m_anchors.on_insert(position, range.length);
     m_needs_rebuild = true;
+    ++m_version;
+    return true;
+}
+
+bool piece_table::move_range(size_t position, size_t length, size_t destination)
+{
+    if (position > this->length() || destination > this->length())
+        return false;
+
+    length = std::min(length, this->length() - position);
+    if (destination > position && destination < position + length)
+    {
+        std::cerr << "ERROR: Cannot move a range into itself" << '\n';
+        return false;
+    }
+
+    // the pieces of the range are taken out and spliced back in, no text is copied
+    const piece_range range = cut_range(position, length);
+    return paste_range(destination > position ? destination - range.length : destination, range);
+}
+
+size_t piece_table::sort_lines(thread_pool& pool, bool unique)
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::PT_SORT_LINES);
+    const size_t document_length = length();
+    if (document_length == 0)
+        return 0;
+
+    // a last line without '\n' needs one when it is sorted somewhere else. it goes in before any view into the add buffer is taken
+    const bool ends_with_newline = get_char_at(document_length - 1) == '\n';
+    size_t newline_start = 0;
+    const size_t line_break_length = get_line_break().length();
+    if (!ends_with_newline)
+    {
+        size_t newline_count;
+        newline_start = append_to_add_buffer("\n", newline_count);
+    }
+
+    // find the lines and sort every partition on its own, then merge
+    const size_t task_count = std::clamp<size_t>(document_length / min_sort_partition_length, 1, pool.concurrency() * 4);
+    const size_t step = (document_length + task_count - 1) / task_count;
+    std::vector<sort_partition> parts(task_count);
+    for (size_t i = 0; i < task_count; ++i)
+    {
+        parts[i].begin = std::min(document_length, i * step);
+        parts[i].end = std::min(document_length, parts[i].begin + step);
+    }
+
+    pool.run(task_count, [&](size_t i) { index_lines(*this, parts[i]); });
+
+    // the prefix all lines share, so the keys start where lines differ (e.g. after the year of a timestamp)
+    sort_line_order order{.common_prefix = std::string_view::npos};
+    const sort_partition* first = nullptr;
+    for (const auto& part : parts)
+    {
+        if (part.lines.empty())
+            continue;
+        if (!first)
+            first = &part;
+
+        order.common_prefix = std::min(order.common_prefix, shared_prefix(first->lines.front().text, part.lines.front().text, part.common_prefix));
+    }
+
+    pool.run(task_count, [&](size_t i) { sort_by_keys(parts[i].lines.data(), parts[i].lines.data() + parts[i].lines.size(), order.common_prefix); });
+
+    std::vector<std::vector<sort_line>> runs;
+    for (auto& part : parts)
+        runs.push_back(std::move(part.lines));
+    merge_runs(runs, order, pool);
+
+    std::vector<sort_line>& lines = runs.front();
+    if (unique)
+        lines.erase(std::unique(lines.begin(), lines.end(), [](const sort_line& a, const sort_line& b) { return a.text == b.text; }), lines.end());
+
+    // lines that did not cross pieces are still in their buffer with their '\n' right after them, so they become one piece.
+    // pieces that happen to continue each other are joined
+    const auto in_buffer = [](std::string_view buffer, const char* p) {
+        return std::less_equal<const char*>()(buffer.data(), p) && std::less<const char*>()(p, buffer.data() + buffer.size());
+    };
+
+    std::vector<piece> pieces;
+    pieces.reserve(lines.size());
+    const auto push = [&](const piece& p) {
+        if (!pieces.empty() && pieces.back().buf_type == p.buf_type && pieces.back().start + pieces.back().length == p.start)
+        {
+            pieces.back().length += p.length;
+            pieces.back().newline_count += p.newline_count;
+        }
+        else
+        {
+            pieces.push_back(p);
+        }
+    };
+
+    // the '\r' left out of a line's text is still right after it
+    const bool crlf = m_line_ending == line_ending::CRLF;
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        const sort_line& line = lines[i];
+        const size_t newline = i + 1 < lines.size() || ends_with_newline ? 1 : 0;
+        const char* data = line.text.data();
+        if (in_buffer(m_original_buffer, data))
+        {
+            const size_t break_length = newline && crlf && data[line.text.size()] == '\r' ? 2 : newline;
+            push({.buf_type = buffer_type::ORIGINAL,
+                  .start = static_cast<size_t>(data - m_original_buffer.data()),
+                  .length = line.text.size() + break_length,
+                  .newline_count = newline});
+        }
+        else if (in_buffer(m_add_buffer, data))
+        {
+            const size_t break_length = newline && crlf && data[line.text.size()] == '\r' ? 2 : newline;
+            push({.buf_type = buffer_type::ADD,
+                  .start = static_cast<size_t>(data - m_add_buffer.data()),
+                  .length = line.text.size() + break_length,
+                  .newline_count = newline});
+        }
+        else
+        {
+            const size_t start = copied_line_start(line.text);
+            const bool has_own_newline = start + line.text.size() < document_length;
+            const size_t break_length = newline && crlf && has_own_newline && get_char_at(start + line.text.size()) == '\r' ? 2 : newline;
+            for (const piece& p : copy_range(start, line.text.size() + (has_own_newline ? break_length : 0)).pieces)
+                push(p);
+            if (newline && !has_own_newline)
+                push({.buf_type = buffer_type::ADD, .start = newline_start, .length = line_break_length, .newline_count = 1});
+        }
+    }
+
+    // the lines are done with before the nodes are allocated, which keeps the peak down on huge files
+    const size_t line_count = lines.size();
+    runs.clear();
+    parts.clear();
+    m_treap.build(pieces);
+
+    // the text under the anchors changed, but their offsets stay. the ones past a shortened document move to its end
+    const size_t sorted_length = length();
+    if (sorted_length < document_length)
+        m_anchors.on_remove(sorted_length, document_length - sorted_length);
+
+    m_needs_rebuild = true;
+    ++m_version;
+    return line_count;
 }
 
 void piece_table::clear()
 {
-    m_original_buffer.clear();
+    m_line_ending = line_ending::LF;
+    m_original_buffer = {};
+    m_original_text.clear();
+    m_original_block.reset();
     m_add_buffer.clear();
     m_treap.clear();
+    m_anchors.clear();
+    m_buffer_id = next_buffer_id();
     m_needs_rebuild = true;
+    ++m_version;
+}
+
+frozen_document piece_table::freeze()
+{
+    // short strings live inside the string object, which moves when it is retired. on the heap they stay put
+    constexpr size_t heap_capacity = 64;
+    if (m_add_buffer.capacity() < heap_capacity)
+        reserve_add_buffer(heap_capacity);
+    ++m_buffer_pins;
+
+    frozen_document document;
+    m_treap.get_pieces(document.pieces);
+    document.original = m_original_buffer;
+    document.add = m_add_buffer;
+    document.length = length();
+    return document;
+}
+
+void piece_table::thaw()
+{
+    if (m_buffer_pins > 0 && --m_buffer_pins == 0)
+        m_retired_add_buffers.clear();
+}
+
+bool piece_table::restore(std::string&& original, std::string&& add, const std::vector<piece>& pieces, line_ending ending)
+{
+    for (const piece& p : pieces)
+    {
+        const size_t buffer_length = p.buf_type == buffer_type::ORIGINAL ? original.length() : add.length();
+        if (p.start > buffer_length || p.length > buffer_length - p.start)
+            return false;
+    }
+
+    clear();
+    m_original_text = std::move(original);
+    m_original_buffer = m_original_text;
+    m_add_buffer = std::move(add);
+    m_line_ending = ending;
+    m_treap.build(pieces);
+    return true;
 }
 
 size_t piece_table::get_index_for_line(size_t target_line) const
@@ -160,8 +937,8 @@ size_t piece_table::get_index_for_line(size_t target_line) const
     if (target_line == 0 || m_treap.empty())
         return 0;
 
-    const size_t total_lines = get_line_count();
-    if (target_line > total_lines)
+    // newline_count + 1 is the empty line after a trailing newline and resolves to length() below
+    if (target_line > m_treap.get_newline_count() + 1)
         return length();
     if (target_line == 1)
         return 0;
@@ -176,26 +953,122 @@ size_t piece_table::get_index_for_line(size_t target_line) const
 
     // line_in_piece tells us this is the Nth line that starts in this piece
     // Line 1 in piece starts after 1st newline, line 2 after 2nd, etc.
-    size_t newlines_to_skip = line_in_piece;
+    return byte_offset + find_nth_newline(n->data, line_in_piece);
+}
 
-    const std::string& buffer = (n->data.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
-    std::string_view piece_view(buffer.data() + n->data.start, n->data.length);
+size_t piece_table::find_nth_newline(const piece& p, size_t nth) const
+{
+    const std::string_view buffer = (p.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
+    const char* const begin = buffer.data() + p.start;
+    const char* const end = begin + p.length;
 
     size_t newlines_found = 0;
-    for (size_t i = 0; i < piece_view.length(); ++i)
+    const char* it = begin;
+    while ((it = static_cast<const char*>(std::memchr(it, '\n', end - it))) != nullptr)
     {
-        if (piece_view[i] == '\n')
+        if (++newlines_found == nth)
+            return (it - begin) + 1;
+        ++it;
+    }
+
+    // should not reach here if tree is consistent
+    return p.length;
+}
+
+template<typename segment_callback>
+line_info piece_table::scan_line(size_t line_number, segment_callback&& on_segment) const
+{
+    if (line_number == 0)
+        return {.start_byte = 0, .length = 0, .has_newline = false};
+    if (line_number > m_treap.get_newline_count() + 1)
+        return {.start_byte = length(), .length = 0, .has_newline = false};
+
+    line_info info{.start_byte = 0, .length = 0, .has_newline = false};
+    size_t scan_from = 0; // first byte of the piece where the scan continues
+
+    // a '\r' right before the '\n' is part of the line break, so a segment's last '\r' is held back until the next byte is known.
+    // only CRLF documents have any
+    bool held_carriage_return = false;
+    const auto emit = [&](std::string_view segment, bool before_newline) {
+        if (held_carriage_return && !segment.empty())
         {
-            newlines_found++;
-            if (newlines_found == newlines_to_skip)
-            {
-                return byte_offset + i + 1;
-            }
+            on_segment(std::string_view("\r", 1));
+            ++info.length;
+            held_carriage_return = false;
+        }
+        if (!segment.empty() && segment.back() == '\r')
+        {
+            segment.remove_suffix(1);
+            held_carriage_return = true;
+        }
+        on_segment(segment);
+        info.length += segment.length();
+
+        if (before_newline)
+        {
+            info.has_newline = true;
+            info.newline_length = held_carriage_return ? 2 : 1;
+            held_carriage_return = false;
         }
+    };
+    const auto finish = [&]() {
+        if (held_carriage_return)
+        {
+            on_segment(std::string_view("\r", 1)); // the last line has no break to belong to
+            ++info.length;
+        }
+        return info;
+    };
+
+    if (line_number > 1)
+    {
+        node* n = nullptr;
+        size_t byte_offset = 0;
+        size_t line_in_piece = 0;
+        m_treap.find_line_position(line_number, n, byte_offset, line_in_piece);
+        if (!n)
+            return {.start_byte = length(), .length = 0, .has_newline = false};
+
+        const size_t offset = find_nth_newline(n->data, line_in_piece);
+        info.start_byte = byte_offset + offset;
+
+        // most lines end in the same piece they start in
+        const std::string_view buffer = (n->data.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
+        std::string_view rest(buffer.data() + n->data.start + offset, n->data.length - offset);
+        const size_t nl = rest.find('\n');
+        if (nl != std::string_view::npos)
+        {
+            emit(rest.substr(0, nl), true);
+            return info;
+        }
+
+        emit(rest, false);
+        scan_from = byte_offset + n->data.length;
+        if (scan_from >= length())
+            return finish();
     }
 
-    // should not reach here if tree is consistent
-    return byte_offset + n->data.length;
+    m_treap.for_each_from_byte(scan_from, [&](const AL::piece& p) {
+        const std::string_view buffer = (p.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
+        std::string_view pv(buffer.data() + p.start, p.length);
+
+        const size_t nl = pv.find('\n');
+        if (nl != std::string_view::npos)
+        {
+            emit(pv.substr(0, nl), true);
+            return true;
+        }
+
+        emit(pv, false);
+        return false;
+    });
+
+    return info.has_newline ? info : finish();
+}
+
+line_info piece_table::get_line_info(size_t line_number) const
+{
+    return scan_line(line_number, [](std::string_view) {});
 }
 
 void piece_table::write_to(std::ostream& os) const
@@ -203,7 +1076,7 @@ void piece_table::write_to(std::ostream& os) const
     m_treap.for_each([this, &os](const AL::piece& piece) {
         if (piece.buf_type == AL::buffer_type::ORIGINAL)
         {
-            const std::string& buffer = m_original_buffer;
+            const std::string_view buffer = m_original_buffer;
             os.write(buffer.data() + piece.start, piece.length);
         }
         else
@@ -216,6 +1089,185 @@ void piece_table::write_to(std::ostream& os) const
     });
 }
 
+bool piece_table::get_changed_ranges(std::vector<text_range>& out) const
+{
+    out.clear();
+    if (length() != m_original_buffer.length())
+        return false;
+
+    size_t offset = 0;
+    m_treap.for_each([&](const piece& p) {
+        if (p.buf_type != buffer_type::ORIGINAL || p.start != offset)
+        {
+            if (!out.empty() && out.back().start + out.back().length == offset)
+                out.back().length += p.length;
+            else
+                out.push_back({offset, p.length});
+        }
+        offset += p.length;
+        return false;
+    });
+    return true;
+}
+
+#if MINIEDITOR_POSIX_IO
+// writev may stop part way, so whatever is left of the batch is written again
+static bool write_all(int fd, iovec* iov, int count)
+{
+    while (count > 0)
+    {
+        const ssize_t written = ::writev(fd, iov, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        auto left = static_cast<size_t>(written);
+        while (count > 0 && left >= iov->iov_len)
+        {
+            left -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+// copies length bytes at offset of from_fd to the end of to_fd inside the kernel. whatever it will not copy
+// (another filesystem, no support, a source that got shorter) is written from the bytes we already have
+static bool copy_from_fd(int from_fd, size_t offset, int to_fd, const char* bytes, size_t length)
+{
+#if defined(__linux__)
+    auto in = static_cast<off_t>(offset);
+    while (length > 0)
+    {
+        const ssize_t copied = ::copy_file_range(from_fd, &in, to_fd, nullptr, length, 0);
+        if (copied < 0 && errno == EINTR)
+            continue;
+        if (copied <= 0)
+            break;
+
+        bytes += copied;
+        length -= static_cast<size_t>(copied);
+    }
+#else
+    (void)from_fd;
+    (void)offset;
+#endif
+
+    iovec rest = {.iov_base = const_cast<char*>(bytes), .iov_len = length};
+    return length == 0 || write_all(to_fd, &rest, 1);
+}
+
+bool piece_table::write_to_fd(int fd) const
+{
+    return write_to_fd(fd, -1);
+}
+
+// the writev and copy_file_range loop behind write_to_fd and write_frozen. for_each_piece hands the pieces in order to
+// its callback, which returns true to stop. written, if given, goes up after every batch that reached the file
+template<typename piece_visitor>
+static bool write_pieces(int fd, int original_fd, const char* original, const char* add, size_t min_copy_length, piece_visitor&& for_each_piece,
+                         std::atomic<size_t>* written)
+{
+#ifdef IOV_MAX
+    constexpr size_t batch_size = IOV_MAX;
+#else
+    constexpr size_t batch_size = 1024;
+#endif
+    std::vector<iovec> batch;
+    batch.reserve(batch_size);
+    size_t batch_length = 0;
+    bool ok = true;
+
+    const auto count_written = [&](size_t length) {
+        if (written && ok)
+            written->fetch_add(length, std::memory_order_relaxed);
+    };
+    const auto flush_batch = [&]() {
+        ok = ok && write_all(fd, batch.data(), static_cast<int>(batch.size()));
+        count_written(batch_length);
+        batch.clear();
+        batch_length = 0;
+    };
+    const auto add_bytes = [&](const char* data, size_t length) {
+        batch.push_back({.iov_base = const_cast<char*>(data), .iov_len = length});
+        batch_length += length;
+        if (batch.size() == batch_size)
+            flush_batch();
+    };
+
+    // ORIGINAL pieces that follow each other in the file are gathered into one run (untouched regions are many 16 KB pieces)
+    size_t run_start = 0;
+    size_t run_length = 0;
+    const auto flush_run = [&]() {
+        if (run_length >= min_copy_length)
+        {
+            flush_batch();
+            ok = ok && copy_from_fd(original_fd, run_start, fd, original + run_start, run_length);
+            count_written(run_length);
+        }
+        else if (run_length > 0)
+        {
+            add_bytes(original + run_start, run_length);
+        }
+        run_length = 0;
+    };
+
+    for_each_piece([&](const AL::piece& piece) {
+        if (original_fd >= 0 && piece.buf_type == buffer_type::ORIGINAL)
+        {
+            if (run_length > 0 && run_start + run_length == piece.start)
+            {
+                run_length += piece.length;
+            }
+            else
+            {
+                flush_run();
+                run_start = piece.start;
+                run_length = piece.length;
+            }
+        }
+        else
+        {
+            flush_run();
+            add_bytes((piece.buf_type == buffer_type::ORIGINAL ? original : add) + piece.start, piece.length);
+        }
+        return !ok;
+    });
+
+    flush_run();
+    flush_batch();
+    return ok;
+}
+
+bool piece_table::write_to_fd(int fd, int original_fd) const
+{
+    return write_pieces(fd, original_fd, m_original_buffer.data(), m_add_buffer.data(), m_min_copy_file_range_length,
+                        [&](auto&& callback) { m_treap.for_each(callback); }, nullptr);
+}
+
+bool piece_table::write_frozen(int fd, const frozen_document& document, int original_fd, std::atomic<size_t>& written)
+{
+    return write_pieces(fd, original_fd, document.original.data(), document.add.data(), m_min_copy_file_range_length,
+                        [&](auto&& callback) {
+                            for (const piece& p : document.pieces)
+                            {
+                                if (callback(p))
+                                    return;
+                            }
+                        },
+                        &written);
+}
+#endif // MINIEDITOR_POSIX_IO
+
 std::string piece_table::to_string() const
 {
     if (!m_needs_rebuild)
@@ -243,46 +1295,9 @@ std::string piece_table::to_string() const
 
 std::string piece_table::get_line(size_t line_number) const
 {
+    MINIEDITOR_LATENCY_SCOPE(latency_op::PT_GET_LINE);
     std::string result;
-    if (line_number == 0 || line_number > get_line_count())
-        return result;
-
-    size_t line_start_index = get_index_for_line(line_number);
-    if (line_start_index >= length())
-        return result;
-
-    // Find the piece containing line_start_index in O(log n)
-    node* start_node = nullptr;
-    size_t piece_byte_offset = 0;
-    m_treap.find_by_byte(line_start_index, start_node, piece_byte_offset);
-    if (!start_node)
-        return result;
-
-    const size_t skip_in_first = line_start_index - piece_byte_offset;
-    bool is_first = true;
-
-    // Emit from piece_byte_offset onwards, skipping the leading bytes in the first piece
-    m_treap.for_each_from_byte(piece_byte_offset, [&](const AL::piece& p) {
-        const std::string& buffer = (p.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
-
-        size_t offset = 0;
-        if (is_first)
-        {
-            offset = skip_in_first;
-            is_first = false;
-        }
-
-        std::string_view pv(buffer.data() + p.start + offset, p.length - offset);
-        const size_t nl = pv.find('\n');
-        if (nl != std::string_view::npos)
-        {
-            result.append(pv.data(), nl);
-            return true;
-        }
-        result.append(pv);
-        return false;
-    });
-
+    scan_line(line_number, [&result](std::string_view segment) { result.append(segment); });
     return result;
 }
 
@@ -318,23 +1333,78 @@ char piece_table::get_char_at(size_t byte_index) const
     if (!n)
         return '\0';
 
-    return (n->data.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer).c_str()[n->data.start + byte_index - byte_offset];
+    const std::string_view buffer = (n->data.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
+    return buffer[n->data.start + byte_index - byte_offset];
 }
 
-size_t piece_table::get_line_length(size_t line_number) const
+size_t piece_table::get_newline_count_before(size_t byte_index) const
 {
-    if (line_number == 0 || line_number > get_line_count())
-        return 0;
+    if (byte_index >= length())
+        return m_treap.get_newline_count();
+
+    node* n = nullptr;
+    size_t byte_offset = 0;
+    size_t newlines_before = 0;
+    m_treap.find_by_byte(byte_index, n, byte_offset, newlines_before);
+    if (!n)
+        return m_treap.get_newline_count();
 
-    const size_t line_start_index = get_index_for_line(line_number);
-    const size_t next_line_start_index = (line_number < get_line_count()) ? get_index_for_line(line_number + 1) : length();
+    const std::string_view buffer = (n->data.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
+    const char* piece_begin = buffer.data() + n->data.start;
+    return newlines_before + count_byte(piece_begin, byte_index - byte_offset, '\n');
+}
 
-    size_t end_index = next_line_start_index;
-    if (end_index > line_start_index && end_index <= length() && get_char_at(end_index - 1) == '\n')
+text_position piece_table::get_line_col_for_index(size_t byte_index) const
+{
+    if (byte_index >= length())
     {
-        end_index -= 1;
+        // the end of the document, possibly on the empty line after a trailing newline
+        const size_t line = m_treap.get_newline_count() + 1;
+        return {.line = line, .col = length() - get_index_for_line(line) + 1};
     }
 
-    return end_index > line_start_index ? end_index - line_start_index : 0;
+    node* n = nullptr;
+    size_t byte_offset = 0;
+    size_t newlines_before = 0;
+    m_treap.find_by_byte(byte_index, n, byte_offset, newlines_before);
+    if (!n)
+        return {.line = 1, .col = 1};
+
+    const std::string_view buffer = (n->data.buf_type == buffer_type::ORIGINAL ? m_original_buffer : m_add_buffer);
+    const char* piece_begin = buffer.data() + n->data.start;
+    const size_t in_piece = byte_index - byte_offset;
+
+    const size_t line = newlines_before + count_byte(piece_begin, in_piece, '\n') + 1;
+
+    // the line usually starts in this piece. otherwise it started in an earlier one
+    const char* last_newline = rfind_byte(piece_begin, in_piece, '\n');
+    const size_t line_start = last_newline ? byte_offset + (last_newline - piece_begin) + 1 : get_index_for_line(line);
+
+    return {.line = line, .col = byte_index - line_start + 1};
+}
+
+anchor_id piece_table::add_anchor(size_t byte_index)
+{
+    return m_anchors.add(std::min(byte_index, length()));
+}
+
+void piece_table::remove_anchor(anchor_id id)
+{
+    m_anchors.remove(id);
+}
+
+size_t piece_table::get_anchor_index(anchor_id id) const
+{
+    return m_anchors.get_position(id);
+}
+
+text_position piece_table::get_anchor_position(anchor_id id) const
+{
+    return get_line_col_for_index(m_anchors.get_position(id));
+}
+
+size_t piece_table::get_line_length(size_t line_number) const
+{
+    return get_line_info(line_number).length;
 }
 } // namespace AL
@@ -0,0 +1,1102 @@
+#include "regex.h"
+#include "latency.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace AL
+{
+
+namespace
+{
+constexpr uint32_t UNBOUNDED = UINT32_MAX;
+constexpr uint32_t MAX_REPEAT = 1000;
+constexpr size_t MAX_NESTING = 256;
+constexpr size_t MAX_NFA_STATES = 1 << 18;
+} // namespace
+
+struct regex::ast_node
+{
+    enum class kind : uint8_t
+    {
+        EMPTY,
+        BYTES,
+        CONCAT,
+        ALTERNATE,
+        REPEAT,
+        LINE_START,
+        LINE_END,
+    };
+
+    kind type = kind::EMPTY;
+    byte_set bytes;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    bool greedy = true;
+    std::vector<uint32_t> children;
+};
+
+/*
+ * Recursive descent over the pattern, building a flat list of ast nodes.
+ * The first error wins and everything after it is ignored.
+ */
+class regex::parser
+{
+public:
+    explicit parser(std::string_view pattern) : m_pattern(pattern), m_pos(0)
+    {
+    }
+
+    bool parse(uint32_t& root, std::string& error)
+    {
+        root = parse_alternation(0);
+        if (m_error.empty() && m_pos < m_pattern.length())
+            fail("unmatched ')'");
+
+        error = m_error;
+        return m_error.empty();
+    }
+
+    const std::vector<ast_node>& get_nodes() const
+    {
+        return m_nodes;
+    }
+
+private:
+    std::string_view m_pattern;
+    size_t m_pos;
+    std::string m_error;
+    std::vector<ast_node> m_nodes;
+
+    bool at_end() const
+    {
+        return m_pos >= m_pattern.length();
+    }
+
+    char peek() const
+    {
+        return m_pattern[m_pos];
+    }
+
+    uint32_t fail(const std::string& message)
+    {
+        if (m_error.empty())
+            m_error = message + " at offset " + std::to_string(m_pos);
+        return 0;
+    }
+
+    uint32_t add(ast_node node)
+    {
+        m_nodes.push_back(std::move(node));
+        return static_cast<uint32_t>(m_nodes.size() - 1);
+    }
+
+    uint32_t add_bytes(const byte_set& bytes)
+    {
+        ast_node node;
+        node.type = ast_node::kind::BYTES;
+        node.bytes = bytes;
+        return add(std::move(node));
+    }
+
+    uint32_t parse_alternation(size_t depth)
+    {
+        if (depth > MAX_NESTING)
+            return fail("groups nested too deeply");
+
+        std::vector<uint32_t> branches{parse_concat(depth)};
+        while (m_error.empty() && !at_end() && peek() == '|')
+        {
+            ++m_pos;
+            branches.push_back(parse_concat(depth));
+        }
+
+        if (branches.size() == 1)
+            return branches[0];
+
+        ast_node node;
+        node.type = ast_node::kind::ALTERNATE;
+        node.children = std::move(branches);
+        return add(std::move(node));
+    }
+
+    uint32_t parse_concat(size_t depth)
+    {
+        std::vector<uint32_t> items;
+        while (m_error.empty() && !at_end() && peek() != '|' && peek() != ')')
+            items.push_back(parse_repeat(depth));
+
+        if (items.size() == 1)
+            return items[0];
+
+        ast_node node;
+        node.type = items.empty() ? ast_node::kind::EMPTY : ast_node::kind::CONCAT;
+        node.children = std::move(items);
+        return add(std::move(node));
+    }
+
+    uint32_t parse_repeat(size_t depth)
+    {
+        uint32_t atom = parse_atom(depth);
+        while (m_error.empty() && !at_end())
+        {
+            uint32_t min = 0;
+            uint32_t max = 0;
+            const char c = peek();
+            if (c == '*' || c == '+' || c == '?')
+            {
+                min = c == '+' ? 1 : 0;
+                max = c == '?' ? 1 : UNBOUNDED;
+                ++m_pos;
+            }
+            else if (c != '{' || !parse_bounds(min, max))
+            {
+                break;
+            }
+
+            if (!m_error.empty())
+                break;
+
+            ast_node node;
+            node.type = ast_node::kind::REPEAT;
+            node.min = min;
+            node.max = max;
+            if (!at_end() && peek() == '?')
+            {
+                node.greedy = false;
+                ++m_pos;
+            }
+            node.children = {atom};
+            atom = add(std::move(node));
+        }
+
+        return atom;
+    }
+
+    // {m}, {m,} or {m,n}. anything else leaves the '{' to be read as a literal
+    bool parse_bounds(uint32_t& min, uint32_t& max)
+    {
+        size_t pos = m_pos + 1;
+        auto read_number = [&](uint32_t& value) {
+            const size_t begin = pos;
+            uint64_t number = 0;
+            while (pos < m_pattern.length() && m_pattern[pos] >= '0' && m_pattern[pos] <= '9')
+            {
+                number = std::min<uint64_t>(number * 10 + static_cast<uint64_t>(m_pattern[pos] - '0'), UINT32_MAX - 1);
+                ++pos;
+            }
+            value = static_cast<uint32_t>(number);
+            return pos > begin;
+        };
+
+        if (!read_number(min))
+            return false;
+
+        max = min;
+        if (pos < m_pattern.length() && m_pattern[pos] == ',')
+        {
+            ++pos;
+            if (!read_number(max))
+                max = UNBOUNDED;
+        }
+
+        if (pos >= m_pattern.length() || m_pattern[pos] != '}')
+            return false;
+
+        m_pos = pos + 1;
+        if (max != UNBOUNDED && min > max)
+            fail("repeat bounds out of order");
+        else if (min > MAX_REPEAT || (max != UNBOUNDED && max > MAX_REPEAT))
+            fail("repeat count is larger than " + std::to_string(MAX_REPEAT));
+        return true;
+    }
+
+    uint32_t parse_atom(size_t depth)
+    {
+        const char c = peek();
+        ++m_pos;
+
+        byte_set bytes;
+        switch (c)
+        {
+            case '(':
+            {
+                // groups do not capture, so (?:...) is the same thing
+                if (m_pattern.substr(m_pos, 2) == "?:")
+                    m_pos += 2;
+
+                const uint32_t inner = parse_alternation(depth + 1);
+                if (!m_error.empty())
+                    return inner;
+                if (at_end() || peek() != ')')
+                    return fail("missing ')'");
+                ++m_pos;
+                return inner;
+            }
+            case '[':
+                parse_class(bytes);
+                return add_bytes(bytes);
+            case '.':
+                bytes.set();
+                bytes.reset('\n');
+                return add_bytes(bytes);
+            case '^':
+            case '$':
+            {
+                ast_node node;
+                node.type = c == '^' ? ast_node::kind::LINE_START : ast_node::kind::LINE_END;
+                return add(std::move(node));
+            }
+            case '\\':
+                parse_escape(bytes);
+                return add_bytes(bytes);
+            case '*':
+            case '+':
+            case '?':
+                --m_pos;
+                return fail("nothing to repeat");
+            default:
+                bytes.set(static_cast<unsigned char>(c));
+                return add_bytes(bytes);
+        }
+    }
+
+    // the part after a '\'. adds what it stands for to bytes
+    void parse_escape(byte_set& bytes)
+    {
+        if (at_end())
+        {
+            fail("trailing '\\'");
+            return;
+        }
+
+        const char c = peek();
+        ++m_pos;
+
+        byte_set named;
+        switch (c)
+        {
+            case 'd':
+            case 'D':
+                for (int b = '0'; b <= '9'; ++b)
+                    named.set(b);
+                break;
+            case 'w':
+            case 'W':
+                for (int b = 0; b < 256; ++b)
+                    named[b] = (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || (b >= '0' && b <= '9') || b == '_';
+                break;
+            case 's':
+            case 'S':
+                for (char b : {' ', '\t', '\n', '\r', '\f', '\v'})
+                    named.set(static_cast<unsigned char>(b));
+                break;
+            case 'n':
+                bytes.set('\n');
+                return;
+            case 't':
+                bytes.set('\t');
+                return;
+            case 'r':
+                bytes.set('\r');
+                return;
+            case 'f':
+                bytes.set('\f');
+                return;
+            case 'v':
+                bytes.set('\v');
+                return;
+            case 'x':
+            {
+                auto hex = [](char h) {
+                    if (h >= '0' && h <= '9')
+                        return h - '0';
+                    if (h >= 'a' && h <= 'f')
+                        return h - 'a' + 10;
+                    if (h >= 'A' && h <= 'F')
+                        return h - 'A' + 10;
+                    return -1;
+                };
+
+                if (m_pos + 2 > m_pattern.length() || hex(m_pattern[m_pos]) < 0 || hex(m_pattern[m_pos + 1]) < 0)
+                {
+                    fail("\\x needs two hex digits");
+                    return;
+                }
+                bytes.set(static_cast<size_t>(hex(m_pattern[m_pos]) * 16 + hex(m_pattern[m_pos + 1])));
+                m_pos += 2;
+                return;
+            }
+            default:
+                if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+                {
+                    --m_pos;
+                    fail(std::string("unknown escape '\\") + c + "'");
+                    return;
+                }
+                bytes.set(static_cast<unsigned char>(c)); // escaped punctuation is itself
+                return;
+        }
+
+        // upper case means everything but
+        bytes |= (c >= 'A' && c <= 'Z') ? ~named : named;
+    }
+
+    // the part after a '['
+    void parse_class(byte_set& bytes)
+    {
+        const bool negate = !at_end() && peek() == '^';
+        if (negate)
+            ++m_pos;
+
+        // a single byte item, or -1 for a named class like \d
+        auto parse_item = [&](byte_set& item) {
+            if (peek() == '\\')
+            {
+                ++m_pos;
+                parse_escape(item);
+                if (item.count() != 1)
+                    return -1;
+                for (int b = 0; b < 256; ++b)
+                    if (item[b])
+                        return b;
+            }
+            const auto b = static_cast<unsigned char>(peek());
+            ++m_pos;
+            item.set(b);
+            return static_cast<int>(b);
+        };
+
+        for (bool first = true;; first = false)
+        {
+            if (at_end())
+            {
+                fail("missing ']'");
+                return;
+            }
+            if (peek() == ']' && !first)
+            {
+                ++m_pos;
+                break;
+            }
+
+            byte_set item;
+            const int lo = parse_item(item);
+            if (!m_error.empty())
+                return;
+
+            if (lo >= 0 && m_pos + 1 < m_pattern.length() && peek() == '-' && m_pattern[m_pos + 1] != ']')
+            {
+                ++m_pos;
+                byte_set upper;
+                const int hi = parse_item(upper);
+                if (!m_error.empty())
+                    return;
+                if (hi < lo)
+                {
+                    fail("bad range in []");
+                    return;
+                }
+                for (int b = lo; b <= hi; ++b)
+                    bytes.set(static_cast<size_t>(b));
+            }
+            else
+            {
+                bytes |= item;
+            }
+        }
+
+        if (negate)
+            bytes.flip();
+    }
+};
+
+/*
+ * Turns the ast into NFA states, back to front: each node is built knowing the state
+ * that follows it, so nothing needs patching up afterwards (except the loop of a * repeat).
+ * The reversed program matches the reversed text: sequences are laid out the other way
+ * round and '^' and '$' swap which neighbour they look at.
+ */
+class regex::compiler
+{
+public:
+    explicit compiler(const std::vector<ast_node>& nodes) : m_nodes(nodes), m_prog(nullptr), m_reverse(false), m_too_large(false)
+    {
+    }
+
+    // returns false if the program would be too large
+    bool compile(uint32_t root, bool reverse, program& prog)
+    {
+        m_prog = &prog;
+        m_reverse = reverse;
+
+        const uint32_t match = add(nfa_state::kind::MATCH, 0, 0, 0);
+        prog.start = emit(root, match);
+
+        if (!reverse)
+        {
+            // unanchored search: a lazy any byte loop in front, so the pattern itself is always tried first
+            byte_set any;
+            any.set();
+            const uint32_t loop = add(nfa_state::kind::SPLIT, prog.start, 0, 0);
+            prog.states[loop].out1 = add(nfa_state::kind::BYTES, loop, 0, get_set(any));
+            prog.start = loop;
+        }
+
+        prog.uses_look_prev = std::any_of(prog.states.begin(), prog.states.end(),
+                                          [](const nfa_state& s) { return s.type == nfa_state::kind::LOOK_PREV; });
+        return !m_too_large;
+    }
+
+    // bytes that no set tells apart share a class. '\n' always gets its own since the anchors look for it
+    void assign_byte_classes(program& prog) const
+    {
+        prog.sets = m_sets;
+
+        std::array<bool, 256> boundary{};
+        boundary['\n'] = true;
+        boundary['\n' + 1] = true;
+        for (const auto& set : m_sets)
+        {
+            for (size_t b = 1; b < 256; ++b)
+                boundary[b] = boundary[b] || set[b] != set[b - 1];
+        }
+
+        uint32_t cls = 0;
+        for (size_t b = 0; b < 256; ++b)
+        {
+            if (b > 0 && boundary[b])
+                ++cls;
+            prog.byte_class[b] = static_cast<uint8_t>(cls);
+        }
+        prog.class_count = cls + 1;
+    }
+
+    // appends the literal every match starts with. returns false once the literal part is over
+    bool append_prefix(uint32_t index, std::string& prefix) const
+    {
+        const ast_node& node = m_nodes[index];
+        switch (node.type)
+        {
+            case ast_node::kind::EMPTY:
+            case ast_node::kind::LINE_START:
+            case ast_node::kind::LINE_END:
+                return true;
+            case ast_node::kind::BYTES:
+                if (node.bytes.count() != 1)
+                    return false;
+                for (size_t b = 0; b < 256; ++b)
+                {
+                    if (node.bytes[b])
+                        prefix.push_back(static_cast<char>(b));
+                }
+                return true;
+            case ast_node::kind::CONCAT:
+                for (uint32_t child : node.children)
+                {
+                    if (!append_prefix(child, prefix))
+                        return false;
+                }
+                return true;
+            case ast_node::kind::REPEAT:
+                if (node.min > 0)
+                    append_prefix(node.children[0], prefix);
+                return false;
+            case ast_node::kind::ALTERNATE:
+                return false;
+        }
+        return false;
+    }
+
+    // bytes a match can start with. false if it can also be empty
+    bool get_first_bytes(const program& prog, byte_set& bytes) const
+    {
+        // the pattern proper starts behind the unanchored loop
+        std::vector<uint32_t> stack{prog.states[prog.start].out};
+        std::vector<bool> seen(prog.states.size(), false);
+        while (!stack.empty())
+        {
+            const uint32_t s = stack.back();
+            stack.pop_back();
+            if (seen[s])
+                continue;
+            seen[s] = true;
+
+            const nfa_state& n = prog.states[s];
+            switch (n.type)
+            {
+                case nfa_state::kind::BYTES:
+                    bytes |= m_sets[n.set];
+                    break;
+                case nfa_state::kind::SPLIT:
+                    stack.push_back(n.out);
+                    stack.push_back(n.out1);
+                    break;
+                case nfa_state::kind::EMPTY:
+                case nfa_state::kind::LOOK_PREV:
+                case nfa_state::kind::LOOK_NEXT:
+                    stack.push_back(n.out);
+                    break;
+                case nfa_state::kind::MATCH:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool can_match_empty(uint32_t index) const
+    {
+        const ast_node& node = m_nodes[index];
+        switch (node.type)
+        {
+            case ast_node::kind::BYTES:
+                return false;
+            case ast_node::kind::CONCAT:
+                return std::all_of(node.children.begin(), node.children.end(), [this](uint32_t c) { return can_match_empty(c); });
+            case ast_node::kind::ALTERNATE:
+                return std::any_of(node.children.begin(), node.children.end(), [this](uint32_t c) { return can_match_empty(c); });
+            case ast_node::kind::REPEAT:
+                return node.min == 0 || can_match_empty(node.children[0]);
+            default:
+                return true;
+        }
+    }
+
+private:
+    const std::vector<ast_node>& m_nodes;
+    program* m_prog;
+    bool m_reverse;
+    bool m_too_large;
+    std::vector<byte_set> m_sets; // shared by both programs
+    std::unordered_map<byte_set, uint32_t> m_set_ids;
+
+    uint32_t get_set(const byte_set& bytes)
+    {
+        auto [it, inserted] = m_set_ids.try_emplace(bytes, static_cast<uint32_t>(m_sets.size()));
+        if (inserted)
+            m_sets.push_back(bytes);
+        return it->second;
+    }
+
+    uint32_t add(nfa_state::kind type, uint32_t out, uint32_t out1, uint32_t set)
+    {
+        if (m_prog->states.size() >= MAX_NFA_STATES)
+        {
+            m_too_large = true;
+            return 0;
+        }
+        m_prog->states.push_back({type, out, out1, set});
+        return static_cast<uint32_t>(m_prog->states.size() - 1);
+    }
+
+    // entry state of node, which continues into next
+    uint32_t emit(uint32_t index, uint32_t next)
+    {
+        if (m_too_large)
+            return 0;
+
+        const ast_node& node = m_nodes[index];
+        switch (node.type)
+        {
+            case ast_node::kind::EMPTY:
+                return next;
+            case ast_node::kind::BYTES:
+                return add(nfa_state::kind::BYTES, next, 0, get_set(node.bytes));
+            case ast_node::kind::LINE_START:
+                return add(m_reverse ? nfa_state::kind::LOOK_NEXT : nfa_state::kind::LOOK_PREV, next, 0, 0);
+            case ast_node::kind::LINE_END:
+                return add(m_reverse ? nfa_state::kind::LOOK_PREV : nfa_state::kind::LOOK_NEXT, next, 0, 0);
+            case ast_node::kind::CONCAT:
+                if (m_reverse)
+                {
+                    for (uint32_t child : node.children)
+                        next = emit(child, next);
+                }
+                else
+                {
+                    for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+                        next = emit(*it, next);
+                }
+                return next;
+            case ast_node::kind::ALTERNATE:
+            {
+                uint32_t entry = emit(node.children.back(), next);
+                for (size_t i = node.children.size() - 1; i-- > 0;)
+                    entry = add(nfa_state::kind::SPLIT, emit(node.children[i], next), entry, 0);
+                return entry;
+            }
+            case ast_node::kind::REPEAT:
+                return emit_repeat(node, next);
+        }
+        return next;
+    }
+
+    // x{min,max} is laid out as min copies of x, then either x* or (max - min) nested optional copies
+    uint32_t emit_repeat(const ast_node& node, uint32_t next)
+    {
+        const uint32_t child = node.children[0];
+        auto split = [&](uint32_t body, uint32_t skip) {
+            return node.greedy ? add(nfa_state::kind::SPLIT, body, skip, 0) : add(nfa_state::kind::SPLIT, skip, body, 0);
+        };
+
+        uint32_t tail = next;
+        if (node.max == UNBOUNDED)
+        {
+            const uint32_t loop = add(nfa_state::kind::SPLIT, 0, 0, 0);
+            const uint32_t body = emit(child, loop);
+            if (m_too_large)
+                return 0;
+            m_prog->states[loop] = node.greedy ? nfa_state{nfa_state::kind::SPLIT, body, next, 0} : nfa_state{nfa_state::kind::SPLIT, next, body, 0};
+            tail = loop;
+        }
+        else
+        {
+            for (uint32_t i = node.min; i < node.max && !m_too_large; ++i)
+                tail = split(emit(child, tail), next);
+        }
+
+        for (uint32_t i = 0; i < node.min && !m_too_large; ++i)
+            tail = emit(child, tail);
+        return tail;
+    }
+};
+
+regex::regex(std::string_view pattern) : m_pattern(pattern), m_prefix("")
+{
+    parser p(m_pattern);
+    uint32_t root = 0;
+    if (!p.parse(root, m_error))
+        return;
+
+    compiler c(p.get_nodes());
+    program forward;
+    program reverse;
+    if (!c.compile(root, false, forward) || !c.compile(root, true, reverse))
+    {
+        m_error = "pattern is too large";
+        return;
+    }
+    c.assign_byte_classes(forward);
+    c.assign_byte_classes(reverse);
+
+    byte_set first;
+    const bool has_first_bytes = c.get_first_bytes(forward, first) && !first.all();
+
+    m_forward = lazy_dfa(std::move(forward), true);
+    m_reverse = lazy_dfa(std::move(reverse), false);
+    m_can_match_empty = c.can_match_empty(root);
+
+    std::string prefix;
+    c.append_prefix(root, prefix);
+    m_prefix = searcher(prefix);
+
+    if (!has_first_bytes)
+        return;
+    for (size_t b = 0; b < 256; ++b)
+    {
+        if (!first[b] || (b > 0 && first[b - 1]))
+            continue;
+        if (m_first_byte_range_count == m_first_bytes.size())
+        {
+            m_first_byte_range_count = 0; // too scattered to be worth it
+            return;
+        }
+
+        size_t hi = b;
+        while (hi + 1 < 256 && first[hi + 1])
+            ++hi;
+        m_first_bytes[m_first_byte_range_count++] = {static_cast<unsigned char>(b), static_cast<unsigned char>(hi)};
+    }
+}
+
+bool regex::is_valid() const
+{
+    return m_error.empty();
+}
+
+const std::string& regex::get_error() const
+{
+    return m_error;
+}
+
+const std::string& regex::get_pattern() const
+{
+    return m_pattern;
+}
+
+regex::lazy_dfa::lazy_dfa(program prog, bool leftmost_first)
+    : m_prog(std::move(prog)), m_leftmost_first(leftmost_first),
+      m_shift(static_cast<uint32_t>(std::bit_width(std::max<uint32_t>(m_prog.class_count, 2) - 1)))
+{
+    m_seen.assign(m_prog.states.size(), 0);
+    flush();
+}
+
+void regex::lazy_dfa::flush()
+{
+    ++m_flush_count;
+    m_table.clear();
+    m_kernels.clear();
+    m_kernel_offset.assign(1, 0);
+    m_after_newline.clear();
+    m_is_start.clear();
+    m_state_ids.clear();
+    m_start_states[0] = m_start_states[1] = m_unknown;
+
+    m_next_kernel.clear();
+    intern(m_next_kernel, false); // the dead state is always 0
+}
+
+uint32_t regex::lazy_dfa::intern(const std::vector<uint32_t>& kernel, bool after_newline)
+{
+    m_key.assign(1, after_newline ? '\1' : '\0');
+    m_key.append(reinterpret_cast<const char*>(kernel.data()), kernel.size() * sizeof(uint32_t));
+
+    auto it = m_state_ids.find(m_key);
+    if (it != m_state_ids.end())
+        return it->second;
+
+    if (m_is_start.size() >= m_max_states)
+    {
+        std::vector<uint32_t> keep = kernel; // flush reuses the scratch kernel
+        flush();
+        return intern(keep, after_newline);
+    }
+
+    const auto id = static_cast<uint32_t>(m_is_start.size());
+    m_state_ids.emplace(m_key, id);
+    m_kernels.insert(m_kernels.end(), kernel.begin(), kernel.end());
+    m_kernel_offset.push_back(static_cast<uint32_t>(m_kernels.size()));
+    m_after_newline.push_back(after_newline);
+    m_is_start.push_back(kernel.size() == 1 && kernel[0] == m_prog.start);
+    m_table.resize(m_table.size() + (size_t(1) << m_shift), m_unknown);
+    return id;
+}
+
+uint32_t regex::lazy_dfa::get_start_state(bool after_newline)
+{
+    // '^' is the only thing that cares about the byte before
+    after_newline = after_newline && m_prog.uses_look_prev;
+
+    const size_t slot = after_newline ? 1 : 0;
+    if (m_start_states[slot] == m_unknown)
+    {
+        m_next_kernel.assign(1, m_prog.start);
+        const uint32_t id = intern(m_next_kernel, after_newline);
+        m_start_states[slot] = id << m_shift; // after intern, which may have flushed and reset the cache
+    }
+    return m_start_states[slot];
+}
+
+void regex::lazy_dfa::close(uint32_t state, bool after_newline, bool before_newline, bool& matched)
+{
+    // depth first, out before out1, so m_closure comes out in priority order
+    m_stack.push_back(state);
+    while (!m_stack.empty())
+    {
+        const uint32_t s = m_stack.back();
+        m_stack.pop_back();
+        if (m_seen[s] == m_stamp)
+            continue;
+        m_seen[s] = m_stamp;
+
+        const nfa_state& n = m_prog.states[s];
+        switch (n.type)
+        {
+            case nfa_state::kind::BYTES:
+                m_closure.push_back(s);
+                break;
+            case nfa_state::kind::SPLIT:
+                m_stack.push_back(n.out1);
+                m_stack.push_back(n.out);
+                break;
+            case nfa_state::kind::EMPTY:
+                m_stack.push_back(n.out);
+                break;
+            case nfa_state::kind::LOOK_PREV:
+                if (after_newline)
+                    m_stack.push_back(n.out);
+                break;
+            case nfa_state::kind::LOOK_NEXT:
+                if (before_newline)
+                    m_stack.push_back(n.out);
+                break;
+            case nfa_state::kind::MATCH:
+                matched = true;
+                if (m_leftmost_first)
+                {
+                    m_stack.clear();
+                    return;
+                }
+                break;
+        }
+    }
+}
+
+bool regex::lazy_dfa::close_kernel(uint32_t id, bool before_newline)
+{
+    bool matched = false;
+    m_closure.clear();
+    ++m_stamp;
+    for (uint32_t i = m_kernel_offset[id]; i < m_kernel_offset[id + 1]; ++i)
+    {
+        close(m_kernels[i], m_after_newline[id], before_newline, matched);
+        if (matched && m_leftmost_first)
+            break;
+    }
+    return matched;
+}
+
+bool regex::lazy_dfa::matches_at_end(uint32_t state, bool before_newline)
+{
+    return close_kernel(state >> m_shift, before_newline);
+}
+
+uint32_t regex::lazy_dfa::compute(uint32_t state, unsigned char c)
+{
+    const bool is_newline = c == '\n';
+    const bool matched = close_kernel(state >> m_shift, is_newline);
+
+    m_next_kernel.clear();
+    ++m_stamp;
+    for (uint32_t s : m_closure)
+    {
+        const nfa_state& n = m_prog.states[s];
+        if (m_prog.sets[n.set][c] && m_seen[n.out] != m_stamp)
+        {
+            m_seen[n.out] = m_stamp;
+            m_next_kernel.push_back(n.out);
+        }
+    }
+
+    const size_t flushes = m_flush_count;
+    const uint32_t next = intern(m_next_kernel, is_newline && m_prog.uses_look_prev && !m_next_kernel.empty());
+    const uint32_t t = (next << m_shift) | (matched ? 1 : 0);
+
+    // after a flush `state` no longer exists, the caller carries on from `next`
+    if (flushes == m_flush_count)
+        m_table[state + m_prog.byte_class[c]] = t;
+    return t;
+}
+
+// byte at index, read from chunk when it has it (saving a descent)
+static char byte_at(const piece_table& pt, size_t index, std::string_view chunk, size_t chunk_start)
+{
+    if (index >= chunk_start && index - chunk_start < chunk.length())
+        return chunk[index - chunk_start];
+    return pt.get_char_at(index);
+}
+
+size_t regex::scan_for_start(const piece_table& pt, size_t from, size_t match_end, std::string_view chunk, size_t chunk_start) const
+{
+    // scanning backwards, the "previous" byte is the one after match_end
+    uint32_t state = m_reverse.get_start_state(match_end == pt.length() || byte_at(pt, match_end, chunk, chunk_start) == '\n');
+    size_t match_begin = npos;
+    size_t pos = match_end;
+    bool dead = false;
+
+    // steps back over the length bytes before data_end, which is at pos. true once there is nothing left to do
+    auto walk = [&](const char* data_end, size_t length) {
+        uint32_t current = state;
+        for (size_t i = 1; i <= length; ++i)
+        {
+            bool matched = false;
+            current = m_reverse.step(current, static_cast<unsigned char>(data_end[-static_cast<std::ptrdiff_t>(i)]), matched);
+            if (matched)
+                match_begin = pos - i + 1;
+            if (m_reverse.is_dead(current))
+            {
+                dead = true;
+                return true;
+            }
+        }
+
+        state = current;
+        pos -= length;
+        return pos <= from;
+    };
+
+    const bool in_chunk = match_end > chunk_start && match_end - chunk_start <= chunk.length();
+    if (!in_chunk || !walk(chunk.data() + (match_end - chunk_start), std::min(match_end - chunk_start, match_end - from)))
+    {
+        pt.for_each_chunk_reverse(pos, [&](std::string_view piece) { return walk(piece.data() + piece.length(), std::min(piece.length(), pos - from)); });
+    }
+
+    if (!dead && m_reverse.matches_at_end(state, from == 0 || byte_at(pt, from - 1, chunk, chunk_start) == '\n'))
+        match_begin = from;
+    return match_begin;
+}
+
+template<typename match_callback>
+void regex::scan_forward(const piece_table& pt, size_t begin, size_t end, bool need_begin, match_callback&& on_match) const
+{
+    end = std::min(end, pt.length());
+    if (!is_valid())
+        return;
+
+    need_begin = need_begin || m_can_match_empty;
+    const size_t prefix_length = m_prefix.length();
+    const bool accelerate = prefix_length > 1 || m_first_byte_range_count > 0;
+
+    // one walk over the chunks finds match after match. it only has to start over (with a descent)
+    // when a match ends before the chunk in which the DFA noticed it had ended
+    size_t from = begin; // where the current search started
+    while (from <= end)
+    {
+        uint32_t state = m_forward.get_start_state(from == 0 || pt.get_char_at(from - 1) == '\n');
+        size_t match_end = npos;
+        size_t pos = from; // global index of the current chunk
+        size_t restart = npos;
+        bool stop = false;
+
+        // reports the match that just ended and works out where the next search starts
+        auto report = [&](std::string_view chunk, size_t chunk_start) {
+            const size_t match_begin = need_begin ? scan_for_start(pt, from, match_end, chunk, chunk_start) : npos;
+            if (on_match(match_begin, match_end))
+            {
+                stop = true;
+                return;
+            }
+            from = match_begin == match_end ? match_end + 1 : match_end; // step over empty matches
+            match_end = npos;
+        };
+
+        pt.for_each_chunk(from, [&](std::string_view chunk) {
+            const char* data = chunk.data();
+            const size_t length = std::min(chunk.length(), end - pos);
+            uint32_t current = state; // a local, so stepping does not have to assume it aliases the table
+            for (size_t i = 0; i < length; ++i)
+            {
+                if (accelerate && m_forward.is_start(current))
+                {
+                    // nothing is in flight, so jump to the next place a match could start. when the literal prefix is not
+                    // in this chunk, only the last (prefix - 1) bytes could still begin one that runs into the next
+                    size_t skip_to;
+                    if (prefix_length > 1)
+                    {
+                        const size_t hit = m_prefix.find_in(data + i, length - i);
+                        skip_to = hit != searcher::npos ? i + hit : std::max(i, length - std::min(length, prefix_length - 1));
+                    }
+                    else
+                    {
+                        const char* hit = find_byte_in_ranges(data + i, length - i, m_first_bytes.data(), m_first_byte_range_count);
+                        skip_to = hit ? static_cast<size_t>(hit - data) : length;
+                    }
+
+                    if (skip_to > i)
+                    {
+                        current = m_forward.get_start_state(data[skip_to - 1] == '\n');
+                        i = skip_to;
+                        if (i == length)
+                            break;
+                    }
+                }
+
+                bool matched = false;
+                current = m_forward.step(current, static_cast<unsigned char>(data[i]), matched);
+                if (matched)
+                    match_end = pos + i;
+                if (!m_forward.is_dead(current))
+                    continue;
+
+                report(chunk, pos);
+                if (stop || from > end)
+                    return true;
+                if (from <= pos)
+                {
+                    restart = from; // the next search starts in an earlier chunk
+                    return true;
+                }
+
+                // carry on from the end of the match, which is in this chunk
+                current = m_forward.get_start_state(data[from - pos - 1] == '\n');
+                i = from - pos - 1;
+            }
+
+            state = current;
+            pos += length;
+            return pos >= end;
+        });
+
+        if (stop)
+            return;
+        if (restart != npos)
+            continue;
+
+        // the walk reached end with the DFA still alive
+        if (from <= end && m_forward.matches_at_end(state, end == pt.length() || pt.get_char_at(end) == '\n'))
+            match_end = end;
+        if (match_end == npos)
+            return;
+
+        report({}, 0);
+        if (stop)
+            return;
+    }
+}
+
+regex_match regex::find_next(const piece_table& pt, size_t from) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    regex_match result{npos, npos, {0, 0}};
+    scan_forward(pt, from, pt.length(), true, [&](size_t match_begin, size_t match_end) {
+        result.begin = match_begin;
+        result.end = match_end;
+        return true;
+    });
+
+    if (result.begin != npos)
+        result.position = pt.get_line_col_for_index(result.begin);
+    return result;
+}
+
+regex_match regex::find_prev(const piece_table& pt, size_t before) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    regex_match last{npos, npos, {0, 0}};
+    before = std::min(before, pt.length());
+
+    // matches only make sense scanning forwards, so scan a window that starts on a line
+    // some way back, and go further back (4x each time) until something turns up
+    for (size_t window = m_min_prev_window; is_valid(); window *= 4)
+    {
+        const size_t from = before > window ? pt.get_line_info(pt.get_line_col_for_index(before - window).line).start_byte : 0;
+        scan_forward(pt, from, before, true, [&](size_t match_begin, size_t match_end) {
+            last.begin = match_begin;
+            last.end = match_end;
+            return false;
+        });
+
+        if (last.begin != npos || from == 0)
+            break;
+    }
+
+    if (last.begin != npos)
+        last.position = pt.get_line_col_for_index(last.begin);
+    return last;
+}
+
+void regex::find_all(const piece_table& pt, size_t begin, size_t end, std::vector<regex_match>& out) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    scan_forward(pt, begin, end, true, [&](size_t match_begin, size_t match_end) {
+        out.push_back({match_begin, match_end, pt.get_line_col_for_index(match_begin)});
+        return false;
+    });
+}
+
+size_t regex::count(const piece_table& pt, size_t begin, size_t end) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    size_t matches = 0;
+    scan_forward(pt, begin, end, false, [&matches](size_t, size_t) {
+        ++matches;
+        return false;
+    });
+    return matches;
+}
+
+} // namespace AL
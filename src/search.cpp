@@ -0,0 +1,383 @@
+#include "search.h"
+#include "byte_scan.h"
+#include "latency.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINIEDITOR_SEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace AL
+{
+
+searcher::searcher(std::string_view pattern) : m_pattern(pattern)
+{
+    const size_t m = m_pattern.length();
+    const auto default_shift = static_cast<uint32_t>(std::max<size_t>(m, 1));
+    m_shift.fill(default_shift);
+    m_reverse_shift.fill(default_shift);
+
+    // distance from the last occurrence (excluding the final byte) to the end of the pattern
+    for (size_t j = 0; j + 1 < m; ++j)
+        m_shift[static_cast<unsigned char>(m_pattern[j])] = static_cast<uint32_t>(m - 1 - j);
+
+    // distance from the start of the pattern to the first occurrence (excluding the first byte)
+    for (size_t k = m; k-- > 1;)
+        m_reverse_shift[static_cast<unsigned char>(m_pattern[k])] = static_cast<uint32_t>(k);
+}
+
+size_t searcher::horspool(const char* data, size_t length) const
+{
+    const size_t m = m_pattern.length();
+    const char last = m_pattern[m - 1];
+
+    size_t i = 0;
+    while (i + m <= length)
+    {
+        const char c = data[i + m - 1];
+        if (c == last && std::memcmp(data + i, m_pattern.data(), m - 1) == 0)
+            return i;
+        i += m_shift[static_cast<unsigned char>(c)];
+    }
+
+    return npos;
+}
+
+size_t searcher::reverse_horspool(const char* data, size_t length) const
+{
+    const size_t m = m_pattern.length();
+    if (length < m)
+        return npos;
+
+    size_t i = length - m;
+    while (true)
+    {
+        const char c = data[i];
+        if (c == m_pattern[0] && std::memcmp(data + i + 1, m_pattern.data() + 1, m - 1) == 0)
+            return i;
+
+        const size_t shift = m_reverse_shift[static_cast<unsigned char>(c)];
+        if (i < shift)
+            return npos;
+        i -= shift;
+    }
+}
+
+size_t searcher::find_in(const char* data, size_t length) const
+{
+    const size_t m = m_pattern.length();
+    if (m == 0 || length < m)
+        return npos;
+
+    if (m == 1)
+    {
+        const void* hit = std::memchr(data, m_pattern[0], length);
+        return hit ? static_cast<size_t>(static_cast<const char*>(hit) - data) : npos;
+    }
+
+    size_t i = 0;
+#if MINIEDITOR_SEARCH_SSE2
+    // a position is a candidate when both the first and the last byte of the pattern line up
+    const __m128i first = _mm_set1_epi8(m_pattern[0]);
+    const __m128i last = _mm_set1_epi8(m_pattern[m - 1]);
+    // 32 candidates per step. two 16 byte blocks keep more loads in flight
+    for (; i + m - 1 + 32 <= length; i += 32)
+    {
+        const __m128i lo = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), first),
+                                         _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + m - 1)), last));
+        const __m128i hi = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16)), first),
+                                         _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + m + 15)), last));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(lo)) | (static_cast<uint32_t>(_mm_movemask_epi8(hi)) << 16);
+
+        while (mask)
+        {
+            const auto bit = static_cast<size_t>(std::countr_zero(mask));
+            if (std::memcmp(data + i + bit + 1, m_pattern.data() + 1, m - 2) == 0)
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    const size_t hit = horspool(data + i, length - i);
+    return hit == npos ? npos : i + hit;
+}
+
+size_t searcher::rfind_in(const char* data, size_t length) const
+{
+    const size_t m = m_pattern.length();
+    if (m == 0 || length < m)
+        return npos;
+
+    if (m == 1)
+    {
+        const char* hit = rfind_byte(data, length, m_pattern[0]);
+        return hit ? static_cast<size_t>(hit - data) : npos;
+    }
+
+    // candidate starts are [0, candidates)
+    size_t candidates = length - m + 1;
+#if MINIEDITOR_SEARCH_SSE2
+    const __m128i first = _mm_set1_epi8(m_pattern[0]);
+    const __m128i last = _mm_set1_epi8(m_pattern[m - 1]);
+    while (candidates >= 16)
+    {
+        candidates -= 16;
+        const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + candidates));
+        const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + candidates + m - 1));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+
+        while (mask)
+        {
+            const auto bit = static_cast<size_t>(std::bit_width(mask) - 1);
+            if (std::memcmp(data + candidates + bit + 1, m_pattern.data() + 1, m - 2) == 0)
+                return candidates + bit;
+            mask &= ~(1u << bit);
+        }
+    }
+#endif
+
+    return reverse_horspool(data, candidates + m - 1);
+}
+
+template<typename match_callback>
+void searcher::scan_forward(const piece_table& pt, size_t begin, size_t end, match_callback&& on_match) const
+{
+    const size_t m = m_pattern.length();
+    if (m == 0 || begin >= end)
+        return;
+
+    std::string carry; // the last m - 1 bytes before the current chunk
+    size_t carry_start = begin;
+    size_t chunk_start = begin;
+    size_t next_allowed = begin; // keeps matches from overlapping
+
+    pt.for_each_chunk(begin, [&](std::string_view chunk) {
+        if (chunk.length() > end - chunk_start)
+            chunk = chunk.substr(0, end - chunk_start);
+
+        // matches that start in the carry and finish in this chunk.
+        // compared in place against both halves, nothing is copied
+        for (size_t k = 0; k < carry.length(); ++k)
+        {
+            const size_t head = carry.length() - k; // bytes of the match that are in the carry
+            if (head + chunk.length() < m)
+                break; // too short for now. the carry keeps these bytes for the next chunk
+
+            const size_t match = carry_start + k;
+            if (carry[k] != m_pattern[0] || match < next_allowed)
+                continue;
+            if (std::memcmp(carry.data() + k, m_pattern.data(), head) != 0 || std::memcmp(chunk.data(), m_pattern.data() + head, m - head) != 0)
+                continue;
+
+            if (on_match(match))
+                return true;
+            next_allowed = match + m;
+        }
+
+        // matches entirely inside this chunk
+        size_t pos = next_allowed > chunk_start ? next_allowed - chunk_start : 0;
+        size_t hit;
+        while (pos < chunk.length() && (hit = find_in(chunk.data() + pos, chunk.length() - pos)) != npos)
+        {
+            const size_t match = chunk_start + pos + hit;
+            if (on_match(match))
+                return true;
+            next_allowed = match + m;
+            pos += hit + m;
+        }
+
+        // keep the last m - 1 bytes of everything seen so far
+        if (chunk.length() >= m - 1)
+        {
+            carry.assign(chunk.substr(chunk.length() - (m - 1)));
+        }
+        else
+        {
+            carry.append(chunk);
+            if (carry.length() > m - 1)
+                carry.erase(0, carry.length() - (m - 1));
+        }
+
+        chunk_start += chunk.length();
+        carry_start = chunk_start - carry.length();
+        return chunk_start >= end;
+    });
+}
+
+size_t searcher::find_next(const piece_table& pt, size_t from) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    size_t result = npos;
+    scan_forward(pt, from, pt.length(), [&result](size_t match) {
+        result = match;
+        return true;
+    });
+    return result;
+}
+
+void searcher::find_all(const piece_table& pt, size_t begin, size_t end, std::vector<size_t>& out) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    scan_forward(pt, begin, std::min(end, pt.length()), [&out](size_t match) {
+        out.push_back(match);
+        return false;
+    });
+}
+
+size_t searcher::count(const piece_table& pt, size_t begin, size_t end) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    size_t matches = 0;
+    scan_forward(pt, begin, std::min(end, pt.length()), [&matches](size_t) {
+        ++matches;
+        return false;
+    });
+    return matches;
+}
+
+void searcher::scan_partition(const piece_table& pt, size_t limit, partition& part, bool keep_matches) const
+{
+    part.count = 0;
+    part.first = npos;
+    part.last = npos;
+    part.matches.clear();
+
+    // a match that starts just before part.end runs up to m - 1 bytes past it
+    const size_t scan_end = std::min(limit, part.end + m_pattern.length() - 1);
+    scan_forward(pt, part.begin, scan_end, [&](size_t match) {
+        if (match >= part.end)
+            return true;
+
+        if (part.count++ == 0)
+            part.first = match;
+        part.last = match;
+        if (keep_matches)
+            part.matches.push_back(match);
+        return false;
+    });
+}
+
+void searcher::scan_parallel(const piece_table& pt, size_t begin, size_t end, thread_pool& pool, bool keep_matches,
+                             std::vector<partition>& parts) const
+{
+    end = std::min(end, pt.length());
+    if (m_pattern.empty() || begin >= end)
+        return;
+
+    const size_t task_count = std::clamp<size_t>((end - begin) / m_min_partition_length, 1, pool.concurrency() * 4);
+    const size_t step = (end - begin + task_count - 1) / task_count;
+
+    parts.resize(task_count);
+    for (size_t i = 0; i < task_count; ++i)
+    {
+        parts[i].begin = std::min(end, begin + i * step);
+        parts[i].end = std::min(end, parts[i].begin + step);
+    }
+
+    pool.run(task_count, [&](size_t i) { scan_partition(pt, end, parts[i], keep_matches); });
+
+    // every partition was scanned as if nothing came before it. when the last match of one
+    // partition overlaps the first match of the next, the next one is redone from where that match ends
+    size_t next_allowed = begin;
+    for (auto& part : parts)
+    {
+        if (part.count > 0 && part.first < next_allowed)
+        {
+            part.begin = std::min(next_allowed, part.end);
+            scan_partition(pt, end, part, keep_matches);
+        }
+
+        if (part.count > 0)
+            next_allowed = part.last + m_pattern.length();
+    }
+}
+
+void searcher::find_all(const piece_table& pt, size_t begin, size_t end, std::vector<size_t>& out, thread_pool& pool) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    std::vector<partition> parts;
+    scan_parallel(pt, begin, end, pool, true, parts);
+
+    for (const auto& part : parts)
+        out.insert(out.end(), part.matches.begin(), part.matches.end());
+}
+
+size_t searcher::count(const piece_table& pt, size_t begin, size_t end, thread_pool& pool) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    std::vector<partition> parts;
+    scan_parallel(pt, begin, end, pool, false, parts);
+
+    size_t matches = 0;
+    for (const auto& part : parts)
+        matches += part.count;
+    return matches;
+}
+
+size_t searcher::find_prev(const piece_table& pt, size_t before) const
+{
+    MINIEDITOR_LATENCY_SCOPE(latency_op::SEARCH);
+    const size_t m = m_pattern.length();
+    if (m == 0 || before == 0)
+        return npos;
+
+    // a match starting at before - 1 ends at before + m - 2
+    const size_t end = before >= pt.length() ? pt.length() : std::min(pt.length(), before + m - 1);
+
+    size_t result = npos;
+    std::string carry; // the first m - 1 bytes after the current chunk
+    size_t chunk_end = end;
+
+    pt.for_each_chunk_reverse(end, [&](std::string_view chunk) {
+        const size_t chunk_start = chunk_end - chunk.length();
+
+        // matches that start in this chunk and finish in the carry come after any match inside the chunk.
+        // the latest possible start is checked first
+        // a start `tail` bytes before the end needs m - tail bytes from the carry
+        for (size_t tail = std::max<size_t>(1, m - carry.length()); tail < m && tail <= chunk.length(); ++tail)
+        {
+            const size_t rest = m - tail;
+            const char* start = chunk.data() + chunk.length() - tail;
+            if (*start == m_pattern[0] && std::memcmp(start, m_pattern.data(), tail) == 0 &&
+                std::memcmp(carry.data(), m_pattern.data() + tail, rest) == 0)
+            {
+                result = chunk_end - tail;
+                return true;
+            }
+        }
+
+        const size_t hit = rfind_in(chunk.data(), chunk.length());
+        if (hit != npos)
+        {
+            result = chunk_start + hit;
+            return true;
+        }
+
+        // keep the first m - 1 bytes of everything seen so far
+        if (chunk.length() >= m - 1)
+        {
+            carry.assign(chunk.substr(0, m - 1));
+        }
+        else
+        {
+            carry.insert(0, chunk);
+            if (carry.length() > m - 1)
+                carry.resize(m - 1);
+        }
+
+        chunk_end = chunk_start;
+        return false;
+    });
+
+    return result;
+}
+
+} // namespace AL
@@ -0,0 +1,245 @@
+#include "snapshot.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#if MINIEDITOR_POSIX_IO
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace AL
+{
+
+namespace
+{
+
+constexpr char SNAPSHOT_MAGIC[8] = {'M', 'E', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr size_t FINGERPRINT_BLOCKS = 16;
+constexpr size_t FINGERPRINT_BLOCK_LENGTH = 4096;
+
+uint64_t fnv1a(const void* data, size_t length, uint64_t hash = 14695981039346656037ULL)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
+
+size_t align8(size_t n)
+{
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+// the snapshot, mapped where that is possible and read into memory everywhere else
+class snapshot_file
+{
+public:
+    explicit snapshot_file(const std::filesystem::path& path)
+    {
+#if MINIEDITOR_POSIX_IO
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0)
+            return;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED)
+            {
+                m_data = static_cast<const char*>(map);
+                m_size = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream ifs(path, std::ios::binary);
+        m_bytes.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        m_data = m_bytes.data();
+        m_size = m_bytes.size();
+#endif
+    }
+
+    ~snapshot_file()
+    {
+#if MINIEDITOR_POSIX_IO
+        if (m_data)
+            ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+    }
+
+    snapshot_file(const snapshot_file&) = delete;
+    snapshot_file& operator=(const snapshot_file&) = delete;
+
+    const char* data() const
+    {
+        return m_data;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+#if !MINIEDITOR_POSIX_IO
+    std::string m_bytes;
+#endif
+};
+
+// [offset, offset + length) is inside a file of size bytes
+bool fits(uint64_t offset, uint64_t length, size_t size)
+{
+    return offset <= size && length <= size - offset;
+}
+
+} // namespace
+
+uint64_t snapshot_fingerprint(std::string_view buffer)
+{
+    const uint64_t length = buffer.length();
+    uint64_t hash = fnv1a(&length, sizeof(length));
+    if (buffer.length() <= FINGERPRINT_BLOCKS * FINGERPRINT_BLOCK_LENGTH)
+        return fnv1a(buffer.data(), buffer.length(), hash);
+
+    for (size_t i = 0; i < FINGERPRINT_BLOCKS; ++i)
+    {
+        const size_t offset = (buffer.length() - FINGERPRINT_BLOCK_LENGTH) / (FINGERPRINT_BLOCKS - 1) * i;
+        hash = fnv1a(buffer.data() + offset, FINGERPRINT_BLOCK_LENGTH, hash);
+    }
+    return hash;
+}
+
+bool write_snapshot(const std::filesystem::path& path, const piece_table& document, uint64_t file_size, int64_t file_mtime_ns,
+                    bool embed_original, size_t cursor)
+{
+    std::vector<piece> pieces;
+    document.get_pieces(pieces);
+    std::vector<snapshot_piece> stored(pieces.size());
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        stored[i] = {.start = pieces[i].start,
+                     .length = pieces[i].length,
+                     .newline_count = pieces[i].newline_count,
+                     .buffer = static_cast<uint64_t>(pieces[i].buf_type)};
+    }
+
+    const std::string_view original = document.get_original_buffer();
+    const std::string& add = document.get_add_buffer();
+
+    snapshot_header header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.header_length = sizeof(snapshot_header);
+    header.piece_length = sizeof(snapshot_piece);
+    header.byte_order = snapshot_byte_order;
+    header.file_size = file_size;
+    header.file_mtime_ns = file_mtime_ns;
+    header.original_fingerprint = snapshot_fingerprint(original);
+    header.original_embedded = embed_original ? 1 : 0;
+    header.original_length = original.length();
+    header.piece_count = stored.size();
+    header.pieces_offset = align8(sizeof(snapshot_header));
+    header.add_offset = header.pieces_offset + stored.size() * sizeof(snapshot_piece);
+    header.add_length = add.length();
+    header.original_offset = embed_original ? align8(header.add_offset + add.length()) : 0;
+    header.document_length = document.length();
+    header.cursor = cursor;
+    header.line_ending = static_cast<uint64_t>(document.get_line_ending());
+    header.pieces_checksum = fnv1a(stored.data(), stored.size() * sizeof(snapshot_piece));
+
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream ofs(temp_path, std::ios::binary);
+        const char padding[8] = {};
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(padding, static_cast<std::streamsize>(header.pieces_offset - sizeof(header)));
+        ofs.write(reinterpret_cast<const char*>(stored.data()), static_cast<std::streamsize>(stored.size() * sizeof(snapshot_piece)));
+        ofs.write(add.data(), static_cast<std::streamsize>(add.length()));
+        if (embed_original)
+        {
+            ofs.write(padding, static_cast<std::streamsize>(header.original_offset - header.add_offset - add.length()));
+            ofs.write(original.data(), static_cast<std::streamsize>(original.length()));
+        }
+
+        ofs.close();
+        if (!ofs)
+        {
+            std::cerr << "ERROR: Writing the snapshot failed. Path: " << temp_path << '\n';
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec)
+    {
+        std::cerr << "ERROR: Saving the snapshot failed. Path: " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool read_snapshot(const std::filesystem::path& path, std::string& file_bytes, uint64_t file_size, int64_t file_mtime_ns, piece_table& document,
+                   snapshot_header& header)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+        return false;
+
+    const snapshot_file file(path);
+    if (!file.data() || file.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    // only the header, the piece array and the sampled blocks are checked, the text is never looked at
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.header_length != sizeof(snapshot_header) ||
+        header.piece_length != sizeof(snapshot_piece) || header.byte_order != snapshot_byte_order || header.file_size != file_size ||
+        header.file_mtime_ns != file_mtime_ns)
+        return false;
+    if (header.piece_count > file.size() / sizeof(snapshot_piece) ||
+        !fits(header.pieces_offset, header.piece_count * sizeof(snapshot_piece), file.size()) ||
+        !fits(header.add_offset, header.add_length, file.size()) ||
+        (header.original_embedded && !fits(header.original_offset, header.original_length, file.size())))
+        return false;
+
+    const char* stored = file.data() + header.pieces_offset;
+    if (fnv1a(stored, header.piece_count * sizeof(snapshot_piece)) != header.pieces_checksum)
+        return false;
+
+    std::string original;
+    if (header.original_embedded)
+        original.assign(file.data() + header.original_offset, header.original_length);
+    else if (file_bytes.length() != header.original_length || snapshot_fingerprint(file_bytes) != header.original_fingerprint)
+        return false;
+
+    std::vector<piece> pieces(header.piece_count);
+    uint64_t document_length = 0;
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        snapshot_piece p;
+        std::memcpy(&p, stored + i * sizeof(snapshot_piece), sizeof(p));
+        if (p.buffer > static_cast<uint64_t>(buffer_type::ADD))
+            return false;
+        pieces[i] = {.buf_type = static_cast<buffer_type>(p.buffer), .start = p.start, .length = p.length, .newline_count = p.newline_count};
+        document_length += p.length;
+    }
+    if (document_length != header.document_length || header.line_ending > static_cast<uint64_t>(line_ending::CRLF))
+        return false;
+
+    std::string add(file.data() + header.add_offset, header.add_length);
+    if (!document.restore(header.original_embedded ? std::move(original) : std::move(file_bytes), std::move(add), pieces,
+                          static_cast<line_ending>(header.line_ending)))
+        return false;
+    return true;
+}
+
+} // namespace AL
@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace AL
+{
+
+thread_pool::thread_pool(size_t worker_count)
+    : m_task(nullptr), m_count(0), m_next(0), m_completed(0), m_active(0), m_generation(0), m_stop(false)
+{
+    m_workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i)
+        m_workers.emplace_back(&thread_pool::worker_loop, this);
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void thread_pool::run(size_t count, const std::function<void(size_t)>& task)
+{
+    if (count == 0)
+        return;
+
+    std::lock_guard<std::mutex> run_lock(m_run_mutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_count = count;
+        m_next.store(0, std::memory_order_relaxed);
+        m_completed = 0;
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    // the caller helps instead of sleeping
+    work(task, count);
+
+    // wait for the stragglers, and for every worker to leave the job before the next one can reset it
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_completed == m_count && m_active == 0; });
+    m_task = nullptr;
+}
+
+void thread_pool::work(const std::function<void(size_t)>& task, size_t count)
+{
+    while (true)
+    {
+        const size_t i = m_next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= count)
+            return;
+
+        task(i);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (++m_completed == m_count)
+            m_done.notify_all();
+    }
+}
+
+void thread_pool::worker_loop()
+{
+    uint64_t seen_generation = 0;
+    while (true)
+    {
+        const std::function<void(size_t)>* task;
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen_generation; });
+            if (m_stop)
+                return;
+
+            seen_generation = m_generation;
+            if (!m_task)
+                continue; // woke up after the job was already finished
+
+            task = m_task;
+            count = m_count;
+            ++m_active;
+        }
+
+        work(*task, count);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_active == 0)
+            m_done.notify_all();
+    }
+}
+
+thread_pool& get_thread_pool()
+{
+    static thread_pool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+    return pool;
+}
+
+} // namespace AL
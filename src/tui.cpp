@@ -1,18 +1,22 @@
 #include "tui.h"
 #include "editor.h"
+#include "latency.h"
 #include <cstddef>
 #include <curses.h>
 #include <iomanip>
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 
 namespace AL
 {
 
 tui::tui()
     : m_window(nullptr), m_editor(editor()), m_quit(false), m_viewport_top_line(0), m_viewport_height(0), m_viewport_width(0), m_viewport_left_col(0),
-      m_show_status_message(false)
+      m_show_status_message(false), m_prompt(prompt_kind::NONE)
 {
 #if MINIEDITOR_DEBUG
     m_log.open("/tmp/minieditor.log", std::ios::app);
@@ -23,6 +27,24 @@ tui::~tui()
 {
     if (m_window)
         endwin();
+
+    // unsaved edits are kept in a session snapshot for the next open. a saved file needs no journal any more
+    if (!m_editor.get_filename().empty())
+    {
+        if (m_editor.is_dirty())
+            m_editor.save_session();
+        else
+            m_editor.stop_journal();
+    }
+
+#if MINIEDITOR_LATENCY_STATS
+    // dump after endwin so the report lands on the restored terminal. the registry is global, so it starts over for the next tui
+    if (!get_latency_registry().empty())
+    {
+        get_latency_registry().write_report(std::cerr);
+        get_latency_registry().reset();
+    }
+#endif
 }
 
 bool tui::init(const std::string& file_path)
@@ -45,8 +67,11 @@ bool tui::init(const std::string& file_path)
 
     if (!file_path.empty())
     {
-        m_editor.open(file_path);
+        m_editor.begin_open(file_path); // the rest of a big file comes in from tick
     }
+    m_editor.set_autosave(m_autosave_interval, m_autosave_budget);
+    if (m_editor.has_recovery())
+        open_prompt(prompt_kind::RECOVER);
 
     m_line_buffer.reserve(1024);
     update_values();
@@ -55,6 +80,18 @@ bool tui::init(const std::string& file_path)
     return true;
 }
 
+void tui::start_journal()
+{
+    // open() goes on with a journal it found. a dirty document is not on disk yet, so it waits for a save
+    if (m_journal_tried || m_editor.get_filename().empty() || m_editor.is_loading() || m_editor.is_saving() || m_editor.is_dirty() ||
+        m_editor.has_recovery() || m_prompt != prompt_kind::NONE)
+        return;
+
+    m_journal_tried = true;
+    if (!m_editor.is_journaling())
+        m_editor.start_journal();
+}
+
 void tui::update_values()
 {
     int max_x, max_y;
@@ -72,16 +109,34 @@ void tui::tick()
 {
     int ch = getch();
     if (ch == ERR)
+    {
+        // nothing typed, so this is when the rest of the file goes in and autosave looks for changes.
+        // a background save may have moved on too
+        const bool loading = m_editor.is_loading();
+        m_editor.poll_load();
+        m_editor.autosave_tick();
+        start_journal();
+        if (update_save_status() || loading)
+        {
+            render();
+            refresh();
+        }
         return;
+    }
+
+    MINIEDITOR_LATENCY_SCOPE(latency_op::TICK);
 
     handle_input(ch);
     update_values();
     render();
+
+    MINIEDITOR_LATENCY_SCOPE(latency_op::REFRESH);
     refresh();
 }
 
 void tui::render()
 {
+    MINIEDITOR_LATENCY_SCOPE(latency_op::RENDER);
     curs_set(0);
 
     werase(m_window);
@@ -137,6 +192,13 @@ void tui::render()
         move(screen_row, screen_col);
     }
 
+    // while a prompt is open the cursor belongs to the status bar
+    if (m_prompt != prompt_kind::NONE)
+    {
+        size_t prompt_col = std::string_view(get_prompt_label()).length() + m_prompt_input.length();
+        move(static_cast<int>(m_viewport_height - 1), static_cast<int>(std::min(prompt_col, m_viewport_width - 1)));
+    }
+
     wnoutrefresh(m_window);
     doupdate();
     curs_set(2);
@@ -145,14 +207,61 @@ void tui::render()
 void tui::render_status_bar(size_t status_bar_row)
 {
     std::ostringstream oss;
+    if (m_prompt != prompt_kind::NONE)
+    {
+        oss << get_prompt_label() << m_prompt_input;
+        mvaddnstr(static_cast<int>(status_bar_row), 0, oss.str().c_str(), static_cast<int>(m_viewport_width));
+        return;
+    }
+
     oss << m_editor.get_filename() << " [" << m_editor.get_cursor_row() << ":" << m_editor.get_cursor_col() << "]";
     if (m_editor.is_dirty())
         oss << " [modified]";
+    if (m_editor.get_cursor_count() > 1)
+        oss << " [" << m_editor.get_cursor_count() << " cursors]";
+    if (m_editor.is_loading())
+    {
+        const size_t length = std::max<size_t>(m_editor.get_load_length(), 1);
+        oss << " [loading " << m_editor.get_load_progress() * 100 / length << "%, " << m_editor.get_total_lines() << " lines]";
+    }
 
     if (m_show_status_message)
         oss << " " << m_status_message;
 
-    mvaddstr(static_cast<int>(status_bar_row), 0, oss.str().c_str());
+#if MINIEDITOR_LATENCY_STATS
+    if (m_show_latency_overlay)
+    {
+        oss << " | ";
+        get_latency_registry().write_summary(oss);
+    }
+#endif
+
+    mvaddnstr(static_cast<int>(status_bar_row), 0, oss.str().c_str(), static_cast<int>(m_viewport_width));
+}
+
+bool tui::update_save_status()
+{
+    switch (m_editor.poll_save())
+    {
+        case save_status::NONE:
+            return false;
+        case save_status::RUNNING:
+        {
+            const size_t length = std::max<size_t>(m_editor.get_save_length(), 1);
+            const std::string message = "Saving... " + std::to_string(m_editor.get_save_progress() * 100 / length) + "%";
+            if (m_show_status_message && m_status_message == message)
+                return false;
+            set_status_message(message);
+            return true;
+        }
+        case save_status::DONE:
+            set_status_message("File saved!");
+            return true;
+        case save_status::FAILED:
+            set_status_message("Save failed!");
+            return true;
+    }
+    return false;
 }
 
 void tui::clear_status_message()
@@ -167,6 +276,155 @@ void tui::set_status_message(const std::string& msg)
     m_show_status_message = true;
 }
 
+void tui::open_prompt(prompt_kind kind)
+{
+    clear_status_message();
+    m_prompt = kind;
+    m_prompt_input.clear();
+}
+
+const char* tui::get_prompt_label() const
+{
+    switch (m_prompt)
+    {
+        case prompt_kind::GOTO_LINE:
+            return "Go to line: ";
+        case prompt_kind::FIND:
+            return "Find: ";
+        case prompt_kind::REGEX:
+            return "Find regex: ";
+        case prompt_kind::RECOVER:
+            return "Recover unsaved changes from the autosave? (y/n) ";
+        case prompt_kind::NONE:
+            break;
+    }
+    return "";
+}
+
+void tui::handle_prompt_input(const int ch)
+{
+    switch (ch)
+    {
+        case 27: // Esc
+        case 7:  // Ctrl+G again
+            m_prompt = prompt_kind::NONE;
+            break;
+
+        case KEY_BACKSPACE:
+        case 127:
+        case 8:
+            if (!m_prompt_input.empty())
+                m_prompt_input.pop_back();
+            break;
+
+        case KEY_ENTER:
+        case '\n':
+        case '\r':
+            submit_prompt();
+            break;
+
+        default:
+            if (m_prompt == prompt_kind::GOTO_LINE && ch >= '0' && ch <= '9')
+                m_prompt_input.push_back(static_cast<char>(ch));
+            else if ((m_prompt == prompt_kind::FIND || m_prompt == prompt_kind::REGEX) && ch >= 32 && ch <= 126)
+                m_prompt_input.push_back(static_cast<char>(ch));
+            else if (m_prompt == prompt_kind::RECOVER && (ch == 'y' || ch == 'n'))
+            {
+                m_prompt_input = static_cast<char>(ch);
+                submit_prompt(); // one key answers it
+            }
+            break;
+    }
+}
+
+void tui::submit_prompt()
+{
+    const prompt_kind kind = m_prompt;
+    m_prompt = prompt_kind::NONE;
+
+    switch (kind)
+    {
+        case prompt_kind::GOTO_LINE:
+        {
+            size_t line = 0;
+            auto [ptr, ec] = std::from_chars(m_prompt_input.data(), m_prompt_input.data() + m_prompt_input.size(), line);
+            if (ec != std::errc() || line == 0)
+            {
+                set_status_message("Invalid line number!");
+                break;
+            }
+            m_editor.goto_line(line);
+
+            // show the target line in the middle of the screen instead of at the bottom edge
+            const size_t half_page = (m_viewport_height - 1) / 2;
+            m_viewport_top_line = m_editor.get_cursor_row() > half_page ? m_editor.get_cursor_row() - half_page : 1;
+            break;
+        }
+        case prompt_kind::FIND:
+            if (m_prompt_input.empty())
+                break;
+            m_last_search = m_prompt_input;
+            m_last_regex.reset();
+            repeat_search(true);
+            break;
+        case prompt_kind::REGEX:
+        {
+            if (m_prompt_input.empty())
+                break;
+            regex pattern(m_prompt_input);
+            if (!pattern.is_valid())
+            {
+                set_status_message("Bad regex: " + pattern.get_error());
+                break;
+            }
+            m_last_search = m_prompt_input;
+            m_last_regex = std::move(pattern);
+            repeat_search(true);
+            break;
+        }
+        case prompt_kind::RECOVER:
+            if (m_prompt_input == "y")
+                set_status_message(m_editor.recover() ? "Recovered from the autosave" : "Recovery failed!");
+            else if (m_prompt_input == "n")
+                m_editor.discard_recovery();
+            break;
+        case prompt_kind::NONE:
+            break;
+    }
+}
+
+void tui::repeat_search(bool forward)
+{
+    if (m_last_search.empty())
+    {
+        set_status_message("No previous search!");
+        return;
+    }
+
+    const size_t old_row = m_editor.get_cursor_row();
+    const size_t old_col = m_editor.get_cursor_col();
+    bool found;
+    if (m_last_regex)
+        found = forward ? m_editor.find_next(*m_last_regex) : m_editor.find_prev(*m_last_regex);
+    else
+        found = forward ? m_editor.find_next(m_last_search) : m_editor.find_prev(m_last_search);
+    if (!found)
+    {
+        set_status_message("Not found: " + m_last_search);
+        return;
+    }
+
+    // the search went past the end (or start) of the document and came back around
+    const size_t row = m_editor.get_cursor_row();
+    const size_t col = m_editor.get_cursor_col();
+    const bool moved_forward = row > old_row || (row == old_row && col > old_col);
+    const bool moved_backward = row < old_row || (row == old_row && col < old_col);
+    if (forward ? !moved_forward : !moved_backward)
+        set_status_message("Search wrapped");
+    else
+        clear_status_message();
+}
+
 void tui::render_line(size_t screen_row, size_t col_offset)
 {
     auto line_num = screen_row + m_viewport_top_line;
@@ -205,6 +463,22 @@ void tui::render_line(size_t screen_row, size_t col_offset)
             content += m_editor.get_insert_buffer();
         }
     }
+    // text typed at several cursors goes in at each of them on this line, back to front so the columns stay valid
+    else if (!m_editor.get_cursor_batch_text().empty())
+    {
+        m_editor.get_cursor_batch_columns(line_num, m_batch_columns);
+        for (auto it = m_batch_columns.rbegin(); it != m_batch_columns.rend(); ++it)
+            content.insert(std::min(*it - 1, content.length()), m_editor.get_cursor_batch_text());
+    }
+    // pending backspaces are still in the piece table, hide them
+    else if (line_num == m_editor.get_cursor_row() && m_editor.get_delete_buffer_length() > 0)
+    {
+        size_t erase_pos = m_editor.get_cursor_col() - 1;
+        if (erase_pos < content.length())
+        {
+            content.erase(erase_pos, m_editor.get_delete_buffer_length());
+        }
+    }
 
     // build the gutter (line number + separator)
     std::stringstream ss;
@@ -225,6 +499,8 @@ void tui::render_line(size_t screen_row, size_t col_offset)
 
 void tui::handle_input(const int ch)
 {
+    MINIEDITOR_LATENCY_SCOPE(latency_op::HANDLE_INPUT);
+
 #if MINIEDITOR_DEBUG
     if (m_log.is_open())
     {
@@ -233,6 +509,15 @@ void tui::handle_input(const int ch)
     }
 #endif
 
+    if (m_prompt != prompt_kind::NONE)
+    {
+        handle_prompt_input(ch);
+        return;
+    }
+
+    // PgUp/PgDn move by the number of text rows on screen
+    const size_t page_height = m_viewport_height > 1 ? m_viewport_height - 1 : 1;
+
     switch (ch)
     {
         case '[':
@@ -247,7 +532,17 @@ void tui::handle_input(const int ch)
             {
                 set_status_message("No file open!");
             }
-            else if (m_editor.save())
+            else if (!m_quit && m_editor.is_saving())
+            {
+                // the running save goes on, asking for another one is not a failure
+                set_status_message("Saving...");
+            }
+            else if (!m_quit && m_editor.save_async())
+            {
+                // written on a worker thread, update_save_status reports how far it got
+                set_status_message(m_editor.is_saving() ? "Saving..." : "File saved!");
+            }
+            else if (m_quit && m_editor.save())
             {
                 set_status_message("File saved!");
 #if MINIEDITOR_DEBUG
@@ -285,6 +580,68 @@ void tui::handle_input(const int ch)
             m_editor.move_cursor(direction::RIGHT);
             break;
 
+        case KEY_HOME:
+            clear_status_message();
+            m_editor.move_to_line_start();
+            break;
+
+        case KEY_END:
+            clear_status_message();
+            m_editor.move_to_line_end();
+            break;
+
+        case CTL_HOME:
+            clear_status_message();
+            m_editor.move_to_document_start();
+            break;
+
+        case CTL_END:
+            clear_status_message();
+            m_editor.move_to_document_end();
+            break;
+
+        case KEY_PPAGE:
+            clear_status_message();
+            m_editor.move_page_up(page_height);
+            // scroll with the cursor so it keeps its place on screen
+            m_viewport_top_line = m_viewport_top_line > page_height ? m_viewport_top_line - page_height : 1;
+            break;
+
+        case KEY_NPAGE:
+            clear_status_message();
+            m_editor.move_page_down(page_height);
+            m_viewport_top_line = std::min(m_viewport_top_line + page_height, m_editor.get_cursor_row());
+            break;
+
+        case 7: // Ctrl+G
+            open_prompt(prompt_kind::GOTO_LINE);
+            break;
+
+        case 6: // Ctrl+F
+            open_prompt(prompt_kind::FIND);
+            break;
+
+        case 18: // Ctrl+R
+            open_prompt(prompt_kind::REGEX);
+            break;
+
+        case 14: // Ctrl+N
+            repeat_search(true);
+            break;
+
+        case 16: // Ctrl+P
+            repeat_search(false);
+            break;
+
+        case 4: // Ctrl+D
+            clear_status_message();
+            m_editor.add_cursor_below();
+            break;
+
+        case 27: // Esc
+            m_editor.clear_extra_cursors();
+            break;
+
         case KEY_BACKSPACE:
         case 127:
         case 8:
@@ -296,6 +653,12 @@ void tui::handle_input(const int ch)
 #endif
             break;
 
+#if MINIEDITOR_LATENCY_STATS
+        case KEY_F(2):
+            m_show_latency_overlay = !m_show_latency_overlay;
+            break;
+#endif
+
         case '\n':
         case '\r':
             clear_status_message();
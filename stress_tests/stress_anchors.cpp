@@ -0,0 +1,119 @@
+#include "anchor_tree.h"
+#include "piecetable.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Random edits with many anchors: the anchor tree against shifting a plain vector of positions
+// usage: stress_anchors [anchors, default 100000]
+int main(int argc, char** argv)
+{
+    const size_t ANCHORS = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+    const int NUM_EDITS = 500'000;
+    const size_t DOC_SIZE = 10 * 1024 * 1024;
+
+    std::cout << "\n--- Anchor Stress Test ---" << std::endl;
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> op_dist(0, 1);
+    std::uniform_int_distribution<int> len_dist(1, 100);
+
+    // the edits up front, so both runs see the same ones
+    struct edit
+    {
+        bool insert;
+        size_t position;
+        size_t length;
+    };
+    std::vector<edit> edits;
+    size_t length = DOC_SIZE;
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        if (op_dist(rng) == 0)
+        {
+            edits.push_back({true, std::uniform_int_distribution<size_t>(0, length)(rng), static_cast<size_t>(len_dist(rng))});
+            length += edits.back().length;
+        }
+        else
+        {
+            const size_t pos = std::uniform_int_distribution<size_t>(0, length - 1)(rng);
+            edits.push_back({false, pos, std::uniform_int_distribution<size_t>(1, std::min<size_t>(100, length - pos))(rng)});
+            length -= edits.back().length;
+        }
+    }
+
+    AL::piece_table pt(std::string(DOC_SIZE, 'x'));
+    std::vector<AL::anchor_id> ids;
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < ANCHORS; ++i)
+    {
+        positions.push_back(std::uniform_int_distribution<size_t>(0, DOC_SIZE)(rng));
+        ids.push_back(pt.add_anchor(positions.back()));
+    }
+
+    const std::string text(100, 'y');
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const edit& e : edits)
+    {
+        if (e.insert)
+            pt.insert(e.position, std::string_view(text).substr(0, e.length));
+        else
+            pt.remove(e.position, e.length);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double tree_secs = std::chrono::duration<double>(end - start).count();
+
+    // the same edits on the piece table alone, to take its share out
+    AL::piece_table plain(std::string(DOC_SIZE, 'x'));
+    start = std::chrono::high_resolution_clock::now();
+    for (const edit& e : edits)
+    {
+        if (e.insert)
+            plain.insert(e.position, std::string_view(text).substr(0, e.length));
+        else
+            plain.remove(e.position, e.length);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double plain_secs = std::chrono::duration<double>(end - start).count();
+
+    // shifting every position is O(k) per edit, so only a sample is timed
+    const size_t sample = 5'000;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < edits.size(); ++i)
+    {
+        const edit& e = edits[i];
+        for (auto& p : positions)
+        {
+            if (e.insert)
+                p += p > e.position ? e.length : 0;
+            else
+                p = p >= e.position + e.length ? p - e.length : (p > e.position ? e.position : p);
+        }
+
+        if (i + 1 == sample)
+        {
+            end = std::chrono::high_resolution_clock::now();
+            const double per_edit = std::chrono::duration<double>(end - start).count() / static_cast<double>(sample);
+            std::cout << "Vector shift:     " << per_edit * 1e6 << " us per edit (timed over " << sample << ")" << std::endl;
+        }
+    }
+
+    std::cout << "Anchors:          " << ANCHORS << ", edits: " << NUM_EDITS << std::endl;
+    std::cout << "Piece table only: " << plain_secs * 1000.0 << " ms" << std::endl;
+    std::cout << "With anchors:     " << tree_secs * 1000.0 << " ms (" << (tree_secs - plain_secs) / NUM_EDITS * 1e6 << " us per edit for the anchors)"
+              << std::endl;
+
+    for (size_t i = 0; i < ANCHORS; ++i)
+    {
+        if (pt.get_anchor_index(ids[i]) != positions[i])
+        {
+            std::cerr << "ERROR: anchor " << i << " is at " << pt.get_anchor_index(ids[i]) << ", expected " << positions[i] << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "editor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Typing into a large edited document while autosave copies it in the background, against typing with autosave off.
+// a key every 2 ms (insert_char, timed on its own) and an idle tick after each one, like the TUI's loop.
+// the copies go out at the autosave budget the TUI uses
+// usage: stress_autosave [size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const int NUM_INSERTS = 100'000;
+    const int NUM_KEYS = 2'000;
+    const size_t BUDGET = 8 * 1024 * 1024;
+    const auto path = std::filesystem::temp_directory_path() / "stress_autosave.txt";
+    auto autosave_path = path;
+    autosave_path += ".autosave";
+
+    std::cout << "\n--- Autosave Stress Test ---" << std::endl;
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        const std::string line = "the quick brown fox jumps over the lazy dog 0123456789\n";
+        for (size_t written = 0; written < SIZE_MB * 1024 * 1024; written += line.size())
+            ofs << line;
+    }
+
+    AL::editor ed;
+    if (!ed.open(path))
+        return 1;
+
+    uint64_t x = 88172645463325252ULL;
+    const auto next = [&]() {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    };
+    const size_t length = std::filesystem::file_size(path);
+    for (int i = 0; i < NUM_INSERTS; ++i)
+    {
+        ed.set_cursor_to_index(next() % length);
+        ed.insert_text("edit");
+    }
+    std::cout << "File:             " << SIZE_MB << " MB, " << NUM_INSERTS << " inserts, budget " << BUDGET / (1024 * 1024) << " MB/s" << std::endl;
+
+    const auto type = [&](const char* label) {
+        std::vector<double> key_us;
+        double worst_tick_ms = 0.0;
+        for (int i = 0; i < NUM_KEYS; ++i)
+        {
+            if (i % 64 == 0)
+                ed.set_cursor_to_index(next() % length);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            ed.insert_char('k');
+            auto end = std::chrono::high_resolution_clock::now();
+            key_us.push_back(std::chrono::duration<double>(end - start).count() * 1e6);
+
+            start = std::chrono::high_resolution_clock::now();
+            ed.autosave_tick();
+            end = std::chrono::high_resolution_clock::now();
+            worst_tick_ms = std::max(worst_tick_ms, std::chrono::duration<double>(end - start).count() * 1000.0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        std::sort(key_us.begin(), key_us.end());
+        std::cout << label << "insert_char p50 " << key_us[key_us.size() / 2] << " us, p99 " << key_us[key_us.size() * 99 / 100]
+                  << " us, max " << key_us.back() << " us; worst idle tick " << worst_tick_ms << " ms" << std::endl;
+    };
+
+    type("Autosave off:     ");
+    ed.set_autosave(std::chrono::milliseconds(1), BUDGET);
+    type("Autosave on:      ");
+    const bool copying = ed.is_autosaving();
+
+    const bool ok = std::filesystem::exists(autosave_path.string() + ".tmp") || std::filesystem::exists(autosave_path);
+    ed.set_autosave(std::chrono::milliseconds(0), 0);
+    std::filesystem::remove(path);
+    std::filesystem::remove(autosave_path);
+    std::filesystem::remove(autosave_path.string() + ".tmp");
+    if (!copying || !ok)
+    {
+        std::cerr << "ERROR: autosave did not run" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "editor.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Holding backspace at the end of a long document, and deleting a large selection in one call
+int main()
+{
+    const int NUM_LINES = 200'000;
+    const int NUM_BACKSPACES = 500'000;
+
+    std::cout << "\n--- Backspace Stress Test ---" << std::endl;
+
+    // one paste per line, which leaves the cursor at the end of the document
+    AL::editor ed;
+    for (int i = 0; i < NUM_LINES; ++i)
+        ed.insert_text("This is line number " + std::to_string(i + 1) + "\n");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < NUM_BACKSPACES; ++i)
+        ed.delete_char();
+    ed.move_cursor(AL::direction::LEFT); // flush the last batch
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> held = end - start;
+
+    std::cout << "\n[Held Backspace]" << std::endl;
+    std::cout << "Backspaces:       " << NUM_BACKSPACES << std::endl;
+    std::cout << "Time Elapsed:     " << held.count() << " s" << std::endl;
+    std::cout << "Avg per key:      " << (held.count() * 1e6 / NUM_BACKSPACES) << " us" << std::endl;
+    std::cout << "Cursor:           " << ed.get_cursor_row() << ":" << ed.get_cursor_col() << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    ed.delete_range(0, 2'000'000);
+    end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "\n[delete_range 2 MB selection]" << std::endl;
+    std::cout << "Time Elapsed:     " << std::chrono::duration<double, std::micro>(end - start).count() << " us" << std::endl;
+    std::cout << "Cursor:           " << ed.get_cursor_row() << ":" << ed.get_cursor_col() << std::endl;
+    std::cout << "Lines left:       " << ed.get_total_lines() << std::endl;
+
+    return 0;
+}
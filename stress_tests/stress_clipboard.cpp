@@ -0,0 +1,121 @@
+#include "piecetable.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Duplicates a large region of a fragmented document: the piece clipboard against copying the text
+// usage: stress_clipboard [region size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t DOC_SIZE = SIZE_MB * 1024 * 1024;
+    const int NUM_EDITS = 500'000;
+
+    std::cout << "\n--- Clipboard Stress Test ---" << std::endl;
+    std::cout << "Generating " << SIZE_MB << " MB of text..." << std::endl;
+
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    std::string text;
+    text.reserve(DOC_SIZE + 16);
+    uint64_t x = 88172645463325252ULL;
+    while (text.length() < DOC_SIZE)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+    }
+    text.resize(DOC_SIZE);
+
+    AL::piece_table pt(std::move(text));
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> op_dist(0, 1);
+    std::uniform_int_distribution<int> char_dist('a', 'z');
+    std::uniform_int_distribution<int> len_dist(1, 100);
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        const size_t current_len = pt.length();
+        if (op_dist(rng) == 0)
+        {
+            std::string s(len_dist(rng), ' ');
+            for (auto& c : s)
+                c = static_cast<char>(char_dist(rng));
+            pt.insert(std::uniform_int_distribution<size_t>(0, current_len)(rng), s);
+        }
+        else
+        {
+            const size_t pos = std::uniform_int_distribution<size_t>(0, current_len - 1)(rng);
+            pt.remove(pos, std::uniform_int_distribution<size_t>(1, std::min<size_t>(100, current_len - pos))(rng));
+        }
+    }
+
+    const size_t region = pt.length();
+    const size_t lines = pt.get_line_count();
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    std::cout << "Region:           " << region / 1024.0 / 1024.0 << " MB, " << pieces.size() << " pieces" << std::endl;
+
+    // duplicate the whole document at its end with the piece clipboard
+    auto start = std::chrono::high_resolution_clock::now();
+    const AL::piece_range range = pt.copy_range(0, region);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double copy_secs = std::chrono::duration<double>(end - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    pt.paste_range(region, range);
+    end = std::chrono::high_resolution_clock::now();
+    const double paste_secs = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "copy_range:       " << copy_secs * 1000.0 << " ms (" << range.pieces.size() << " pieces)" << std::endl;
+    std::cout << "paste_range:      " << paste_secs * 1000.0 << " ms" << std::endl;
+
+    if (pt.length() != 2 * region || pt.get_newline_count_before(pt.length()) != 2 * pt.get_newline_count_before(region))
+    {
+        std::cerr << "ERROR: duplicate has the wrong size, " << pt.length() << " bytes and " << pt.get_line_count() << " lines (" << lines
+                  << " before)" << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < 10'000; ++i)
+    {
+        const size_t at = std::uniform_int_distribution<size_t>(0, region - 1)(rng);
+        if (pt.get_char_at(at) != pt.get_char_at(region + at))
+        {
+            std::cerr << "ERROR: byte " << at << " differs in the duplicate" << std::endl;
+            return 1;
+        }
+    }
+
+    // moving the first half of the region behind the rest is a cut and a paste of pieces
+    start = std::chrono::high_resolution_clock::now();
+    pt.move_range(0, region / 2, pt.length());
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "move_range:       " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms (" << region / 2 / 1024.0 / 1024.0
+              << " MB)" << std::endl;
+
+    // for reference: the same duplicate through a string, the way insert would have to do it
+    start = std::chrono::high_resolution_clock::now();
+    std::string flat;
+    flat.reserve(region);
+    pt.for_each_chunk(0, [&](std::string_view chunk) {
+        flat.append(chunk.substr(0, region - flat.length()));
+        return flat.length() == region;
+    });
+    end = std::chrono::high_resolution_clock::now();
+    const double materialize_secs = std::chrono::duration<double>(end - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    pt.insert(pt.length(), flat);
+    end = std::chrono::high_resolution_clock::now();
+    const double insert_secs = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "Copy to a string: " << materialize_secs * 1000.0 << " ms" << std::endl;
+    std::cout << "insert:           " << insert_secs * 1000.0 << " ms (" << region / 1024.0 / 1024.0 << " MB appended to the add buffer)"
+              << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "journal.h"
+#include "piecetable.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Journaling edits to a large document: the cost of a record under each sync policy, the size of the journal,
+// and replaying it on open, against saving the whole document
+// usage: stress_journal [size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t DOC_SIZE = SIZE_MB * 1024 * 1024;
+    const int NUM_EDITS = 100'000;
+    const int NUM_SYNCED_EDITS = 1'000;
+    const auto path = std::filesystem::temp_directory_path() / "stress_journal.journal";
+    const auto save_path = std::filesystem::temp_directory_path() / "stress_journal.txt";
+
+    std::cout << "\n--- Journal Stress Test ---" << std::endl;
+
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    std::string text;
+    text.reserve(DOC_SIZE + 16);
+    uint64_t x = 88172645463325252ULL;
+    while (text.length() < DOC_SIZE)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+    }
+    text.resize(DOC_SIZE);
+    const std::string original = text;
+    AL::piece_table pt(std::move(text));
+
+    // typing bursts and backspaces, the way the editor flushes them
+    auto run = [&](const char* name, AL::journal_sync sync, int edits) {
+        AL::journal log;
+        log.create(path, original.size(), 0, sync);
+        std::mt19937 rng(42);
+        double journal_secs = 0;
+        for (int i = 0; i < edits; ++i)
+        {
+            const size_t position = rng() % pt.length();
+            std::string burst(1 + rng() % 40, static_cast<char>('a' + i % 26));
+            const bool insert = rng() % 3 != 0;
+            const size_t removed = std::min<size_t>(burst.size(), pt.length() - position);
+            if (insert)
+                pt.insert(position, burst);
+            else
+                pt.remove(position, removed);
+
+            const auto start = std::chrono::high_resolution_clock::now();
+            if (insert)
+                log.record_insert(position, burst);
+            else
+                log.record_remove(position, removed);
+            journal_secs += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        log.close();
+        std::cout << name << journal_secs * 1e6 / edits << " us per record (" << edits << " records, "
+                  << std::filesystem::file_size(path) / 1024.0 << " KB journal)" << std::endl;
+    };
+
+    run("Sync never:       ", AL::journal_sync::NONE, NUM_EDITS);
+    run("Sync interval:    ", AL::journal_sync::INTERVAL, NUM_EDITS);
+    pt = AL::piece_table(original);
+    run("Sync always:      ", AL::journal_sync::ALWAYS, NUM_SYNCED_EDITS);
+
+    // the open after a crash: the original is read anyway, then the journal goes on top
+    pt = AL::piece_table(original);
+    run("Journal to replay: ", AL::journal_sync::NONE, NUM_EDITS);
+    AL::piece_table replayed(original);
+    auto start = std::chrono::high_resolution_clock::now();
+    AL::journal log;
+    const int64_t records = log.resume(path, original.size(), 0, replayed, AL::journal_sync::NONE);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Replay:           " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms (" << records << " records)"
+              << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    {
+        std::ofstream ofs(save_path, std::ios::binary);
+        replayed.write_to(ofs);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Full save:        " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms (ofstream)" << std::endl;
+
+    const bool same = replayed.length() == pt.length() && replayed.get_line(1000) == pt.get_line(1000);
+    log.discard();
+    std::filesystem::remove(save_path);
+    if (!same)
+    {
+        std::cerr << "ERROR: the replayed document differs" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "piecetable.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loading text into a piece table (newlines counted, pieces built) on pools of different sizes.
+// LF text, CRLF text (kept as it is) and LF text with a '\r' on every other line (stripped).
+// the copy handed to the constructor is made outside the timing
+// usage: stress_load_parallel [size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "\n--- Parallel Load Stress Test ---" << std::endl;
+    std::cout << "Text:             " << SIZE_MB << " MB, " << hardware << " hardware threads" << std::endl;
+
+    struct text_kind
+    {
+        const char* name;
+        const char* first_ending;
+        const char* second_ending;
+    };
+    for (const text_kind kind : {text_kind{"LF   ", "\n", "\n"}, text_kind{"CRLF ", "\r\n", "\r\n"}, text_kind{"mixed", "\n", "\r\n"}})
+    {
+        std::string text;
+        text.reserve(SIZE_MB * 1024 * 1024 + 128);
+        const std::string line = "the quick brown fox jumps over the lazy dog 0123456789";
+        const std::string two_lines = line + kind.first_ending + line + kind.second_ending;
+        while (text.length() < SIZE_MB * 1024 * 1024)
+            text += two_lines;
+
+        std::vector<size_t> worker_counts = {0};
+        for (size_t workers = 1; workers < hardware; workers *= 2)
+            worker_counts.push_back(workers);
+        if (hardware > 1 && worker_counts.back() != hardware - 1)
+            worker_counts.push_back(hardware - 1);
+
+        size_t lines = 0;
+        for (const size_t workers : worker_counts)
+        {
+            AL::thread_pool pool(workers);
+            std::string copy = text;
+            const auto start = std::chrono::high_resolution_clock::now();
+            AL::piece_table pt(std::move(copy), pool);
+            const auto end = std::chrono::high_resolution_clock::now();
+            std::cout << kind.name << ", " << workers + 1 << " threads:  "
+                      << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms" << std::endl;
+
+            if (lines != 0 && pt.get_line_count() != lines)
+            {
+                std::cerr << "ERROR: line counts differ between pool sizes" << std::endl;
+                return 1;
+            }
+            lines = pt.get_line_count();
+        }
+    }
+    return 0;
+}
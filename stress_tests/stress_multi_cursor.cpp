@@ -0,0 +1,83 @@
+#include "editor.h"
+#include "piecetable.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Typing with many cursors: the batched path (one apply_edits per flush) against one piece table insert per cursor
+// usage: stress_multi_cursor [cursors, default 10000]
+int main(int argc, char** argv)
+{
+    const size_t CURSORS = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000;
+    const size_t LINES = 1'000'000;
+    const std::string TYPED = "int value = 0; // typed at every cursor\n";
+
+    std::cout << "\n--- Multi Cursor Stress Test ---" << std::endl;
+
+    std::string text;
+    for (size_t i = 0; i < LINES; ++i)
+        text += "line " + std::to_string(i) + " of the generated file\n";
+    std::cout << "Document:         " << text.length() / 1024.0 / 1024.0 << " MB, " << LINES << " lines, " << CURSORS << " cursors" << std::endl;
+
+    // a cursor at the start of every (LINES / CURSORS)th line
+    std::vector<size_t> starts;
+    for (size_t i = 0, line = 0; i < text.length() && starts.size() < CURSORS; ++line)
+    {
+        if (line % (LINES / CURSORS) == 0)
+            starts.push_back(i);
+        i = text.find('\n', i) + 1;
+    }
+
+    auto run = [&](const char* name, bool flush_every_key) {
+        AL::editor ed;
+        ed.insert_text(text);
+        ed.set_cursor_to_index(starts.back());
+        for (size_t i = 0; i + 1 < starts.size(); ++i)
+            ed.add_cursor(starts[i]);
+
+        // the line is typed, then the newline at the end flushes it
+        auto start = std::chrono::high_resolution_clock::now();
+        for (char c : std::string_view(TYPED).substr(0, TYPED.length() - 1))
+        {
+            ed.insert_char(c);
+            if (flush_every_key)
+                ed.flush_cursor_batch();
+        }
+        auto typed = std::chrono::high_resolution_clock::now();
+        ed.insert_char('\n');
+        ed.delete_char(); // joins the lines again
+        auto end = std::chrono::high_resolution_clock::now();
+
+        const double typing_ms = std::chrono::duration<double>(typed - start).count() * 1000.0;
+        const double flush_ms = std::chrono::duration<double>(end - typed).count() * 1000.0;
+        std::cout << name << typing_ms / static_cast<double>(TYPED.length() - 1) << " ms per key, newline and backspace " << flush_ms
+                  << " ms" << std::endl;
+        return ed.get_line(1);
+    };
+
+    const std::string batched = run("batched, flushed at the end:  ", false);
+    const std::string per_key = run("batched, flushed every key:   ", true);
+
+    // baseline: the same keys as one insert per cursor, back to front so earlier positions stay valid
+    AL::piece_table pt(text);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t k = 0; k < TYPED.length(); ++k)
+    {
+        for (size_t i = starts.size(); i-- > 0;)
+            pt.insert(starts[i] + (i + 1) * k, std::string_view(&TYPED[k], 1));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double ms = std::chrono::duration<double>(end - start).count() * 1000.0;
+    std::cout << "insert per cursor:             " << ms << " ms, " << ms / static_cast<double>(TYPED.length()) << " ms per key" << std::endl;
+
+    if (batched != per_key || batched != TYPED.substr(0, TYPED.length() - 1) + "line 0 of the generated file")
+    {
+        std::cerr << "ERROR: unexpected first line: " << batched << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
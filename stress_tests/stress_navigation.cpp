@@ -0,0 +1,83 @@
+#include "editor.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Jumping around a 5M line file that was loaded from disk
+int main()
+{
+    const int NUM_LINES = 5'000'000;
+    const int NUM_JUMPS = 100'000;
+
+    std::cout << "\n--- Navigation Stress Test ---" << std::endl;
+
+    auto path = std::filesystem::temp_directory_path() / "minieditor_stress_navigation.txt";
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        for (int i = 0; i < NUM_LINES; ++i)
+            ofs << "This is line number " << (i + 1) << "\n";
+    }
+
+    AL::editor ed;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!ed.open(path))
+        return 1;
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Open:             " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    ed.goto_line(NUM_LINES);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "goto_line(last):  " << std::chrono::duration<double, std::micro>(end - start).count() << " us" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    ed.move_to_document_end();
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Document end:     " << std::chrono::duration<double, std::micro>(end - start).count() << " us" << std::endl;
+
+    // random jumps, each followed by End and Home
+    uint64_t x = 88172645463325252ULL;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < NUM_JUMPS; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        ed.goto_line(1 + x % NUM_LINES);
+        ed.move_to_line_end();
+        ed.move_to_line_start();
+    }
+    end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> jumps = end - start;
+    std::cout << "Random jumps:     " << NUM_JUMPS << " (goto + End + Home)" << std::endl;
+    std::cout << "Avg per jump:     " << (jumps.count() * 1e6 / NUM_JUMPS) << " us" << std::endl;
+
+    // byte offsets back to line and column, like jumping to a search hit
+    const size_t file_size = std::filesystem::file_size(path);
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < NUM_JUMPS; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        ed.set_cursor_to_index(x % file_size);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Index jumps:      " << NUM_JUMPS << ", avg " << (std::chrono::duration<double>(end - start).count() * 1e6 / NUM_JUMPS) << " us"
+              << std::endl;
+
+    ed.move_to_document_start();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < NUM_JUMPS; ++i)
+        ed.move_page_down(50);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Page downs:       " << NUM_JUMPS << ", avg " << (std::chrono::duration<double>(end - start).count() * 1e6 / NUM_JUMPS) << " us"
+              << std::endl;
+    std::cout << "Cursor:           " << ed.get_cursor_row() << ":" << ed.get_cursor_col() << std::endl;
+
+    std::filesystem::remove(path);
+    return 0;
+}
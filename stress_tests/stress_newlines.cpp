@@ -97,6 +97,25 @@ int main()
     std::cout << "Lookup time: " << index_time.count() << " s" << std::endl;
     std::cout << "Avg per lookup: " << (index_time.count() * 1e6 / NUM_INDEX_TESTS) << " us" << std::endl;
 
+    // Test get_line_length, which the editor calls on nearly every cursor move
+    std::cout << "\nTesting get_line_length..." << std::endl;
+    const int NUM_LENGTH_TESTS = 100000;
+    size_t length_sum = 0;
+    auto start_length = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < NUM_LENGTH_TESTS; ++i)
+    {
+        length_sum += pt.get_line_length(line_dist(rng));
+    }
+
+    auto end_length = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> length_time = end_length - start_length;
+
+    std::cout << "\n[Line Length Statistics]" << std::endl;
+    std::cout << "Total lookups: " << NUM_LENGTH_TESTS << " (sum " << length_sum << ")" << std::endl;
+    std::cout << "Lookup time: " << length_time.count() << " s" << std::endl;
+    std::cout << "Avg per lookup: " << (length_time.count() * 1e6 / NUM_LENGTH_TESTS) << " us" << std::endl;
+
     // Now stress test by inserting newlines in the middle
     std::cout << "\nInserting newlines in the middle..." << std::endl;
     const int NUM_NEWLINE_INSERTS = 1000;
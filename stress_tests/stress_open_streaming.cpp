@@ -0,0 +1,82 @@
+#include "editor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Opening a large file: the first screen of a streaming open against waiting for the whole file.
+// while the rest streams in, a key is typed at the top every 2 ms and timed, each followed by an idle tick (poll_load) like the TUI's loop
+// usage: stress_open_streaming [size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const auto path = std::filesystem::temp_directory_path() / "stress_open_streaming.txt";
+
+    std::cout << "\n--- Streaming Open Stress Test ---" << std::endl;
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        const std::string line = "the quick brown fox jumps over the lazy dog 0123456789\n";
+        for (size_t written = 0; written < SIZE_MB * 1024 * 1024; written += line.size())
+            ofs << line;
+    }
+    std::cout << "File:             " << SIZE_MB << " MB" << std::endl;
+
+    size_t total_lines = 0;
+    {
+        AL::editor ed;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!ed.open(path))
+            return 1;
+        auto end = std::chrono::high_resolution_clock::now();
+        total_lines = ed.get_total_lines();
+        std::cout << "open (whole file):        " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms" << std::endl;
+    }
+
+    AL::editor ed;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!ed.begin_open(path))
+        return 1;
+    std::string first_screen;
+    for (size_t line = 1; line <= 50; ++line)
+        first_screen += ed.get_line(line);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "begin_open (first screen): " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms, "
+              << ed.get_load_progress() / 1024 / 1024 << " MB in" << std::endl;
+
+    double worst_key_us = 0.0;
+    double worst_tick_ms = 0.0;
+    size_t keys = 0;
+    ed.set_cursor_to_index(0);
+    while (true)
+    {
+        auto step_start = std::chrono::high_resolution_clock::now();
+        ed.insert_char('k');
+        auto step_end = std::chrono::high_resolution_clock::now();
+        worst_key_us = std::max(worst_key_us, std::chrono::duration<double>(step_end - step_start).count() * 1e6);
+        ++keys;
+
+        step_start = std::chrono::high_resolution_clock::now();
+        const bool loading = ed.poll_load();
+        step_end = std::chrono::high_resolution_clock::now();
+        worst_tick_ms = std::max(worst_tick_ms, std::chrono::duration<double>(step_end - step_start).count() * 1000.0);
+        if (!loading)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "begin_open (whole file):   " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms, " << keys
+              << " keys meanwhile, worst insert_char " << worst_key_us << " us, worst poll_load " << worst_tick_ms << " ms" << std::endl;
+
+    const bool ok = !ed.is_loading() && ed.get_total_lines() == total_lines && !first_screen.empty();
+    std::filesystem::remove(path);
+    if (!ok)
+    {
+        std::cerr << "ERROR: streaming open lost lines" << std::endl;
+        return 1;
+    }
+    return 0;
+}
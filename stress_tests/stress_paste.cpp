@@ -0,0 +1,52 @@
+#include "editor.h"
+#include "alias.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+// Compares pasting a 10 MB block through insert_char against a single insert_text
+int main()
+{
+    const size_t PASTE_SIZE = 10 * ONE_MB;
+    const auto path = std::filesystem::temp_directory_path() / "minieditor_stress_paste.txt";
+
+    std::string block;
+    block.reserve(PASTE_SIZE);
+    while (block.size() < PASTE_SIZE)
+        block += "The quick brown fox jumps over the lazy dog " + std::to_string(block.size()) + "\n";
+    block.resize(PASTE_SIZE);
+
+    std::cout << "\n--- Paste Stress Test ---" << std::endl;
+    std::cout << "Block size: " << PASTE_SIZE / ONE_MB << " MB" << std::endl;
+
+    {
+        AL::editor ed;
+        ed.open(path);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (char c : block)
+            ed.insert_char(c);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "\n[insert_char loop]" << std::endl;
+        std::cout << "Time:   " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+        std::cout << "Cursor: " << ed.get_cursor_row() << ":" << ed.get_cursor_col() << std::endl;
+    }
+
+    {
+        AL::editor ed;
+        ed.open(path);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        ed.insert_text(block);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << "\n[insert_text]" << std::endl;
+        std::cout << "Time:   " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+        std::cout << "Cursor: " << ed.get_cursor_row() << ":" << ed.get_cursor_col() << std::endl;
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "piecetable.h"
+#include "regex.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+// Regex search over a large document fragmented by random edits (same edit mix as stress_random_edits)
+// usage: stress_regex [size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t DOC_SIZE = SIZE_MB * 1024 * 1024;
+    const int NUM_EDITS = 500'000;
+    const size_t REFERENCE_SIZE = 16 * 1024 * 1024;
+
+    std::cout << "\n--- Regex Stress Test ---" << std::endl;
+    std::cout << "Generating " << SIZE_MB << " MB of text..." << std::endl;
+
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    std::string text;
+    text.reserve(DOC_SIZE + 16);
+    uint64_t x = 88172645463325252ULL;
+    while (text.length() < DOC_SIZE)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+    }
+    text.resize(DOC_SIZE);
+
+    AL::piece_table pt(std::move(text));
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> op_dist(0, 1);
+    std::uniform_int_distribution<int> char_dist('a', 'z');
+    std::uniform_int_distribution<int> len_dist(1, 100);
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        const size_t current_len = pt.length();
+        if (op_dist(rng) == 0)
+        {
+            std::string s(len_dist(rng), ' ');
+            for (auto& c : s)
+                c = static_cast<char>(char_dist(rng));
+            pt.insert(std::uniform_int_distribution<size_t>(0, current_len)(rng), s);
+        }
+        else
+        {
+            const size_t pos = std::uniform_int_distribution<size_t>(0, current_len - 1)(rng);
+            pt.remove(pos, std::uniform_int_distribution<size_t>(1, std::min<size_t>(100, current_len - pos))(rng));
+        }
+    }
+
+    const double doc_gb = pt.length() / 1024.0 / 1024.0 / 1024.0;
+    std::cout << "Document:         " << doc_gb * 1024.0 << " MB" << std::endl;
+
+    // literal prefixes skip ahead with the searcher, the rest step the DFA over every byte
+    const char* patterns[] = {"lazy_needle\\d+", "treap editor", "[0-9]+ms", "^the \\w+ fox", "(quick|lazy) (brown|dog)\\s"};
+    for (const char* pattern : patterns)
+    {
+        const AL::regex re(pattern);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        const size_t matches = re.count(pt, 0, pt.length());
+        auto end = std::chrono::high_resolution_clock::now();
+        const double secs = std::chrono::duration<double>(end - start).count();
+
+        std::cout << pattern << std::string(30 - std::min<size_t>(29, std::string(pattern).length()), ' ') << secs * 1000.0 << " ms ("
+                  << doc_gb / secs << " GB/s), " << matches << " matches" << std::endl;
+    }
+
+    // for reference: std::regex over a flat copy of the first few MB
+    const std::string flat = pt.to_string().substr(0, REFERENCE_SIZE);
+    const std::regex reference("(quick|lazy) (brown|dog)\\s");
+    auto start = std::chrono::high_resolution_clock::now();
+    const auto reference_matches = std::distance(std::sregex_iterator(flat.begin(), flat.end(), reference), std::sregex_iterator());
+    auto end = std::chrono::high_resolution_clock::now();
+    const double secs = std::chrono::duration<double>(end - start).count();
+    std::cout << "std::regex, first " << REFERENCE_SIZE / (1024 * 1024) << " MB flat: " << secs * 1000.0 << " ms ("
+              << (REFERENCE_SIZE / 1024.0 / 1024.0 / 1024.0) / secs << " GB/s), " << reference_matches << " matches" << std::endl;
+
+    return 0;
+}
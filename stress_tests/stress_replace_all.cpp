@@ -0,0 +1,120 @@
+#include "piecetable.h"
+#include "search.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Replace all over a large fragmented document: one rebuild of the piece list against one remove + insert per match
+// usage: stress_replace_all [size in MB, default 1024] [replacements, default 1000000]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t REPLACEMENTS = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1'000'000;
+    const size_t DOC_SIZE = SIZE_MB * 1024 * 1024;
+    const int NUM_EDITS = 500'000;
+    const size_t ONE_BY_ONE = 20'000; // timed on a sample and scaled up, all of them would take minutes
+
+    std::cout << "\n--- Replace All Stress Test ---" << std::endl;
+    std::cout << "Generating " << SIZE_MB << " MB of text..." << std::endl;
+
+    // filler words, with the needle planted evenly so there are REPLACEMENTS of them
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    const size_t spacing = DOC_SIZE / REPLACEMENTS;
+    std::string text;
+    text.reserve(DOC_SIZE + 16);
+    uint64_t x = 88172645463325252ULL;
+    size_t next_needle = spacing / 2;
+    while (text.length() < DOC_SIZE)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+        if (text.length() >= next_needle)
+        {
+            text += "needle ";
+            next_needle += spacing;
+        }
+    }
+    text.resize(DOC_SIZE);
+
+    AL::piece_table pt(std::move(text));
+
+    // same edit mix as stress_random_edits. it only writes lowercase letters, which may cut a few needles
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> op_dist(0, 1);
+    std::uniform_int_distribution<int> char_dist('a', 'z');
+    std::uniform_int_distribution<int> len_dist(1, 100);
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        const size_t current_len = pt.length();
+        if (op_dist(rng) == 0)
+        {
+            std::string s(len_dist(rng), ' ');
+            for (auto& c : s)
+                c = static_cast<char>(char_dist(rng));
+            pt.insert(std::uniform_int_distribution<size_t>(0, current_len)(rng), s);
+        }
+        else
+        {
+            const size_t pos = std::uniform_int_distribution<size_t>(0, current_len - 1)(rng);
+            pt.remove(pos, std::uniform_int_distribution<size_t>(1, std::min<size_t>(100, current_len - pos))(rng));
+        }
+    }
+
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    std::cout << "Document:         " << pt.length() / 1024.0 / 1024.0 << " MB in " << pieces.size() << " pieces" << std::endl;
+
+    const AL::searcher needle("needle");
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<size_t> matches;
+    needle.find_all(pt, 0, pt.length(), matches);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "find_all:         " << matches.size() << " matches in " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms"
+              << std::endl;
+
+    // the baseline, on a copy: back to front so earlier positions stay valid
+    {
+        AL::piece_table copy(pt.to_string());
+        std::vector<size_t> copy_matches;
+        needle.find_all(copy, 0, copy.length(), copy_matches);
+        copy.replace_all(copy_matches, 6, "thread"); // fragment the copy the same way first
+
+        const size_t sample = std::min(ONE_BY_ONE, copy_matches.size());
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < sample; ++i)
+        {
+            const size_t at = copy_matches[copy_matches.size() - 1 - i];
+            copy.remove(at, 6);
+            copy.insert(at, "pin");
+        }
+        end = std::chrono::high_resolution_clock::now();
+        const double per_match = std::chrono::duration<double>(end - start).count() / static_cast<double>(sample);
+        std::cout << "remove + insert:  " << per_match * 1e6 << " us per match, ~" << per_match * static_cast<double>(matches.size()) * 1000.0
+                  << " ms for all of them" << std::endl;
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+    const size_t replaced = pt.replace_all(matches, 6, "thread");
+    end = std::chrono::high_resolution_clock::now();
+    pieces.clear();
+    pt.get_pieces(pieces);
+    std::cout << "replace_all:      " << replaced << " in " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms, "
+              << pieces.size() << " pieces after" << std::endl;
+
+    // verify
+    const size_t left = needle.count(pt, 0, pt.length());
+    const size_t replacements_found = AL::searcher("thread").count(pt, 0, pt.length());
+    if (left != 0 || replacements_found < replaced)
+    {
+        std::cerr << "ERROR: " << left << " needles left, " << replacements_found << " replacements found" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "piecetable.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if MINIEDITOR_POSIX_IO
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Save throughput: write_to through an ofstream against write_to_fd (writev), and write_to_fd with the opened file
+// (copy_file_range for the unchanged runs), on a fresh, a lightly edited and a fragmented document.
+// the files go to the temp directory and stay in the page cache, so this measures the write path, not the disk
+// usage: stress_save [size in MB, default 1024]
+static void report(const char* name, const AL::piece_table& pt, const std::filesystem::path& path, int original_fd)
+{
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    const double gb = pt.length() / 1024.0 / 1024.0 / 1024.0;
+    std::cout << name << ": " << pt.length() / 1024.0 / 1024.0 << " MB, " << pieces.size() << " pieces" << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        pt.write_to(ofs);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+    std::cout << "  ofstream:    " << secs * 1000.0 << " ms (" << gb / secs << " GB/s)" << std::endl;
+
+#if MINIEDITOR_POSIX_IO
+    std::filesystem::remove(path); // so neither run pays for truncating the other's file
+    start = std::chrono::high_resolution_clock::now();
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    const bool ok = fd >= 0 && pt.write_to_fd(fd);
+    if (fd >= 0)
+        ::close(fd);
+    end = std::chrono::high_resolution_clock::now();
+    secs = std::chrono::duration<double>(end - start).count();
+    std::cout << "  writev:      " << secs * 1000.0 << " ms (" << gb / secs << " GB/s)" << (ok ? "" : " FAILED") << std::endl;
+
+    std::filesystem::remove(path);
+    start = std::chrono::high_resolution_clock::now();
+    const int copy_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    const bool copied = copy_fd >= 0 && pt.write_to_fd(copy_fd, original_fd);
+    if (copy_fd >= 0)
+        ::close(copy_fd);
+    end = std::chrono::high_resolution_clock::now();
+    secs = std::chrono::duration<double>(end - start).count();
+    std::cout << "  copy range:  " << secs * 1000.0 << " ms (" << gb / secs << " GB/s)" << (copied ? "" : " FAILED") << std::endl;
+#endif
+
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t DOC_SIZE = SIZE_MB * 1024 * 1024;
+    const int NUM_EDITS = 500'000;
+    const auto path = std::filesystem::temp_directory_path() / "stress_save.txt";
+    const auto original_path = std::filesystem::temp_directory_path() / "stress_save_original.txt";
+
+    std::cout << "\n--- Save Stress Test ---" << std::endl;
+
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    std::string text;
+    text.reserve(DOC_SIZE + 16);
+    uint64_t x = 88172645463325252ULL;
+    while (text.length() < DOC_SIZE)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+    }
+    text.resize(DOC_SIZE);
+
+    // the file the document was opened from
+    {
+        std::ofstream ofs(original_path, std::ios::binary);
+        ofs << text;
+    }
+    int original_fd = -1;
+#if MINIEDITOR_POSIX_IO
+    original_fd = ::open(original_path.c_str(), O_RDONLY);
+#endif
+
+    AL::piece_table pt(std::move(text));
+    report("Unfragmented", pt, path, original_fd);
+
+    // a typical save: a handful of changes in a large file
+    std::mt19937 rng(42);
+    for (int i = 0; i < 10; ++i)
+        pt.insert(std::uniform_int_distribution<size_t>(0, pt.length())(rng), "edited ");
+    report("10 edits", pt, path, original_fd);
+
+    std::uniform_int_distribution<int> op_dist(0, 1);
+    std::uniform_int_distribution<int> char_dist('a', 'z');
+    std::uniform_int_distribution<int> len_dist(1, 100);
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        const size_t current_len = pt.length();
+        if (op_dist(rng) == 0)
+        {
+            std::string s(len_dist(rng), ' ');
+            for (auto& c : s)
+                c = static_cast<char>(char_dist(rng));
+            pt.insert(std::uniform_int_distribution<size_t>(0, current_len)(rng), s);
+        }
+        else
+        {
+            const size_t pos = std::uniform_int_distribution<size_t>(0, current_len - 1)(rng);
+            pt.remove(pos, std::uniform_int_distribution<size_t>(1, std::min<size_t>(100, current_len - pos))(rng));
+        }
+    }
+    report("Fragmented", pt, path, original_fd);
+
+#if MINIEDITOR_POSIX_IO
+    if (original_fd >= 0)
+        ::close(original_fd);
+#endif
+    std::filesystem::remove(original_path);
+    return 0;
+}
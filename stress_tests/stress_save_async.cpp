@@ -0,0 +1,95 @@
+#include "editor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// How long saving a large edited document keeps the editor from taking keystrokes: a blocking save against
+// save_async, which only freezes the piece list and writes on a worker thread. while the worker runs, the
+// main thread keeps typing and times every edit
+// usage: stress_save_async [size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const int NUM_INSERTS = 100'000;
+    const auto path = std::filesystem::temp_directory_path() / "stress_save_async.txt";
+
+    std::cout << "\n--- Background Save Stress Test ---" << std::endl;
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        const std::string line = "the quick brown fox jumps over the lazy dog 0123456789\n";
+        for (size_t written = 0; written < SIZE_MB * 1024 * 1024; written += line.size())
+            ofs << line;
+    }
+
+    AL::editor ed;
+    if (!ed.open(path))
+        return 1;
+
+    uint64_t x = 88172645463325252ULL;
+    const auto next = [&]() {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    };
+    const size_t length = std::filesystem::file_size(path);
+    for (int i = 0; i < NUM_INSERTS; ++i)
+    {
+        ed.set_cursor_to_index(next() % length);
+        ed.insert_text("edit");
+    }
+    std::cout << "File:             " << SIZE_MB << " MB, " << NUM_INSERTS << " inserts" << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const bool saved = ed.save();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "save (blocking):  " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms"
+              << (saved ? "" : " FAILED") << std::endl;
+
+    ed.set_cursor_to_index(0);
+    ed.insert_text("#");
+    start = std::chrono::high_resolution_clock::now();
+    const bool started = ed.save_async();
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "save_async start: " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms"
+              << (started ? "" : " FAILED") << std::endl;
+
+    // a key every 8 ms (the TUI's input timeout) at random places until the worker is done
+    int edits = 0;
+    double worst_ms = 0.0;
+    double total_ms = 0.0;
+    AL::save_status status = AL::save_status::RUNNING;
+    while (status == AL::save_status::RUNNING)
+    {
+        const auto edit_start = std::chrono::high_resolution_clock::now();
+        ed.set_cursor_to_index(next() % length);
+        ed.insert_text("k");
+        const double ms = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - edit_start).count() * 1000.0;
+        worst_ms = std::max(worst_ms, ms);
+        total_ms += ms;
+        ++edits;
+        std::this_thread::sleep_for(std::chrono::milliseconds(8));
+        status = ed.poll_save();
+    }
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "save_async done:  " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms"
+              << (status == AL::save_status::DONE ? "" : " FAILED") << std::endl;
+    std::cout << "Edits meanwhile:  " << edits << ", " << total_ms * 1000.0 / std::max(edits, 1) << " us on average, worst " << worst_ms
+              << " ms" << std::endl;
+
+    const bool dirty = ed.is_dirty();
+    const bool same = std::filesystem::file_size(path) == length + NUM_INSERTS * 4 + 1;
+    std::filesystem::remove(path);
+    if (!saved || status != AL::save_status::DONE || !same || (edits > 0 && !dirty))
+    {
+        std::cerr << "ERROR: the background save went wrong" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "piecetable.h"
+#include "search.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Searching a large document after it has been fragmented by random edits (same edit mix as stress_random_edits)
+// usage: stress_search [size in MB, default 1024]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t DOC_SIZE = SIZE_MB * 1024 * 1024;
+    const int NUM_EDITS = 500'000;
+
+    std::cout << "\n--- Search Stress Test ---" << std::endl;
+    std::cout << "Generating " << SIZE_MB << " MB of text..." << std::endl;
+
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    std::string text;
+    text.reserve(DOC_SIZE + 16);
+    uint64_t x = 88172645463325252ULL;
+    while (text.length() < DOC_SIZE)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+    }
+    text.resize(DOC_SIZE);
+
+    AL::piece_table pt(std::move(text));
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> op_dist(0, 1);
+    std::uniform_int_distribution<int> char_dist('a', 'z');
+    std::uniform_int_distribution<int> len_dist(1, 100);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        const size_t current_len = pt.length();
+        if (op_dist(rng) == 0)
+        {
+            std::string s(len_dist(rng), ' ');
+            for (auto& c : s)
+                c = static_cast<char>(char_dist(rng));
+            pt.insert(std::uniform_int_distribution<size_t>(0, current_len)(rng), s);
+        }
+        else
+        {
+            const size_t pos = std::uniform_int_distribution<size_t>(0, current_len - 1)(rng);
+            pt.remove(pos, std::uniform_int_distribution<size_t>(1, std::min<size_t>(100, current_len - pos))(rng));
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    const double doc_mb = pt.length() / 1024.0 / 1024.0;
+    std::cout << "Edits:            " << NUM_EDITS << " in " << std::chrono::duration<double>(end - start).count() << " s" << std::endl;
+    std::cout << "Document:         " << doc_mb << " MB in " << pieces.size() << " pieces" << std::endl;
+    pieces.clear();
+    pieces.shrink_to_fit();
+
+    auto report = [doc_mb](const char* name, std::chrono::high_resolution_clock::time_point s, std::chrono::high_resolution_clock::time_point e) {
+        const double secs = std::chrono::duration<double>(e - s).count();
+        std::cout << name << secs * 1000.0 << " ms (" << (doc_mb / 1024.0) / secs << " GB/s)" << std::endl;
+    };
+
+    // the needle never occurs, so every search below reads the whole document
+    const AL::searcher missing("lazy_needle");
+
+    start = std::chrono::high_resolution_clock::now();
+    size_t hit = missing.find_next(pt, 0);
+    end = std::chrono::high_resolution_clock::now();
+    report("find_next (miss): ", start, end);
+
+    start = std::chrono::high_resolution_clock::now();
+    hit = missing.find_prev(pt, pt.length());
+    end = std::chrono::high_resolution_clock::now();
+    report("find_prev (miss): ", start, end);
+    if (hit != AL::searcher::npos)
+        std::cerr << "ERROR: found a needle that does not exist" << std::endl;
+
+    std::vector<size_t> matches;
+    start = std::chrono::high_resolution_clock::now();
+    AL::searcher("treap editor").find_all(pt, 0, pt.length(), matches);
+    end = std::chrono::high_resolution_clock::now();
+    report("find_all:         ", start, end);
+    std::cout << "  matches:        " << matches.size() << std::endl;
+
+    // for reference: the old way, and the fastest possible scan of a flat copy
+    start = std::chrono::high_resolution_clock::now();
+    const std::string flat = pt.to_string();
+    hit = flat.find("lazy_needle");
+    end = std::chrono::high_resolution_clock::now();
+    report("to_string + find: ", start, end);
+
+    start = std::chrono::high_resolution_clock::now();
+    const void* p = std::memchr(flat.data(), '#', flat.length());
+    end = std::chrono::high_resolution_clock::now();
+    report("memchr (flat):    ", start, end);
+
+    return (hit == std::string::npos && p == nullptr) ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include "piecetable.h"
+#include "search.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Parallel search scaling from 1 to N threads on a fragmented document
+// usage: stress_search_parallel [size in MB, default 1024] [max threads, default hardware threads]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    const size_t MAX_THREADS = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    const size_t DOC_SIZE = SIZE_MB * 1024 * 1024;
+    const int NUM_EDITS = 500'000;
+
+    std::cout << "\n--- Parallel Search Stress Test ---" << std::endl;
+    std::cout << "Generating " << SIZE_MB << " MB of text..." << std::endl;
+
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    std::string text;
+    text.reserve(DOC_SIZE + 16);
+    uint64_t x = 88172645463325252ULL;
+    while (text.length() < DOC_SIZE)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+    }
+    text.resize(DOC_SIZE);
+
+    AL::piece_table pt(std::move(text));
+
+    // same edit mix as stress_random_edits
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> op_dist(0, 1);
+    std::uniform_int_distribution<int> char_dist('a', 'z');
+    std::uniform_int_distribution<int> len_dist(1, 100);
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        const size_t current_len = pt.length();
+        if (op_dist(rng) == 0)
+        {
+            std::string s(len_dist(rng), ' ');
+            for (auto& c : s)
+                c = static_cast<char>(char_dist(rng));
+            pt.insert(std::uniform_int_distribution<size_t>(0, current_len)(rng), s);
+        }
+        else
+        {
+            const size_t pos = std::uniform_int_distribution<size_t>(0, current_len - 1)(rng);
+            pt.remove(pos, std::uniform_int_distribution<size_t>(1, std::min<size_t>(100, current_len - pos))(rng));
+        }
+    }
+
+    const double doc_gb = pt.length() / 1024.0 / 1024.0 / 1024.0;
+    const AL::searcher search("treap editor");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const size_t expected = search.count(pt, 0, pt.length());
+    auto end = std::chrono::high_resolution_clock::now();
+    const double single = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "Document:         " << doc_gb << " GB, " << expected << " matches" << std::endl;
+    std::cout << "Single threaded:  " << single * 1000.0 << " ms (" << doc_gb / single << " GB/s)" << std::endl;
+    std::cout << "\nThreads | count ms | GB/s  | speedup | find_all ms" << std::endl;
+
+    for (size_t threads = 1; threads <= MAX_THREADS; ++threads)
+    {
+        AL::thread_pool pool(threads - 1);
+
+        start = std::chrono::high_resolution_clock::now();
+        const size_t found = search.count(pt, 0, pt.length(), pool);
+        end = std::chrono::high_resolution_clock::now();
+        const double counted = std::chrono::duration<double>(end - start).count();
+
+        std::vector<size_t> matches;
+        start = std::chrono::high_resolution_clock::now();
+        search.find_all(pt, 0, pt.length(), matches, pool);
+        end = std::chrono::high_resolution_clock::now();
+        const double listed = std::chrono::duration<double>(end - start).count();
+
+        std::cout << std::setw(7) << threads << " | " << std::setw(8) << std::fixed << std::setprecision(1) << counted * 1000.0 << " | "
+                  << std::setw(5) << std::setprecision(2) << doc_gb / counted << " | " << std::setw(7) << single / counted << " | " << std::setw(8)
+                  << std::setprecision(1) << listed * 1000.0 << std::endl;
+
+        if (found != expected || matches.size() != expected)
+        {
+            std::cerr << "ERROR: parallel search disagrees with the single threaded one" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "piecetable.h"
+#include "snapshot.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reopening a heavily edited document: restoring a session snapshot against loading the saved text.
+// the original is in memory already in both cases (an open reads the file either way)
+// usage: stress_snapshot [original size in MB, default 512] [add buffer in MB, default 300]
+int main(int argc, char** argv)
+{
+    const size_t SIZE_MB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512;
+    const size_t ADD_MB = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 300;
+    const size_t NUM_INSERTS = 250'000;
+    const auto path = std::filesystem::temp_directory_path() / "stress_snapshot.session";
+
+    std::cout << "\n--- Snapshot Stress Test ---" << std::endl;
+
+    const char* words[] = {"the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "piece ", "table ", "treap ", "editor\n"};
+    std::string text;
+    text.reserve(SIZE_MB * 1024 * 1024 + 16);
+    uint64_t x = 88172645463325252ULL;
+    while (text.length() < SIZE_MB * 1024 * 1024)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        text += words[x % 12];
+    }
+    text.resize(SIZE_MB * 1024 * 1024);
+    const std::string original = text;
+
+    AL::piece_table pt(std::move(text));
+    std::mt19937_64 rng(42);
+    const std::string chunk(ADD_MB * 1024 * 1024 / NUM_INSERTS, 'z');
+    std::string line = chunk;
+    line.back() = '\n';
+    for (size_t i = 0; i < NUM_INSERTS; ++i)
+        pt.insert(rng() % (pt.length() + 1), line);
+
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    std::cout << "Document:         " << pt.length() / 1024.0 / 1024.0 << " MB, " << pieces.size() << " pieces, "
+              << pt.get_add_buffer().length() / 1024.0 / 1024.0 << " MB add buffer" << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const bool written = AL::write_snapshot(path, pt, original.size(), 1, false, 0);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "write_snapshot:   " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms ("
+              << std::filesystem::file_size(path) / 1024.0 / 1024.0 << " MB)" << std::endl;
+
+    std::string file_bytes = original;
+    AL::piece_table restored;
+    AL::snapshot_header header;
+    start = std::chrono::high_resolution_clock::now();
+    const bool read = AL::read_snapshot(path, file_bytes, original.size(), 1, restored, header);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "read_snapshot:    " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms" << std::endl;
+
+    // what reopening costs without one: the saved text goes through the constructor (normalize, newline counts)
+    std::string saved = pt.to_string();
+    start = std::chrono::high_resolution_clock::now();
+    AL::piece_table loaded(std::move(saved));
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "Load saved text:  " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms (" << loaded.get_line_count()
+              << " lines)" << std::endl;
+
+    std::filesystem::remove(path);
+    if (!written || !read || restored.length() != pt.length() || restored.get_line_count() != pt.get_line_count() ||
+        restored.get_line(123'456) != pt.get_line(123'456))
+    {
+        std::cerr << "ERROR: the restored document differs" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "piecetable.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/resource.h>
+
+double get_memory_usage()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        return static_cast<double>(usage.ru_maxrss) / 1024.0;
+    }
+    return 0.0;
+}
+
+// Sorting a log by timestamp: lines in random order, some of them edited, sorted with piece_table::sort_lines
+// usage: stress_sort_lines [lines, default 20000000]
+int main(int argc, char** argv)
+{
+    const size_t LINES = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20'000'000;
+    const int NUM_EDITS = 100'000;
+
+    std::cout << "\n--- Sort Lines Stress Test ---" << std::endl;
+    std::cout << "Generating " << LINES << " log lines..." << std::endl;
+
+    std::mt19937_64 rng(42);
+    std::string text;
+    text.reserve(LINES * 40);
+    char line[64];
+    for (size_t i = 0; i < LINES; ++i)
+    {
+        const uint64_t r = rng();
+        const int length = std::snprintf(line, sizeof(line), "2025-%02d-%02dT%02d:%02d:%02d.%06d worker-%02d ok\n", int(r % 12 + 1), int(r / 12 % 28 + 1),
+                                         int(r / 336 % 24), int(r / 8064 % 60), int(r / 483840 % 60), int(r / 29030400 % 1000000), int(r >> 58));
+        text.append(line, static_cast<size_t>(length));
+    }
+
+    AL::piece_table pt(std::move(text));
+
+    // new lines typed in at random line starts, plus edits inside lines, so some lines cross pieces
+    for (int i = 0; i < NUM_EDITS; ++i)
+    {
+        const size_t at = pt.get_index_for_line(1 + rng() % pt.get_line_count());
+        if (i % 2)
+            pt.insert(at, "2025-06-01T00:00:00.000000 editor-00 ok\n");
+        else
+            pt.insert(at + 20, "X");
+    }
+
+    const size_t lines_before = pt.get_line_count();
+    std::cout << "Document:         " << pt.length() / 1024.0 / 1024.0 << " MB, " << lines_before << " lines" << std::endl;
+    std::cout << "Threads:          " << AL::get_thread_pool().concurrency() << std::endl;
+    const double memory_before = get_memory_usage();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const size_t sorted = pt.sort_lines(AL::get_thread_pool());
+    auto end = std::chrono::high_resolution_clock::now();
+    const double sort_secs = std::chrono::duration<double>(end - start).count();
+
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    std::cout << "sort_lines:       " << sort_secs * 1000.0 << " ms (" << sorted << " lines, " << pieces.size() << " pieces)" << std::endl;
+    std::cout << "Peak memory:      " << memory_before << " MB before, " << get_memory_usage() << " MB after" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    const size_t unique = pt.sort_lines(AL::get_thread_pool(), true);
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "sort_lines unique: " << std::chrono::duration<double>(end - start).count() * 1000.0 << " ms (" << unique << " lines left)"
+              << std::endl;
+
+    if (sorted != lines_before || pt.get_line_count() != unique)
+    {
+        std::cerr << "ERROR: line count changed, " << sorted << " sorted out of " << lines_before << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < 10'000; ++i)
+    {
+        const size_t row = 1 + rng() % (unique - 1);
+        if (!(pt.get_line(row) < pt.get_line(row + 1)))
+        {
+            std::cerr << "ERROR: lines " << row << " and " << row + 1 << " are out of order" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
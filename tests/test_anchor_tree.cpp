@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <anchor_tree.h>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+TEST_CASE("anchor_tree: Anchors move with inserts and removes", "[anchor_tree]")
+{
+    AL::anchor_tree anchors;
+    const AL::anchor_id a = anchors.add(10);
+    const AL::anchor_id b = anchors.add(20);
+    const AL::anchor_id c = anchors.add(20);
+    const AL::anchor_id d = anchors.add(5);
+    CHECK(anchors.size() == 4);
+
+    anchors.on_insert(20, 3); // anchors right at the insert stay before it
+    CHECK(anchors.get_position(a) == 10);
+    CHECK(anchors.get_position(b) == 20);
+    CHECK(anchors.get_position(c) == 20);
+
+    anchors.on_insert(7, 2);
+    CHECK(anchors.get_position(d) == 5);
+    CHECK(anchors.get_position(a) == 12);
+    CHECK(anchors.get_position(b) == 22);
+
+    anchors.on_remove(10, 5); // a is inside, b after
+    CHECK(anchors.get_position(d) == 5);
+    CHECK(anchors.get_position(a) == 10);
+    CHECK(anchors.get_position(b) == 17);
+    CHECK(anchors.get_position(c) == 17);
+
+    anchors.remove(a);
+    CHECK(anchors.size() == 3);
+    CHECK(anchors.get_position(b) == 17);
+
+    anchors.on_remove(0, 100);
+    CHECK(anchors.get_position(d) == 0);
+    CHECK(anchors.get_position(b) == 0);
+
+    // ids are reused
+    const AL::anchor_id e = anchors.add(1);
+    CHECK(e == a);
+    anchors.clear();
+    CHECK(anchors.size() == 0);
+}
+
+TEST_CASE("anchor_tree: Random edits agree with shifting a plain array", "[anchor_tree]")
+{
+    std::mt19937 rng(11);
+    AL::anchor_tree anchors;
+    std::vector<AL::anchor_id> ids;
+    std::vector<size_t> expected;
+    size_t length = 10'000;
+
+    // enough anchors up front that a remove collapses whole subtrees
+    for (int i = 0; i < 300; ++i)
+    {
+        expected.push_back(rng() % (length + 1));
+        ids.push_back(anchors.add(expected.back()));
+    }
+
+    for (int step = 0; step < 5'000; ++step)
+    {
+        const int op = static_cast<int>(rng() % 10);
+        if (op == 0 || ids.empty())
+        {
+            const size_t position = rng() % (length + 1);
+            ids.push_back(anchors.add(position));
+            expected.push_back(position);
+        }
+        else if (op == 1)
+        {
+            const size_t i = rng() % ids.size();
+            anchors.remove(ids[i]);
+            ids.erase(ids.begin() + static_cast<std::ptrdiff_t>(i));
+            expected.erase(expected.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        else if (op < 6)
+        {
+            const size_t position = rng() % (length + 1);
+            const size_t inserted = 1 + rng() % 50;
+            anchors.on_insert(position, inserted);
+            for (auto& e : expected)
+                e += e > position ? inserted : 0;
+            length += inserted;
+        }
+        else
+        {
+            const size_t position = rng() % length;
+            const size_t removed = std::min<size_t>(1 + rng() % 50, length - position);
+            anchors.on_remove(position, removed);
+            for (auto& e : expected)
+                e = e >= position + removed ? e - removed : (e > position ? position : e);
+            length -= removed;
+        }
+
+        // every step, since a stale collapse tag can be fixed up again by the next edit
+        bool same = true;
+        for (size_t i = 0; i < ids.size(); ++i)
+            same = same && anchors.get_position(ids[i]) == expected[i];
+        REQUIRE(same);
+    }
+    CHECK(anchors.size() == ids.size());
+}
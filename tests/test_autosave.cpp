@@ -0,0 +1,87 @@
+#include <autosave.h>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <piecetable.h>
+#include <string>
+#include <thread>
+
+static std::string read_all(const std::filesystem::path& path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+static void wait_until_idle(const AL::autosaver& saver)
+{
+    while (!saver.is_idle())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+TEST_CASE("autosave: Writes a frozen document to the sidecar", "[autosave]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "test_autosave.autosave";
+    AL::piece_table pt("hello world\n");
+    pt.insert(5, ",");
+    const std::string expected = pt.to_string();
+
+    AL::autosaver saver;
+    CHECK(saver.is_idle());
+    const AL::frozen_document document = pt.freeze();
+    REQUIRE(saver.write(path, document));
+    pt.insert(0, "not in the copy "); // editing goes on meanwhile
+    wait_until_idle(saver);
+    pt.thaw();
+
+    CHECK(saver.succeeded());
+    CHECK(read_all(path) == expected);
+    CHECK_FALSE(std::filesystem::exists(std::filesystem::path(path.string() + ".tmp")));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("autosave: The budget paces the write", "[autosave]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "test_autosave_budget.autosave";
+    AL::piece_table pt(std::string(3 * 1024 * 1024, 'x'));
+
+    // a second of budget goes at once, the other two megabytes take about two seconds
+    AL::autosaver saver;
+    saver.set_budget(1024 * 1024);
+    const AL::frozen_document document = pt.freeze();
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(saver.write(path, document));
+    CHECK_FALSE(saver.write(path, document)); // one at a time
+    wait_until_idle(saver);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    pt.thaw();
+
+    CHECK(saver.succeeded());
+    CHECK(elapsed >= std::chrono::milliseconds(1500));
+    CHECK(std::filesystem::file_size(path) == pt.length());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("autosave: Cancel leaves the old copy alone", "[autosave]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "test_autosave_cancel.autosave";
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << "older copy";
+    }
+
+    AL::piece_table pt(std::string(4 * 1024 * 1024, 'y'));
+    AL::autosaver saver;
+    saver.set_budget(256 * 1024); // would take a dozen seconds
+    const AL::frozen_document document = pt.freeze();
+    REQUIRE(saver.write(path, document));
+    saver.cancel();
+    CHECK(saver.is_idle());
+    pt.thaw();
+
+    CHECK_FALSE(saver.succeeded());
+    CHECK(read_all(path) == "older copy");
+    CHECK_FALSE(std::filesystem::exists(std::filesystem::path(path.string() + ".tmp")));
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <byte_scan.h>
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+TEST_CASE("byte_scan: count_byte matches std::count", "[byte_scan]")
+{
+    // long enough to hit the 255 block widening and every tail length
+    std::string text;
+    for (int i = 0; i < 5000; ++i)
+        text += (i % 7 == 0) ? '\n' : static_cast<char>('a' + i % 26);
+
+    for (size_t len : {0u, 1u, 15u, 16u, 17u, 255u * 16u, 255u * 16u + 3u, 5000u})
+    {
+        const auto expected = static_cast<size_t>(std::count(text.begin(), text.begin() + len, '\n'));
+        CHECK(AL::count_byte(text.data(), len, '\n') == expected);
+    }
+
+    const std::string all(4096 + 5, '\n');
+    CHECK(AL::count_byte(all.data(), all.size(), '\n') == all.size());
+    CHECK(AL::count_byte(all.data(), all.size(), 'x') == 0);
+}
+
+TEST_CASE("byte_scan: rfind_byte", "[byte_scan]")
+{
+    std::string text(100, 'a');
+    CHECK(AL::rfind_byte(text.data(), text.size(), '\n') == nullptr);
+    CHECK(AL::rfind_byte(text.data(), 0, 'a') == nullptr);
+
+    text[3] = '\n';
+    text[40] = '\n';
+    CHECK(AL::rfind_byte(text.data(), text.size(), '\n') == text.data() + 40);
+    CHECK(AL::rfind_byte(text.data(), 40, '\n') == text.data() + 3);
+    CHECK(AL::rfind_byte(text.data(), 4, '\n') == text.data() + 3);
+    CHECK(AL::rfind_byte(text.data(), 3, '\n') == nullptr);
+}
+
+TEST_CASE("byte_scan: find_byte_in_ranges", "[byte_scan]")
+{
+    std::string text(100, 'a');
+    const AL::byte_range digits[] = {{'0', '9'}};
+    const AL::byte_range mixed[] = {{'0', '9'}, {'q', 'q'}, {0xf0, 0xff}};
+
+    CHECK(AL::find_byte_in_ranges(text.data(), text.size(), digits, 1) == nullptr);
+    CHECK(AL::find_byte_in_ranges(text.data(), text.size(), mixed, 3) == nullptr);
+
+    text[70] = '5';
+    text[33] = 'q';
+    text[90] = static_cast<char>(0xf7);
+    CHECK(AL::find_byte_in_ranges(text.data(), text.size(), digits, 1) == text.data() + 70);
+    CHECK(AL::find_byte_in_ranges(text.data(), text.size(), mixed, 3) == text.data() + 33);
+    CHECK(AL::find_byte_in_ranges(text.data() + 34, 50, mixed, 3) == text.data() + 70);
+    CHECK(AL::find_byte_in_ranges(text.data() + 71, 29, mixed, 3) == text.data() + 90);
+    CHECK(AL::find_byte_in_ranges(text.data() + 71, 19, mixed, 3) == nullptr); // stops short of 90 in the tail
+
+    // boundaries of a range
+    const AL::byte_range lower[] = {{'b', 'y'}};
+    const std::string edges = std::string(20, 'a') + "z" + std::string(5, 'a') + "y";
+    CHECK(AL::find_byte_in_ranges(edges.data(), edges.size(), lower, 1) == edges.data() + 26);
+}
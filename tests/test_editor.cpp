@@ -1,10 +1,18 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_version_macros.hpp>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <editor.h>
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#if MINIEDITOR_POSIX_IO
+#include <sys/stat.h>
+#endif
 
 using piece_table = AL::piece_table;
 using implicit_treap = AL::implicit_treap;
@@ -91,6 +99,30 @@ TEST_CASE("Editor: File Operations", "[editor]")
 
         std::filesystem::remove(new_path);
     }
+
+    SECTION("Save a large file twice")
+    {
+        // the unchanged text is copied from the file that was opened, which stays valid after the first save replaces it
+        std::string content;
+        while (content.length() < 300'000)
+            content += "0123456789 abcdefghij\n";
+        auto path = create_temp_file("test_save_large.txt", content);
+        REQUIRE(ed.open(path));
+        ed.set_cursor_to_index(150'000);
+        ed.insert_char('A');
+        ed.flush_insert_buffer();
+        CHECK(ed.save());
+        content.insert(150'000, "A");
+        CHECK(read_file_content(path) == content);
+
+        ed.set_cursor_to_index(10);
+        ed.insert_char('B');
+        ed.flush_insert_buffer();
+        CHECK(ed.save());
+        content.insert(10, "B");
+        CHECK(read_file_content(path) == content);
+        std::filesystem::remove(path);
+    }
 }
 
 TEST_CASE("Editor: Editing Operations (Stubs)", "[editor]")
@@ -416,3 +448,938 @@ TEST_CASE("Editor: Empty file operations", "[editor][edge]")
 
     std::filesystem::remove(path);
 }
+
+TEST_CASE("Editor: Bulk text insertion", "[editor]")
+{
+    AL::editor ed;
+    auto path = create_temp_file("insert_text.txt", "abc\ndef");
+    ed.open(path);
+
+    SECTION("Single line paste moves the column")
+    {
+        ed.move_cursor(AL::direction::RIGHT);
+        ed.insert_text("XYZ");
+        CHECK(ed.get_line(1) == "aXYZbc");
+        CHECK(ed.get_cursor_row() == 1);
+        CHECK(ed.get_cursor_col() == 5);
+    }
+
+    SECTION("Multi line paste moves row and column")
+    {
+        ed.move_cursor(AL::direction::RIGHT);
+        ed.insert_text("1\n22\n333");
+        CHECK(ed.get_total_lines() == 4);
+        CHECK(ed.get_line(1) == "a1");
+        CHECK(ed.get_line(2) == "22");
+        CHECK(ed.get_line(3) == "333bc");
+        CHECK(ed.get_cursor_row() == 3);
+        CHECK(ed.get_cursor_col() == 4);
+
+        // cursor index must agree with row/col
+        ed.insert_char('!');
+        ed.flush_insert_buffer();
+        CHECK(ed.get_line(3) == "333!bc");
+    }
+
+    SECTION("Paste ending with a newline")
+    {
+        ed.insert_text("top\n");
+        CHECK(ed.get_line(1) == "top");
+        CHECK(ed.get_line(2) == "abc");
+        CHECK(ed.get_cursor_row() == 2);
+        CHECK(ed.get_cursor_col() == 1);
+    }
+
+    SECTION("CRLF paste is normalized")
+    {
+        ed.insert_text("x\r\ny");
+        CHECK(ed.get_line(1) == "x");
+        CHECK(ed.get_line(2) == "yabc");
+        CHECK(ed.get_cursor_row() == 2);
+        CHECK(ed.get_cursor_col() == 2);
+    }
+
+    SECTION("Pending typed text is flushed first")
+    {
+        ed.insert_char('q');
+        ed.insert_text("rs");
+        CHECK(ed.get_line(1) == "qrsabc");
+        CHECK(ed.get_cursor_col() == 4);
+    }
+
+    SECTION("Empty paste does nothing")
+    {
+        ed.insert_text("");
+        CHECK_FALSE(ed.is_dirty());
+        CHECK(ed.get_cursor_col() == 1);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Backspace coalescing", "[editor]")
+{
+    AL::editor ed;
+    auto path = create_temp_file("backspace_batch.txt", "hello world\nnext");
+    ed.open(path);
+
+    for (int i = 0; i < 11; i++)
+        ed.move_cursor(AL::direction::RIGHT);
+
+    SECTION("Backspaces are batched until flushed")
+    {
+        for (int i = 0; i < 5; i++)
+            ed.delete_char();
+
+        CHECK(ed.get_delete_buffer_length() == 5);
+        CHECK(ed.get_cursor_col() == 7);
+        CHECK(ed.get_line(1) == "hello world"); // still pending
+
+        ed.flush_delete_buffer();
+        CHECK(ed.get_delete_buffer_length() == 0);
+        CHECK(ed.get_line(1) == "hello ");
+        CHECK(ed.get_cursor_col() == 7);
+    }
+
+    SECTION("Typing after backspaces flushes the batch first")
+    {
+        ed.delete_char();
+        ed.delete_char();
+        ed.insert_char('L');
+        ed.insert_char('D');
+        ed.flush_insert_buffer();
+        CHECK(ed.get_line(1) == "hello worLD");
+        CHECK(ed.get_cursor_col() == 12);
+    }
+
+    SECTION("Backspace over typed text only shrinks the insert buffer")
+    {
+        ed.insert_char('!');
+        ed.insert_char('?');
+        ed.delete_char();
+        CHECK(ed.get_insert_buffer() == "!");
+        CHECK(ed.get_delete_buffer_length() == 0);
+        ed.flush_insert_buffer();
+        CHECK(ed.get_line(1) == "hello world!");
+        CHECK(ed.get_cursor_col() == 13);
+    }
+
+    SECTION("Moving the cursor flushes the batch")
+    {
+        ed.delete_char();
+        ed.move_cursor(AL::direction::LEFT);
+        CHECK(ed.get_delete_buffer_length() == 0);
+        CHECK(ed.get_line(1) == "hello worl");
+        CHECK(ed.get_cursor_col() == 10);
+    }
+
+    SECTION("Crossing a newline flushes and joins")
+    {
+        ed.move_cursor(AL::direction::DOWN); // row 2, col 5 (end of "next")
+        for (int i = 0; i < 5; i++)
+            ed.delete_char();
+
+        CHECK(ed.get_line(1) == "hello world");
+        CHECK(ed.get_cursor_row() == 1);
+        CHECK(ed.get_cursor_col() == 12);
+        CHECK(ed.get_total_lines() == 1);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Range deletion", "[editor]")
+{
+    AL::editor ed;
+    auto path = create_temp_file("delete_range.txt", "line1\nline2\nline3\nline4");
+    ed.open(path);
+
+    SECTION("Range after the cursor keeps the cursor")
+    {
+        ed.delete_range(6, 12);
+        CHECK(ed.get_line(2) == "line3");
+        CHECK(ed.get_cursor_row() == 1);
+        CHECK(ed.get_cursor_col() == 1);
+    }
+
+    SECTION("Range before the cursor shifts row and column")
+    {
+        ed.move_cursor(AL::direction::DOWN);
+        ed.move_cursor(AL::direction::DOWN);
+        ed.move_cursor(AL::direction::RIGHT);
+        ed.move_cursor(AL::direction::RIGHT); // row 3, col 3
+
+        ed.delete_range(3, 14); // "e1\nline2\nli"
+        CHECK(ed.get_line(1) == "linne3");
+        CHECK(ed.get_total_lines() == 2);
+        CHECK(ed.get_cursor_row() == 1);
+        CHECK(ed.get_cursor_col() == 4);
+    }
+
+    SECTION("Cursor inside the range moves to its start")
+    {
+        ed.move_cursor(AL::direction::DOWN); // row 2, col 1 (index 6)
+        ed.delete_range(2, 20);
+        CHECK(ed.get_line(1) == "line4");
+        CHECK(ed.get_cursor_row() == 1);
+        CHECK(ed.get_cursor_col() == 3);
+    }
+
+    SECTION("Range is clamped to the document")
+    {
+        ed.delete_range(17, 1000);
+        CHECK(ed.get_total_lines() == 3);
+        CHECK(ed.get_line(3) == "line3");
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Navigation jumps", "[editor]")
+{
+    AL::editor ed;
+    auto path = create_temp_file("navigation.txt", "first line\nab\nthird line here\nx\n");
+    ed.open(path);
+
+    SECTION("goto_line keeps the remembered column and clamps")
+    {
+        ed.move_to_line_end(); // col 11 on "first line"
+        ed.goto_line(3);
+        CHECK(ed.get_cursor_row() == 3);
+        CHECK(ed.get_cursor_col() == 11);
+
+        ed.goto_line(2);
+        CHECK(ed.get_cursor_col() == 3);
+
+        ed.goto_line(1000); // the empty line after the trailing newline
+        CHECK(ed.get_cursor_row() == 5);
+        CHECK(ed.get_cursor_col() == 1);
+
+        ed.goto_line(0);
+        CHECK(ed.get_cursor_row() == 1);
+    }
+
+    SECTION("Home and End")
+    {
+        ed.goto_line(3);
+        ed.move_to_line_end();
+        CHECK(ed.get_cursor_col() == 16);
+        ed.insert_text("!");
+        CHECK(ed.get_line(3) == "third line here!");
+
+        ed.move_to_line_start();
+        CHECK(ed.get_cursor_col() == 1);
+        ed.insert_text(">");
+        CHECK(ed.get_line(3) == ">third line here!");
+        CHECK(ed.get_cursor_col() == 2);
+    }
+
+    SECTION("Document start and end")
+    {
+        ed.move_to_document_end();
+        CHECK(ed.get_cursor_row() == 5);
+        CHECK(ed.get_cursor_col() == 1);
+        ed.insert_text("z");
+        CHECK(ed.get_line(5) == "z");
+
+        ed.move_to_document_start();
+        CHECK(ed.get_cursor_row() == 1);
+        CHECK(ed.get_cursor_col() == 1);
+        ed.insert_text("y");
+        CHECK(ed.get_line(1) == "yfirst line");
+    }
+
+    SECTION("Page up and page down")
+    {
+        ed.move_page_down(2);
+        CHECK(ed.get_cursor_row() == 3);
+        ed.move_page_down(2);
+        CHECK(ed.get_cursor_row() == 5);
+        ed.move_page_down(2);
+        CHECK(ed.get_cursor_row() == 5);
+
+        ed.move_page_up(3);
+        CHECK(ed.get_cursor_row() == 2);
+        ed.move_page_up(3);
+        CHECK(ed.get_cursor_row() == 1);
+        CHECK(ed.get_cursor_col() == 1);
+    }
+
+    SECTION("Pending edits are flushed before jumping")
+    {
+        ed.move_to_line_end();
+        ed.insert_char('?');
+        ed.goto_line(4);
+        CHECK(ed.get_line(1) == "first line?");
+        CHECK(ed.get_cursor_col() == 2);
+
+        ed.delete_char();
+        ed.move_to_document_start();
+        CHECK(ed.get_line(4) == "");
+        CHECK(ed.get_total_lines() == 5);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Set cursor to index", "[editor]")
+{
+    AL::editor ed;
+    ed.insert_text("hello\nworld\nfoo");
+
+    ed.set_cursor_to_index(8); // the 'r' in "world"
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 3);
+
+    ed.move_cursor(AL::direction::UP);
+    CHECK(ed.get_cursor_row() == 1);
+    CHECK(ed.get_cursor_col() == 3); // the column is remembered like any horizontal move
+
+    ed.set_cursor_to_index(8);
+    ed.insert_char('!');
+    ed.flush_insert_buffer();
+    CHECK(ed.get_line(2) == "wo!rld");
+
+    ed.set_cursor_to_index(1000);
+    CHECK(ed.get_cursor_row() == 3);
+    CHECK(ed.get_cursor_col() == 4);
+
+    ed.set_cursor_to_index(0);
+    CHECK(ed.get_cursor_row() == 1);
+    CHECK(ed.get_cursor_col() == 1);
+}
+
+TEST_CASE("Editor: Replace all", "[editor]")
+{
+    AL::editor ed;
+    ed.insert_text("cat dog cat\ncat bird");
+    ed.set_cursor_to_index(16); // the 'b' in "bird"
+
+    CHECK(ed.replace_all("cat", "tiger") == 3);
+    CHECK(ed.is_dirty());
+    CHECK(ed.get_line(1) == "tiger dog tiger");
+    CHECK(ed.get_line(2) == "tiger bird");
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 7); // still on the 'b'
+
+    ed.set_cursor_to_index(2); // inside the first "tiger"
+    CHECK(ed.replace_all("tiger", "\n") == 3);
+    CHECK(ed.get_total_lines() == 5);
+    CHECK(ed.get_line(2) == " dog ");
+    CHECK(ed.get_cursor_row() == 1); // moved to where the match was
+    CHECK(ed.get_cursor_col() == 1);
+
+    CHECK(ed.replace_all("zebra", "x") == 0);
+    CHECK(ed.replace_all("", "x") == 0);
+}
+
+TEST_CASE("Editor: Apply a batch of edits", "[editor]")
+{
+    AL::editor ed;
+    ed.insert_text("alpha beta\ngamma delta");
+    ed.set_cursor_to_index(17); // the 'd' in "delta"
+
+    // "alpha" -> "a", "beta" -> "b\nb", an insert right at the cursor
+    REQUIRE(ed.apply_edits({{.position = 0, .delete_length = 5, .insert_text = "a"},
+                            {.position = 6, .delete_length = 4, .insert_text = "b\nb"},
+                            {.position = 17, .delete_length = 0, .insert_text = "new "}}));
+    CHECK(ed.get_line(1) == "a b");
+    CHECK(ed.get_line(2) == "b");
+    CHECK(ed.get_line(3) == "gamma new delta");
+    CHECK(ed.get_cursor_row() == 3); // still on the 'd'
+    CHECK(ed.get_cursor_col() == 11);
+
+    // a cursor inside a deleted range moves to its start
+    ed.set_cursor_to_index(2);
+    REQUIRE(ed.apply_edits({{.position = 0, .delete_length = 3, .insert_text = "xyz"}}));
+    CHECK(ed.get_line(1) == "xyz");
+    CHECK(ed.get_cursor_col() == 1);
+
+    CHECK_FALSE(ed.apply_edits({{.position = 4, .delete_length = 0, .insert_text = "x"}, {.position = 1, .delete_length = 0, .insert_text = "y"}}));
+    CHECK(ed.get_line(1) == "xyz");
+}
+
+TEST_CASE("Editor: Multiple cursors", "[editor]")
+{
+    AL::editor ed;
+    ed.insert_text("one\ntwo\nthree\nfour");
+    ed.move_to_document_start();
+
+    // a column of cursors at the start of the first three lines
+    ed.add_cursor_below();
+    ed.add_cursor_below();
+    CHECK(ed.get_cursor_count() == 3);
+    CHECK(ed.get_cursor_row() == 3);
+    CHECK(ed.get_cursor_indices() == std::vector<size_t>{0, 4, 8});
+
+    for (char c : std::string("- "))
+        ed.insert_char(c);
+    CHECK(ed.get_cursor_indices() == std::vector<size_t>{2, 8, 14}); // pending text included
+    CHECK(ed.get_cursor_col() == 3);
+
+    ed.delete_char(); // pops the pending space everywhere
+    ed.insert_char('>');
+    ed.flush_cursor_batch();
+    CHECK(ed.get_line(1) == "->one");
+    CHECK(ed.get_line(2) == "->two");
+    CHECK(ed.get_line(3) == "->three");
+    CHECK(ed.get_line(4) == "four");
+    CHECK(ed.get_cursor_row() == 3);
+    CHECK(ed.get_cursor_col() == 3);
+
+    // past the pending text, backspace removes a byte before every cursor in one batch
+    ed.delete_char();
+    ed.delete_char();
+    CHECK(ed.get_line(1) == "one");
+    CHECK(ed.get_line(3) == "three");
+    CHECK(ed.get_cursor_col() == 1);
+
+    // newlines move the main cursor down by one row per cursor at or before it
+    ed.insert_char('\n');
+    CHECK(ed.get_cursor_row() == 6);
+    CHECK(ed.get_cursor_col() == 1);
+    ed.flush_cursor_batch();
+    CHECK(ed.get_line(1) == "");
+    CHECK(ed.get_line(2) == "one");
+    CHECK(ed.get_line(5) == "");
+    CHECK(ed.get_line(6) == "three");
+
+    // backspace joins them again, cursors at the start of the document stay put
+    ed.delete_char();
+    CHECK(ed.get_line(1) == "one");
+    CHECK(ed.get_line(3) == "three");
+    CHECK(ed.get_cursor_row() == 3);
+
+    // two cursors on one line both push the column
+    ed.clear_extra_cursors();
+    CHECK(ed.get_cursor_count() == 1);
+    ed.set_cursor_to_index(6); // "tw|o"
+    ed.add_cursor(4);          // "|two"
+    ed.add_cursor(6);          // already there
+    CHECK(ed.get_cursor_count() == 2);
+    ed.insert_char('_');
+    ed.insert_char('_');
+    CHECK(ed.get_cursor_col() == 7);
+    std::vector<size_t> cols;
+    ed.get_cursor_batch_columns(2, cols); // still pending, drawn by the tui at both cursors
+    CHECK(ed.get_cursor_batch_text() == "__");
+    CHECK(cols == std::vector<size_t>{1, 3});
+    CHECK(ed.get_line(2) == "two");
+    ed.get_cursor_batch_columns(1, cols);
+    CHECK(cols.empty());
+    ed.flush_cursor_batch();
+    CHECK(ed.get_line(2) == "__tw__o");
+    CHECK(ed.get_cursor_indices() == std::vector<size_t>{6, 10});
+
+    ed.delete_char();
+    ed.delete_char();
+    CHECK(ed.get_line(2) == "two");
+    CHECK(ed.get_cursor_indices() == std::vector<size_t>{4, 6});
+
+    // backspacing into each other merges them
+    ed.clear_extra_cursors();
+    ed.add_cursor(5); // "t|w|o"
+    ed.delete_char();
+    CHECK(ed.get_line(2) == "o");
+    CHECK(ed.get_cursor_count() == 1);
+
+    // other edits drop the extra cursors
+    ed.add_cursor(0);
+    ed.insert_text("x");
+    CHECK(ed.get_cursor_count() == 1);
+}
+
+TEST_CASE("Editor: Anchors see pending typing", "[editor][anchor_tree]")
+{
+    AL::editor ed;
+    ed.insert_text("first\nsecond");
+    const AL::anchor_id mark = ed.add_anchor(6);
+
+    ed.move_to_document_start();
+    ed.insert_char('>'); // still in the insert buffer
+    ed.insert_char(' ');
+    CHECK(ed.get_anchor_index(mark) == 8);
+    CHECK(ed.get_anchor_position(mark).line == 2);
+    CHECK(ed.get_anchor_position(mark).col == 1);
+}
+
+TEST_CASE("Editor: Copy, cut and paste", "[editor]")
+{
+    AL::editor ed;
+    ed.insert_text("alpha\nbeta\n");
+    ed.copy_range(0, 6);
+    CHECK(ed.get_clipboard_length() == 6);
+
+    REQUIRE(ed.paste()); // at the end
+    CHECK(ed.get_total_lines() == 4);
+    CHECK(ed.get_line(3) == "alpha");
+    CHECK(ed.get_cursor_row() == 4);
+    CHECK(ed.get_cursor_col() == 1);
+    CHECK(ed.is_dirty());
+
+    ed.cut_range(6, 11); // "beta\n"
+    CHECK(ed.get_line(2) == "alpha");
+    CHECK(ed.get_cursor_row() == 3);
+
+    ed.move_to_document_start();
+    ed.insert_char('>');
+    REQUIRE(ed.paste()); // flushes the typing first
+    CHECK(ed.get_line(1) == ">beta");
+    CHECK(ed.get_line(2) == "alpha");
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 1);
+}
+
+TEST_CASE("Editor: Sort lines", "[editor][thread_pool]")
+{
+    AL::editor ed;
+    ed.insert_text("cherry\nbanana\napple\nbanana");
+    ed.goto_line(2);
+    CHECK(ed.sort_lines(true) == 3);
+    CHECK(ed.get_total_lines() == 3);
+    CHECK(ed.get_line(1) == "apple");
+    CHECK(ed.get_line(3) == "cherry");
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 1);
+    CHECK(ed.is_dirty());
+}
+
+#if MINIEDITOR_POSIX_IO
+static ino_t get_inode(const std::filesystem::path& path)
+{
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? st.st_ino : 0;
+}
+
+TEST_CASE("Editor: Save in place", "[editor]")
+{
+    // fixed width records, patched without changing the length
+    std::string content;
+    for (int i = 0; i < 20; ++i)
+        content += "record " + std::to_string(1000 + i) + " value AAAA\n";
+    auto path = create_temp_file("test_save_in_place.txt", content);
+    auto wal_path = path;
+    wal_path += ".wal";
+    const ino_t inode = get_inode(path);
+
+    AL::editor ed;
+    REQUIRE(ed.open(path));
+    ed.copy_range(18, 22); // the first "AAAA", as ORIGINAL pieces
+    ed.delete_range(18, 22);
+    ed.set_cursor_to_index(18);
+    ed.insert_text("BBBB");
+    ed.delete_range(40, 44);
+    ed.set_cursor_to_index(40);
+    ed.insert_text("CCCC");
+    CHECK(ed.save());
+    content.replace(18, 4, "BBBB");
+    content.replace(40, 4, "CCCC");
+    CHECK(read_file_content(path) == content);
+    CHECK(get_inode(path) == inode);
+    CHECK_FALSE(std::filesystem::exists(wal_path));
+
+    // the original pieces are back, but the file has the first patch in it, so that is written again
+    ed.delete_range(18, 22);
+    ed.set_cursor_to_index(18);
+    REQUIRE(ed.paste());
+    CHECK(ed.save());
+    content.replace(18, 4, "AAAA");
+    CHECK(read_file_content(path) == content);
+    CHECK(get_inode(path) == inode);
+
+    // a different length is a full rewrite
+    ed.set_cursor_to_index(0);
+    ed.insert_text("#");
+    CHECK(ed.save());
+    CHECK(read_file_content(path) == "#" + content);
+    CHECK(get_inode(path) != inode);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: CRLF files keep their line endings", "[editor]")
+{
+    const std::string content = "abc\r\ndef\r\nlone\rcr\r\n";
+    auto path = create_temp_file("test_crlf.txt", content);
+    const ino_t inode = get_inode(path);
+
+    AL::editor ed;
+    REQUIRE(ed.open(path));
+    CHECK(ed.get_line(1) == "abc");
+    CHECK(ed.get_line(3) == "lone\rcr"); // only the '\r' before a '\n' belongs to the line break
+    CHECK(ed.get_total_lines() == 4);
+
+    // the cursor steps over "\r\n" as one character
+    ed.move_to_line_end();
+    CHECK(ed.get_cursor_col() == 4);
+    ed.move_cursor(AL::direction::RIGHT);
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 1);
+    CHECK(ed.get_cursor_indices().front() == 5);
+    ed.move_cursor(AL::direction::LEFT);
+    CHECK(ed.get_cursor_indices().front() == 3);
+    ed.set_cursor_to_index(4); // between '\r' and '\n'
+    CHECK(ed.get_cursor_indices().front() == 3);
+    CHECK(ed.get_cursor_col() == 4);
+
+    // same length edits are patched into the file, which keeps every other byte
+    ed.delete_range(5, 8);
+    ed.set_cursor_to_index(5);
+    ed.insert_text("DEF");
+    REQUIRE(ed.save());
+    CHECK(read_file_content(path) == "abc\r\nDEF\r\nlone\rcr\r\n");
+    CHECK(get_inode(path) == inode);
+
+    // typed and pasted newlines go in as "\r\n", backspace takes a line break as a whole
+    ed.set_cursor_to_index(3);
+    ed.insert_char('\n');
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_indices().front() == 5);
+    ed.insert_text("x\ny");
+    CHECK(ed.get_line(3) == "y");
+    CHECK(ed.get_cursor_col() == 2);
+    ed.delete_char();
+    ed.delete_char();
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 2);
+    ed.delete_char();
+    ed.delete_char();
+    CHECK(ed.get_cursor_row() == 1);
+    CHECK(ed.get_cursor_indices().front() == 3);
+    ed.insert_char('!');
+    ed.move_to_document_end();
+    ed.insert_char('\n');
+    REQUIRE(ed.save());
+    CHECK(read_file_content(path) == "abc!\r\nDEF\r\nlone\rcr\r\n\r\n");
+
+    // every cursor types and removes "\r\n" the same way
+    ed.set_cursor_to_index(0);
+    ed.add_cursor(6);
+    ed.insert_char('\n');
+    ed.flush_cursor_batch();
+    CHECK(ed.get_cursor_indices() == std::vector<size_t>{2, 10});
+    CHECK(ed.get_line(1).empty());
+    CHECK(ed.get_line(3).empty());
+    ed.delete_char();
+    CHECK(ed.get_cursor_count() == 2);
+    ed.clear_extra_cursors();
+    REQUIRE(ed.save());
+    CHECK(read_file_content(path) == "abc!\r\nDEF\r\nlone\rcr\r\n\r\n");
+
+    // a range delete that leaves the cursor between a '\r' and a '\n' puts it in front of them
+    ed.set_cursor_to_index(17); // "lone\rc|r"
+    ed.delete_range(16, 19);
+    CHECK(ed.get_line(3) == "lone");
+    CHECK(ed.get_cursor_indices().front() == 15);
+    CHECK(ed.get_cursor_row() == 3);
+    CHECK(ed.get_cursor_col() == 5);
+    ed.insert_char('!');
+    ed.flush_buffers();
+    CHECK(ed.get_line(3) == "lone!");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Open finishes an interrupted in-place save", "[editor]")
+{
+    auto path = create_temp_file("test_wal_replay.txt", "hello world\n");
+    auto wal_path = path;
+    wal_path += ".wal";
+    auto write_log = [&](const std::string& log) {
+        std::ofstream ofs(wal_path, std::ios::binary);
+        ofs << log;
+    };
+    auto append_u64 = [](std::string& out, uint64_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+
+    // magic, file size, record count, then offset, length and bytes, then the FNV-1a hash
+    std::string log = "MEWAL001";
+    append_u64(log, 12);
+    append_u64(log, 1);
+    append_u64(log, 6);
+    append_u64(log, 5);
+    log += "WORLD";
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : log)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    std::string good = log;
+    append_u64(good, hash);
+
+    SECTION("A complete log is applied")
+    {
+        write_log(good);
+        AL::editor ed;
+        REQUIRE(ed.open(path));
+        CHECK(ed.get_line(1) == "hello WORLD");
+        CHECK(read_file_content(path) == "hello WORLD\n");
+        CHECK_FALSE(std::filesystem::exists(wal_path));
+    }
+
+    SECTION("A torn log is dropped")
+    {
+        write_log(good.substr(0, good.size() - 3));
+        AL::editor ed;
+        REQUIRE(ed.open(path));
+        CHECK(ed.get_line(1) == "hello world");
+        CHECK_FALSE(std::filesystem::exists(wal_path));
+    }
+
+    std::filesystem::remove(path);
+}
+#endif // MINIEDITOR_POSIX_IO
+
+TEST_CASE("Editor: Journal brings back unsaved edits", "[editor][journal]")
+{
+    auto path = create_temp_file("test_journal_editor.txt", "first line\nsecond line\n");
+    auto journal_path = path;
+    journal_path += ".journal";
+
+    {
+        AL::editor ed;
+        REQUIRE(ed.open(path));
+        REQUIRE(ed.start_journal(AL::journal_sync::ALWAYS));
+        CHECK(ed.is_journaling());
+        ed.insert_char('>');
+        ed.insert_char(' ');
+        ed.move_cursor(AL::direction::DOWN); // flushes the typing
+        ed.delete_range(13, 20);             // "second "
+        ed.copy_range(0, 2);
+        ed.move_to_line_start();
+        REQUIRE(ed.paste());
+        CHECK(ed.get_line(1) == "> first line");
+        CHECK(ed.get_line(2) == "> line");
+        // no save: the editor goes away as if the session dropped
+    }
+    CHECK(read_file_content(path) == "first line\nsecond line\n");
+    REQUIRE(std::filesystem::exists(journal_path));
+
+    AL::editor ed;
+    REQUIRE(ed.open(path));
+    CHECK(ed.is_dirty());
+    CHECK(ed.is_journaling());
+    CHECK(ed.get_line(1) == "> first line");
+    CHECK(ed.get_line(2) == "> line");
+
+    // the save has it all, so the journal starts over and replays nothing
+    REQUIRE(ed.save());
+    CHECK(read_file_content(path) == "> first line\n> line\n");
+    {
+        AL::editor reopened;
+        REQUIRE(reopened.open(path));
+        CHECK_FALSE(reopened.is_dirty());
+        CHECK(reopened.get_line(2) == "> line");
+    }
+
+    ed.stop_journal();
+    CHECK_FALSE(std::filesystem::exists(journal_path));
+
+    // only a saved file can start one
+    ed.insert_char('x');
+    CHECK_FALSE(ed.start_journal());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Save in the background", "[editor][journal]")
+{
+    std::string content;
+    for (int i = 0; i < 5'000; ++i)
+        content += "line " + std::to_string(i) + "\n";
+    auto path = create_temp_file("test_save_async.txt", content);
+    auto journal_path = path;
+    journal_path += ".journal";
+
+    {
+        AL::editor ed;
+        REQUIRE(ed.open(path));
+        REQUIRE(ed.start_journal(AL::journal_sync::ALWAYS));
+        ed.insert_text("first\n");
+        ed.copy_range(0, 6);
+        REQUIRE(ed.save_async());
+        CHECK(ed.is_saving());
+        CHECK(ed.get_save_length() == content.length() + 6);
+        CHECK_FALSE(ed.is_dirty());
+        CHECK_FALSE(ed.save_async()); // one at a time
+
+        // editing goes on while it writes, and none of it is in the file
+        ed.move_to_document_end();
+        ed.insert_text("last\n");
+        REQUIRE(ed.paste());
+        CHECK(ed.is_dirty());
+
+        CHECK(ed.wait_for_save());
+        CHECK_FALSE(ed.is_saving());
+        CHECK(ed.poll_save() == AL::save_status::NONE);
+        CHECK(read_file_content(path) == "first\n" + content);
+        CHECK(ed.is_dirty());
+        CHECK(ed.is_journaling());
+        // no save of the rest: it is only in the journal
+    }
+
+    AL::editor ed;
+    REQUIRE(ed.open(path));
+    CHECK(ed.is_dirty());
+    CHECK(ed.get_line(5'002) == "last");
+    CHECK(ed.get_line(5'003) == "first");
+
+    // poll_save reports the end once
+    REQUIRE(ed.save_async());
+    AL::save_status status = ed.poll_save();
+    while (status == AL::save_status::RUNNING)
+        status = ed.poll_save();
+    CHECK(status == AL::save_status::DONE);
+    CHECK(ed.poll_save() == AL::save_status::NONE);
+    CHECK_FALSE(ed.is_dirty());
+    CHECK(read_file_content(path) == "first\n" + content + "last\nfirst\n");
+    ed.stop_journal();
+    CHECK_FALSE(std::filesystem::exists(journal_path));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Autosave leaves a copy to recover", "[editor][autosave]")
+{
+    const std::string content = "first line\nsecond line\n";
+    auto path = create_temp_file("test_autosave_editor.txt", content);
+    auto autosave_path = path;
+    autosave_path += ".autosave";
+
+    const auto autosave_now = [](AL::editor& ed) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        ed.autosave_tick();
+        while (ed.is_autosaving())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ed.autosave_tick();
+        }
+    };
+
+    {
+        AL::editor ed;
+        REQUIRE(ed.open(path));
+        CHECK_FALSE(ed.has_recovery());
+        ed.set_autosave(std::chrono::milliseconds(1), 0);
+        autosave_now(ed);
+        CHECK_FALSE(std::filesystem::exists(autosave_path)); // nothing changed
+
+        ed.insert_char('>');
+        ed.insert_char(' ');
+        autosave_now(ed); // typing still in the insert buffer goes in too
+        CHECK(read_file_content(autosave_path) == "> " + content);
+        // the session drops here without saving
+    }
+    CHECK(read_file_content(path) == content);
+
+    {
+        AL::editor ed;
+        REQUIRE(ed.open(path));
+        CHECK(ed.has_recovery());
+        CHECK_FALSE(ed.is_dirty());
+        REQUIRE(ed.recover());
+        CHECK_FALSE(ed.has_recovery());
+        CHECK(ed.is_dirty());
+        CHECK(ed.get_line(1) == "> first line");
+
+        // saving makes the copy pointless
+        REQUIRE(ed.save());
+        CHECK_FALSE(std::filesystem::exists(autosave_path));
+        CHECK(read_file_content(path) == "> " + content);
+    }
+
+    // a copy nobody wants is removed
+    {
+        std::ofstream ofs(autosave_path, std::ios::binary);
+        ofs << "stale";
+    }
+    AL::editor ed;
+    REQUIRE(ed.open(path));
+    REQUIRE(ed.has_recovery());
+    ed.discard_recovery();
+    CHECK_FALSE(std::filesystem::exists(autosave_path));
+    CHECK(ed.get_line(1) == "> first line");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Streaming open", "[editor][file_loader]")
+{
+    std::string content;
+    for (int i = 0; content.length() < 12 * 1024 * 1024; ++i)
+        content += "line " + std::to_string(i) + "\n";
+    auto path = create_temp_file("test_streaming_open.txt", content);
+
+    AL::editor ed;
+    REQUIRE(ed.begin_open(path));
+    CHECK(ed.get_line(1) == "line 0"); // the first screen is in
+    CHECK(ed.get_load_length() == content.length());
+
+    // edits go on while the rest comes in
+    ed.insert_text("head\n");
+    while (ed.poll_load())
+        ;
+    CHECK_FALSE(ed.is_loading());
+    CHECK(ed.get_load_progress() == content.length());
+    CHECK(ed.get_line(1) == "head");
+    CHECK(ed.get_total_lines() == AL::piece_table(content).get_line_count() + 2);
+
+    // saving needs the whole file, and the unchanged file is still good for an in place save
+    ed.delete_range(0, 9); // "head\nline"
+    ed.set_cursor_to_index(0);
+    ed.insert_text("LINE");
+    REQUIRE(ed.save());
+    CHECK(read_file_content(path) == "LINE" + content.substr(4));
+
+    // a save waits for a load that is still going
+    REQUIRE(ed.begin_open(path));
+    ed.move_to_document_end();
+    CHECK_FALSE(ed.is_loading());
+    ed.insert_text("tail\n");
+    REQUIRE(ed.save());
+    CHECK(read_file_content(path) == "LINE" + content.substr(4) + "tail\n");
+    std::filesystem::remove(path);
+
+    // the '\r' of an LF file are stripped on the way in like a blocking open does
+    path = create_temp_file("test_streaming_open_crlf.txt", "one\ntwo\r\n");
+    REQUIRE(ed.open(path));
+    CHECK(ed.get_line(2) == "two");
+    ed.insert_char('>');
+    REQUIRE(ed.save());
+    CHECK(read_file_content(path) == ">one\ntwo\n");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Editor: Session snapshot restores the edited document", "[editor][snapshot]")
+{
+    std::string content;
+    for (int i = 0; i < 1000; ++i)
+        content += "entry " + std::to_string(i) + "\n";
+    auto path = create_temp_file("test_session_editor.txt", content);
+    auto session_path = path;
+    session_path += ".session";
+
+    std::string edited;
+    {
+        AL::editor ed;
+        REQUIRE(ed.open(path));
+        REQUIRE(ed.start_journal(AL::journal_sync::NONE));
+        ed.goto_line(500);
+        ed.insert_text("inserted\n");
+        ed.delete_range(0, 6);
+        REQUIRE(ed.save_session());
+        CHECK(std::filesystem::exists(session_path));
+
+        // after the snapshot, in the journal on top of it
+        ed.goto_line(3);
+        ed.insert_char('#');
+        ed.flush_insert_buffer();
+        edited = ed.get_line(3) + "|" + ed.get_line(500);
+        CHECK(edited == "#entry 2|inserted");
+    }
+
+    AL::editor ed;
+    REQUIRE(ed.open(path));
+    CHECK(ed.is_dirty());
+    CHECK(ed.get_line(1) == "0");
+    CHECK(ed.get_line(3) + "|" + ed.get_line(500) == edited);
+    CHECK(ed.get_total_lines() == 1002);
+    CHECK(ed.get_cursor_row() == 501); // where it was in the snapshot
+
+    REQUIRE(ed.save());
+    CHECK_FALSE(std::filesystem::exists(session_path));
+    ed.stop_journal();
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,106 @@
+#include <catch2/catch_test_macros.hpp>
+#include <file_loader.h>
+#include <filesystem>
+#include <fstream>
+#include <piecetable.h>
+#include <string>
+#include <vector>
+
+static std::filesystem::path write_file(const std::string& name, const std::string& content)
+{
+    const auto path = std::filesystem::temp_directory_path() / name;
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << content;
+    return path;
+}
+
+TEST_CASE("file_loader: Streams a file into the original buffer", "[file_loader]")
+{
+    // several chunks, with '\r' to strip on both sides of a chunk boundary. the first line makes it an LF file
+    std::string content = "header\n";
+    for (int i = 0; content.length() < 9 * 1024 * 1024; ++i)
+        content += "line " + std::to_string(i) + (i % 3 == 0 ? "\r\n" : "\n");
+    const auto path = write_file("test_file_loader.txt", content);
+
+    AL::piece_table pt;
+    AL::file_loader loader;
+    char* buffer = pt.begin_original(content.length());
+    REQUIRE(loader.start(path, buffer, content.length()));
+
+    std::vector<AL::piece> pieces;
+    size_t batches = 0;
+    while (true)
+    {
+        const bool done = loader.is_done();
+        pieces.clear();
+        if (loader.take_pieces(pieces))
+        {
+            pt.append_original(pieces);
+            ++batches;
+        }
+        if (done)
+            break;
+        loader.wait_for_pieces();
+    }
+    loader.cancel();
+    pt.end_original(loader.get_bytes_read());
+
+    CHECK(batches >= 1);
+    CHECK_FALSE(loader.failed());
+    CHECK(loader.has_carriage_returns());
+    CHECK(loader.get_bytes_read() == content.length());
+    CHECK(pt.to_string() == AL::piece_table(content).to_string());
+    CHECK(pt.get_line_count() == AL::piece_table(content).get_line_count());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("file_loader: A CRLF file is read as it is", "[file_loader]")
+{
+    std::string content;
+    for (int i = 0; content.length() < 5 * 1024 * 1024; ++i)
+        content += "line " + std::to_string(i) + "\r\n";
+    const auto path = write_file("test_file_loader_crlf.txt", content);
+
+    AL::piece_table pt;
+    AL::file_loader loader;
+    char* buffer = pt.begin_original(content.length());
+    REQUIRE(loader.start(path, buffer, content.length()));
+    loader.wait_for_pieces();
+    CHECK(loader.get_line_ending() == AL::line_ending::CRLF);
+    pt.set_line_ending(loader.get_line_ending());
+    std::vector<AL::piece> pieces;
+    while (!loader.is_done())
+        loader.wait_for_pieces();
+    loader.take_pieces(pieces);
+    pt.append_original(pieces);
+    pt.end_original(loader.get_bytes_read());
+
+    CHECK_FALSE(loader.has_carriage_returns());
+    CHECK(pt.to_string() == content);
+    CHECK(pt.get_line(2) == "line 1");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("file_loader: A file that got shorter ends early", "[file_loader]")
+{
+    const auto path = write_file("test_file_loader_short.txt", "only this\n");
+    AL::piece_table pt;
+    AL::file_loader loader;
+    char* buffer = pt.begin_original(100);
+    REQUIRE(loader.start(path, buffer, 100));
+    loader.wait_for_pieces();
+    while (!loader.is_done())
+        loader.wait_for_pieces();
+
+    std::vector<AL::piece> pieces;
+    loader.take_pieces(pieces);
+    pt.append_original(pieces);
+    pt.end_original(loader.get_bytes_read());
+    CHECK_FALSE(loader.failed());
+    CHECK_FALSE(loader.has_carriage_returns());
+    CHECK(loader.get_bytes_read() == 10);
+    CHECK(pt.to_string() == "only this\n");
+    std::filesystem::remove(path);
+
+    CHECK_FALSE(loader.start(path, buffer, 100)); // gone
+}
@@ -2,6 +2,7 @@
 #include <cstddef>
 #include <implicit_treap.h>
 #include <string>
+#include <vector>
 
 using implicit_treap = AL::implicit_treap;
 using buffer_type = AL::buffer_type;
@@ -118,3 +119,66 @@ TEST_CASE("implicit_treap Edge Cases", "[ImplicitTreap]")
     CHECK(treap.size() == 0);
     CHECK(treap.empty() == true);
 }
+
+TEST_CASE("implicit_treap Build", "[ImplicitTreap]")
+{
+    implicit_treap treap;
+    treap.insert(0, {.buf_type = buffer_type::ORIGINAL, .start = 0, .length = 7, .newline_count = 1}, split_func);
+
+    std::vector<AL::piece> pieces;
+    size_t expected_length = 0;
+    for (size_t i = 0; i < 10'000; ++i)
+    {
+        // zero length pieces are dropped
+        pieces.push_back({.buf_type = buffer_type::ADD, .start = i, .length = i % 3, .newline_count = i % 2});
+        expected_length += i % 3;
+    }
+
+    treap.build(pieces);
+    CHECK(treap.size() == expected_length);
+
+    std::vector<AL::piece> out;
+    treap.get_pieces(out);
+    REQUIRE(out.size() == 10'000 - 3334);
+    size_t newlines = 0;
+    bool in_order = true;
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        newlines += out[i].newline_count;
+        in_order = in_order && (i == 0 || out[i].start > out[i - 1].start);
+    }
+    CHECK(in_order);
+    CHECK(treap.get_newline_count() == newlines);
+
+    // the result is an ordinary treap
+    treap.erase(0, 1, split_func);
+    CHECK(treap.size() == expected_length - 1);
+
+    treap.build({});
+    CHECK(treap.empty());
+}
+
+TEST_CASE("implicit_treap Insert pieces", "[ImplicitTreap]")
+{
+    implicit_treap treap;
+    treap.insert(0, {.buf_type = buffer_type::ORIGINAL, .start = 0, .length = 10, .newline_count = 0}, split_func);
+
+    std::vector<AL::piece> pieces;
+    for (size_t i = 0; i < 1'000; ++i)
+        pieces.push_back({.buf_type = buffer_type::ADD, .start = i * 2, .length = 2, .newline_count = 1});
+
+    treap.insert_pieces(4, pieces, split_func); // splits the original piece
+    CHECK(treap.size() == 2'010);
+    CHECK(treap.get_newline_count() == 1'000);
+
+    std::vector<AL::piece> out;
+    treap.get_pieces(out);
+    REQUIRE(out.size() == 1'002);
+    CHECK(out.front().length == 4);
+    CHECK(out.back().start == 4);
+    CHECK(out[1].start == 0);
+    CHECK(out[1'000].start == 1'998);
+
+    treap.insert_pieces(0, {}, split_func);
+    CHECK(treap.size() == 2'010);
+}
@@ -0,0 +1,169 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <filesystem>
+#include <journal.h>
+#include <piecetable.h>
+#include <random>
+#include <string>
+#include <thread_pool.h>
+#include <vector>
+
+// the same edits go to a document and the journal, then get replayed onto a fresh copy of the original
+TEST_CASE("journal: Replay rebuilds the document", "[journal]")
+{
+    const std::string original = "delta\nalpha\ncharlie\nbravo\n";
+    const auto path = std::filesystem::temp_directory_path() / "test_journal_replay.journal";
+
+    AL::piece_table pt(original);
+    AL::journal log;
+    REQUIRE(log.create(path, original.size(), 42, AL::journal_sync::NONE));
+    REQUIRE(log.is_open());
+
+    pt.insert(0, "echo\n");
+    log.record_insert(0, "echo\n");
+    pt.remove(5, 6);
+    log.record_remove(5, 6);
+    const std::vector<size_t> matches = {5, 11};
+    pt.replace_all(matches, 1, "A");
+    log.record_replace_all(matches, 1, "A");
+
+    const std::vector<AL::text_edit> edits = {{.position = 0, .delete_length = 1, .insert_text = "E"}, {.position = 8, .delete_length = 0, .insert_text = "!"}};
+    REQUIRE(pt.apply_edits(edits));
+    log.record_edits(edits);
+
+    const AL::piece_range clipboard = pt.copy_range(0, 5);
+    log.record_copy(0, 5);
+    CHECK(log.has_clipboard());
+    REQUIRE(pt.paste_range(pt.length(), clipboard));
+    log.record_paste(pt.length() - 5);
+
+    pt.sort_lines(AL::get_thread_pool(), true);
+    log.record_sort_lines(true);
+    log.close();
+    CHECK_FALSE(log.is_open());
+
+    AL::piece_table replayed(original);
+    AL::journal resumed;
+    CHECK(resumed.resume(path, original.size(), 42, replayed, AL::journal_sync::NONE) == 7);
+    CHECK(replayed.to_string() == pt.to_string());
+    CHECK(resumed.is_open());
+    CHECK_FALSE(resumed.has_clipboard());
+
+    // and it keeps going from there
+    pt.insert(pt.length(), "zulu\n");
+    resumed.record_insert(replayed.length(), "zulu\n");
+    resumed.close();
+    AL::piece_table again(original);
+    CHECK(resumed.resume(path, original.size(), 42, again, AL::journal_sync::NONE) == 8);
+    CHECK(again.to_string() == pt.to_string());
+
+    resumed.discard();
+    CHECK_FALSE(std::filesystem::exists(path));
+}
+
+TEST_CASE("journal: A torn tail is cut off", "[journal]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "test_journal_torn.journal";
+    AL::journal log;
+    REQUIRE(log.create(path, 3, 7, AL::journal_sync::ALWAYS));
+    log.record_insert(3, " one");
+    log.record_insert(7, " two");
+    log.close();
+
+    // the crash hit the middle of the last record
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 2);
+    AL::piece_table pt("abc");
+    REQUIRE(log.resume(path, 3, 7, pt, AL::journal_sync::ALWAYS) == 1);
+    CHECK(pt.to_string() == "abc one");
+
+    log.record_insert(7, " three");
+    log.close();
+    AL::piece_table again("abc");
+    CHECK(log.resume(path, 3, 7, again, AL::journal_sync::ALWAYS) == 2);
+    CHECK(again.to_string() == "abc one three");
+    log.discard();
+}
+
+TEST_CASE("journal: A journal for another version of the file is dropped", "[journal]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "test_journal_stale.journal";
+    AL::journal log;
+    REQUIRE(log.create(path, 3, 7, AL::journal_sync::NONE));
+    log.record_insert(0, "x");
+    log.close();
+
+    AL::piece_table pt("abc");
+    CHECK(log.resume(path, 3, 8, pt, AL::journal_sync::NONE) == -1);
+    CHECK(pt.to_string() == "abc");
+    CHECK_FALSE(log.is_open());
+    CHECK_FALSE(std::filesystem::exists(path));
+}
+
+TEST_CASE("journal: Random edits replay exactly", "[journal]")
+{
+    std::string original;
+    for (int i = 0; i < 2000; ++i)
+        original += "line " + std::to_string(i) + "\n";
+    const auto path = std::filesystem::temp_directory_path() / "test_journal_random.journal";
+
+    AL::piece_table pt(original);
+    AL::journal log;
+    REQUIRE(log.create(path, original.size(), 1, AL::journal_sync::NONE));
+    std::mt19937 rng(5);
+    for (int i = 0; i < 3000; ++i)
+    {
+        const size_t position = rng() % (pt.length() + 1);
+        if (rng() % 2 == 0 || position == pt.length())
+        {
+            const std::string text(1 + rng() % 8, static_cast<char>('a' + i % 26));
+            pt.insert(position, text);
+            log.record_insert(position, text);
+        }
+        else
+        {
+            const size_t length = 1 + rng() % std::min<size_t>(20, pt.length() - position);
+            pt.remove(position, length);
+            log.record_remove(position, length);
+        }
+    }
+    log.close();
+
+    AL::piece_table replayed(original);
+    CHECK(log.resume(path, original.size(), 1, replayed, AL::journal_sync::NONE) == 3000);
+    CHECK(replayed.to_string() == pt.to_string());
+    log.discard();
+}
+
+TEST_CASE("journal: Rebase keeps the records after the checkpoint", "[journal]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "test_journal_rebase.journal";
+    const auto moved_path = std::filesystem::temp_directory_path() / "test_journal_rebase_moved.journal";
+    AL::piece_table pt("abc");
+    AL::journal log;
+    REQUIRE(log.create(path, 3, 1, AL::journal_sync::NONE));
+    pt.insert(3, "def");
+    log.record_insert(3, "def");
+    log.record_copy(0, 2);
+    CHECK(log.has_clipboard());
+
+    // "abcdef" gets saved from here, the edits after it go on top of the saved file
+    const std::string saved = pt.to_string();
+    const uint64_t checkpoint = log.checkpoint();
+    CHECK_FALSE(log.has_clipboard()); // a paste now would point at the copy before the checkpoint
+    pt.insert(0, ">");
+    log.record_insert(0, ">");
+    pt.remove(3, 2);
+    log.record_remove(3, 2);
+
+    REQUIRE(log.rebase(moved_path, checkpoint, saved.size(), 2));
+    CHECK(log.get_path() == moved_path);
+    CHECK_FALSE(std::filesystem::exists(path));
+    pt.insert(pt.length(), "!");
+    log.record_insert(pt.length() - 1, "!");
+    log.close();
+
+    AL::piece_table replayed(saved);
+    CHECK(log.resume(moved_path, saved.size(), 2, replayed, AL::journal_sync::NONE) == 3);
+    CHECK(replayed.to_string() == pt.to_string());
+    log.discard();
+}
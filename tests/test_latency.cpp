@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <initializer_list>
+#include <latency.h>
+#include <sstream>
+
+using latency_histogram = AL::latency_histogram;
+
+TEST_CASE("latency_histogram: Empty histogram", "[latency]")
+{
+    latency_histogram h;
+    CHECK(h.count() == 0);
+    CHECK(h.percentile(50) == 0);
+    CHECK(h.min() == 0);
+    CHECK(h.max() == 0);
+    CHECK(h.mean() == 0);
+}
+
+TEST_CASE("latency_histogram: Bucketing", "[latency]")
+{
+    SECTION("Small values are exact")
+    {
+        for (uint64_t v = 0; v < 2 * latency_histogram::SUB_BUCKET_COUNT; ++v)
+        {
+            CHECK(latency_histogram::bucket_index(v) == v);
+            CHECK(latency_histogram::bucket_highest_value(v) == v);
+        }
+    }
+
+    SECTION("Bucket bounds contain the value within the relative error")
+    {
+        for (const uint64_t v : std::initializer_list<uint64_t>{100, 1000, 12345, 999999, 123456789, UINT64_MAX})
+        {
+            const uint64_t upper = latency_histogram::bucket_highest_value(latency_histogram::bucket_index(v));
+            CHECK(upper >= v);
+            CHECK(upper - v <= v / latency_histogram::SUB_BUCKET_COUNT);
+        }
+    }
+
+    SECTION("Indices are monotonic and in range")
+    {
+        size_t last = 0;
+        for (uint64_t v = 1; v < (1ULL << 40); v = v * 3 + 1)
+        {
+            const size_t idx = latency_histogram::bucket_index(v);
+            CHECK(idx >= last);
+            CHECK(idx < latency_histogram::BUCKET_COUNT);
+            last = idx;
+        }
+    }
+}
+
+TEST_CASE("latency_histogram: Percentiles", "[latency]")
+{
+    latency_histogram h;
+    for (uint64_t v = 1; v <= 1000; ++v)
+        h.record(v * 1000); // 1us .. 1ms
+
+    CHECK(h.count() == 1000);
+    CHECK(h.min() == 1000);
+    CHECK(h.max() == 1000000);
+    CHECK(h.mean() == 500500);
+
+    const uint64_t p50 = h.percentile(50);
+    CHECK(p50 >= 500000);
+    CHECK(p50 <= 500000 + 500000 / latency_histogram::SUB_BUCKET_COUNT);
+
+    const uint64_t p99 = h.percentile(99);
+    CHECK(p99 >= 990000);
+    CHECK(p99 <= 1000000);
+
+    CHECK(h.percentile(100) == 1000000);
+
+    h.reset();
+    CHECK(h.count() == 0);
+}
+
+TEST_CASE("latency_registry: Summary only lists recorded ops", "[latency]")
+{
+    AL::latency_registry registry;
+    CHECK(registry.empty());
+
+    registry.get(AL::latency_op::RENDER).record(2000);
+    CHECK_FALSE(registry.empty());
+
+    std::ostringstream oss;
+    registry.write_summary(oss);
+    CHECK(oss.str() == "render 2/2/2 us");
+}
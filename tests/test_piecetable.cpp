@@ -1,8 +1,20 @@
 #include "piecetable.h"
+#include <algorithm>
 #include <catch2/catch_test_macros.hpp>
 #include <editor.h>
+#include <filesystem>
+#include <fstream>
 #include <implicit_treap.h>
 #include <piecetable.h>
+#include <random>
+#include <string>
+#include <thread_pool.h>
+#include <vector>
+
+#if MINIEDITOR_POSIX_IO
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using piece_table = AL::piece_table;
 using implicit_treap = AL::implicit_treap;
@@ -328,20 +340,53 @@ TEST_CASE("piece_table: Boundary delete operations", "[piecetable][edge]")
     }
 }
 
-TEST_CASE("piece_table: Windows line ending normalization", "[piecetable][edge]")
+TEST_CASE("piece_table: Windows line endings", "[piecetable][edge]")
 {
-    SECTION("CRLF normalization")
+    SECTION("CRLF is kept")
     {
         piece_table pt("line1\r\nline2\r\nline3");
-        CHECK(pt.to_string() == "line1\nline2\nline3");
+        CHECK(pt.get_line_ending() == AL::line_ending::CRLF);
+        CHECK(pt.to_string() == "line1\r\nline2\r\nline3");
         CHECK(pt.get_line_count() == 3);
+        CHECK(pt.get_line(1) == "line1");
+        const AL::line_info info = pt.get_line_info(2);
+        CHECK(info.start_byte == 7);
+        CHECK(info.length == 5);
+        CHECK(info.newline_length == 2);
+        CHECK(pt.get_line_info(3).newline_length == 0);
+
+        // inserted line breaks become "\r\n", stray '\r' are dropped
+        pt.insert(5, "\nmid\r");
+        pt.insert(pt.length(), "\r\nend");
+        CHECK(pt.to_string() == "line1\r\nmid\r\nline2\r\nline3\r\nend");
+        CHECK(pt.get_line(2) == "mid");
+        CHECK(pt.get_inserted_length("a\nb\r") == 4);
     }
 
-    SECTION("Mixed line endings")
+    SECTION("Mixed line endings follow the first line")
     {
-        piece_table pt("line1\r\nline2\nline3\r\n");
-        CHECK(pt.to_string() == "line1\nline2\nline3\n");
-        CHECK(pt.get_line_count() == 3);
+        piece_table crlf("line1\r\nline2\nline3\r\n");
+        CHECK(crlf.to_string() == "line1\r\nline2\nline3\r\n");
+        CHECK(crlf.get_line(2) == "line2");
+        CHECK(crlf.get_line_info(2).newline_length == 1);
+        CHECK(crlf.get_line_count() == 3);
+
+        piece_table lf("line1\nline2\r\nline3\r\n");
+        CHECK(lf.get_line_ending() == AL::line_ending::LF);
+        CHECK(lf.to_string() == "line1\nline2\nline3\n");
+        CHECK(lf.get_line_count() == 3);
+    }
+
+    SECTION("A '\r' and its '\n' in different pieces")
+    {
+        piece_table pt("a\r\nb\r\n");
+        pt.insert(2, "x"); // "a\rx\nb"
+        pt.remove(2, 1);
+        CHECK(pt.get_line(1) == "a");
+        CHECK(pt.get_line_info(1).newline_length == 2);
+        CHECK(pt.get_line(2) == "b");
+        pt.insert(pt.length(), "c\r"); // a '\r' with no '\n' after it is dropped
+        CHECK(pt.get_line(3) == "c");
     }
 }
 
@@ -367,3 +412,649 @@ TEST_CASE("piece_table: get_char_at edge cases", "[piecetable][edge]")
         CHECK(pt_empty.get_char_at(0) == '\0');
     }
 }
+
+TEST_CASE("piece_table: get_newline_count_before", "[piecetable]")
+{
+    piece_table pt("ab\ncd\n");
+    pt.insert(3, "x\ny");  // "ab\nx\nycd\n"
+    pt.insert(0, "\n");    // "\nab\nx\nycd\n"
+
+    const std::string text = pt.to_string();
+    for (size_t i = 0; i <= text.length() + 1; ++i)
+    {
+        const size_t end = std::min(i, text.length());
+        CHECK(pt.get_newline_count_before(i) == static_cast<size_t>(std::count(text.begin(), text.begin() + end, '\n')));
+    }
+
+    piece_table pt_empty;
+    CHECK(pt_empty.get_newline_count_before(0) == 0);
+}
+
+TEST_CASE("piece_table: Large original content is split into bounded pieces", "[piecetable]")
+{
+    std::string text;
+    for (int i = 0; i < 20000; ++i)
+        text += "line " + std::to_string(i + 1) + "\n";
+
+    piece_table pt(text);
+    REQUIRE(pt.length() == text.length());
+    CHECK(pt.to_string() == text);
+
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    CHECK(pieces.size() > 1);
+    for (const auto& p : pieces)
+        CHECK(p.length <= 16 * 1024);
+
+    CHECK(pt.get_line_count() == 20000);
+    CHECK(pt.get_line(1) == "line 1");
+    CHECK(pt.get_line(12345) == "line 12345");
+    CHECK(pt.get_line(20000) == "line 20000");
+
+    // a line start that lands exactly on a piece boundary still resolves
+    size_t line = 1;
+    for (size_t i = 0; i < text.length(); ++i)
+    {
+        if (text[i] != '\n')
+            continue;
+        ++line;
+        if (line % 997 == 0 || (i + 1) % (16 * 1024) == 0)
+            CHECK(pt.get_index_for_line(line) == i + 1);
+    }
+}
+
+TEST_CASE("piece_table: get_line_info", "[piecetable]")
+{
+    piece_table pt("first\nsecond\nthird");
+    pt.insert(8, "XX\nYY"); // "first\nseXX\nYYcond\nthird", lines now span several pieces
+
+    const std::string text = pt.to_string();
+    REQUIRE(text == "first\nseXX\nYYcond\nthird");
+
+    auto info = pt.get_line_info(1);
+    CHECK(info.start_byte == 0);
+    CHECK(info.length == 5);
+    CHECK(info.has_newline);
+
+    info = pt.get_line_info(2);
+    CHECK(info.start_byte == 6);
+    CHECK(info.length == 4);
+    CHECK(info.has_newline);
+
+    info = pt.get_line_info(3);
+    CHECK(info.start_byte == 11);
+    CHECK(info.length == 6);
+    CHECK(info.has_newline);
+    CHECK(pt.get_line(3) == "YYcond");
+
+    info = pt.get_line_info(4);
+    CHECK(info.start_byte == 18);
+    CHECK(info.length == 5);
+    CHECK_FALSE(info.has_newline);
+
+    info = pt.get_line_info(5);
+    CHECK(info.start_byte == pt.length());
+    CHECK(info.length == 0);
+
+    SECTION("Trailing newline leaves an empty last line")
+    {
+        pt.insert(pt.length(), "\n");
+        info = pt.get_line_info(5);
+        CHECK(info.start_byte == pt.length());
+        CHECK(info.length == 0);
+        CHECK_FALSE(info.has_newline);
+        CHECK(pt.get_line_length(4) == 5);
+    }
+
+    SECTION("Empty piece table")
+    {
+        piece_table pt_empty;
+        info = pt_empty.get_line_info(1);
+        CHECK(info.start_byte == 0);
+        CHECK(info.length == 0);
+        CHECK_FALSE(info.has_newline);
+    }
+}
+
+TEST_CASE("piece_table: get_line_col_for_index", "[piecetable]")
+{
+    piece_table pt("ab\ncd\n");
+    pt.insert(4, "xy\nz"); // "ab\ncxy\nzd\n", the second line spans three pieces
+    pt.insert(0, "\n");    // "\nab\ncxy\nzd\n"
+
+    const std::string text = pt.to_string();
+    size_t line = 1;
+    size_t col = 1;
+    for (size_t i = 0; i < text.length(); ++i)
+    {
+        const auto pos = pt.get_line_col_for_index(i);
+        CHECK(pos.line == line);
+        CHECK(pos.col == col);
+
+        if (text[i] == '\n')
+        {
+            ++line;
+            col = 1;
+        }
+        else
+            ++col;
+    }
+
+    // the end of the document is on the empty line after the trailing newline
+    auto pos = pt.get_line_col_for_index(text.length());
+    CHECK(pos.line == 5);
+    CHECK(pos.col == 1);
+    pos = pt.get_line_col_for_index(1000);
+    CHECK(pos.line == 5);
+
+    piece_table pt_empty;
+    pos = pt_empty.get_line_col_for_index(0);
+    CHECK(pos.line == 1);
+    CHECK(pos.col == 1);
+}
+
+TEST_CASE("piece_table: replace_all", "[piecetable]")
+{
+    // matches inside one piece, across pieces and at both ends
+    piece_table pt("foo bar foo\nba");
+    pt.insert(pt.length(), "r foo");
+    pt.insert(4, "f");
+    pt.insert(5, "oo ");          // "foo foo bar foo\nbar foo"
+    std::vector<size_t> matches; // every "foo"
+    const std::string before = pt.to_string();
+    for (size_t i = before.find("foo"); i != std::string::npos; i = before.find("foo", i + 3))
+        matches.push_back(i);
+    REQUIRE(matches.size() == 4);
+
+    CHECK(pt.replace_all(matches, 3, "a\nb") == 4);
+    CHECK(pt.to_string() == "a\nb a\nb bar a\nb\nbar a\nb");
+    CHECK(pt.get_line_count() == 6);
+    CHECK(pt.get_line(4) == "b");
+    CHECK(pt.get_line(5) == "bar a");
+
+    // an empty replacement deletes, overlapping and out of range positions are skipped
+    piece_table pt2("aaaaaa");
+    CHECK(pt2.replace_all({0, 1, 2, 5}, 2, "") == 2);
+    CHECK(pt2.to_string() == "aa");
+    CHECK(pt2.replace_all({}, 1, "x") == 0);
+    CHECK(pt2.replace_all({7}, 1, "x") == 0);
+    CHECK(pt2.to_string() == "aa");
+
+    // still editable afterwards
+    pt2.insert(1, "\n");
+    CHECK(pt2.to_string() == "a\na");
+    CHECK(pt2.get_line_count() == 2);
+}
+
+TEST_CASE("piece_table: apply_edits", "[piecetable]")
+{
+    piece_table pt("0123456789\nabcdefghij\n");
+    pt.insert(5, "XY"); // "01234XY56789\nabcdefghij\n"
+
+    // the same edits one at a time, back to front so the positions stay valid
+    std::string expected = pt.to_string();
+    const std::vector<AL::text_edit> edits = {
+        {.position = 0, .delete_length = 0, .insert_text = ">"},
+        {.position = 0, .delete_length = 2, .insert_text = "\n"}, // a second edit at the same position goes after the first
+        {.position = 6, .delete_length = 3, .insert_text = ""},   // across a piece boundary
+        {.position = 12, .delete_length = 4, .insert_text = "--"},
+        {.position = 24, .delete_length = 0, .insert_text = "end"},
+    };
+    for (auto it = edits.rbegin(); it != edits.rend(); ++it)
+        expected.replace(it->position, it->delete_length, it->insert_text);
+
+    REQUIRE(pt.apply_edits(edits));
+    CHECK(pt.to_string() == expected);
+    CHECK(pt.length() == expected.length());
+    CHECK(expected == ">\n234X789--defghij\nend");
+    CHECK(pt.get_line_count() == 3);
+    CHECK(pt.get_line(2) == "234X789--defghij");
+
+    // rejected batches change nothing
+    CHECK_FALSE(pt.apply_edits({{.position = 5, .delete_length = 1, .insert_text = ""}, {.position = 2, .delete_length = 0, .insert_text = "x"}}));
+    CHECK_FALSE(pt.apply_edits({{.position = 2, .delete_length = 3, .insert_text = ""}, {.position = 4, .delete_length = 0, .insert_text = "x"}}));
+    CHECK_FALSE(pt.apply_edits({{.position = 1000, .delete_length = 0, .insert_text = "x"}}));
+    CHECK(pt.to_string() == expected);
+    CHECK(pt.apply_edits({}));
+
+    // text taken from the add buffer itself is still right after the buffer grows under it
+    const std::string added = pt.get_add_buffer();
+    std::string grown;
+    for (int i = 0; i < 64; ++i)
+        grown += added;
+    REQUIRE(pt.apply_edits(std::vector<AL::text_edit>(64, {.position = 0, .delete_length = 0, .insert_text = pt.get_add_buffer()})));
+    CHECK(pt.to_string() == grown + expected);
+    pt.remove(0, grown.length());
+
+    // random batches against std::string
+    std::mt19937 rng(3);
+    for (int round = 0; round < 200; ++round)
+    {
+        std::vector<AL::text_edit> batch;
+        std::vector<std::string> texts(8);
+        size_t position = 0;
+        for (auto& text : texts)
+        {
+            position += rng() % 6;
+            if (position > expected.length())
+                break;
+            text = std::string(rng() % 3, static_cast<char>('a' + rng() % 26));
+            if (rng() % 4 == 0)
+                text += '\n';
+            const size_t remove = std::min<size_t>(rng() % 4, expected.length() - position);
+            batch.push_back({.position = position, .delete_length = remove, .insert_text = text});
+            position += remove;
+        }
+
+        for (auto it = batch.rbegin(); it != batch.rend(); ++it)
+            expected.replace(it->position, it->delete_length, it->insert_text);
+        REQUIRE(pt.apply_edits(batch));
+        REQUIRE(pt.to_string() == expected);
+        REQUIRE(pt.get_newline_count_before(pt.length()) == static_cast<size_t>(std::count(expected.begin(), expected.end(), '\n')));
+    }
+}
+
+TEST_CASE("piece_table: Anchors follow edits", "[piecetable][anchor_tree]")
+{
+    piece_table pt("alpha\nbeta\ngamma\n");
+    const AL::anchor_id beta = pt.add_anchor(6);
+    const AL::anchor_id gamma = pt.add_anchor(11);
+    const AL::anchor_id end = pt.add_anchor(1000); // clamped to the end
+
+    pt.insert(0, "new\n");
+    CHECK(pt.get_anchor_index(beta) == 10);
+    CHECK(pt.get_anchor_position(beta).line == 3);
+    CHECK(pt.get_anchor_position(gamma).line == 4);
+    CHECK(pt.get_anchor_index(end) == pt.length());
+
+    pt.remove(10, 5); // "beta\n"
+    CHECK(pt.get_anchor_index(beta) == 10);
+    CHECK(pt.get_anchor_position(gamma).line == 3);
+    CHECK(pt.get_anchor_position(gamma).col == 1);
+
+    CHECK(pt.replace_all({0, 4}, 3, "x") == 2); // "new" and "alp"
+    CHECK(pt.to_string() == "x\nxha\ngamma\n");
+    CHECK(pt.get_anchor_index(gamma) == 6);
+
+    REQUIRE(pt.apply_edits({{.position = 0, .delete_length = 2, .insert_text = ""}, {.position = 6, .delete_length = 0, .insert_text = ">>"}}));
+    CHECK(pt.to_string() == "xha\n>>gamma\n");
+    CHECK(pt.get_anchor_index(gamma) == 4); // right at the insert, so it stays before it
+    CHECK(pt.get_anchor_index(end) == pt.length());
+
+    pt.remove_anchor(beta);
+    CHECK(pt.get_anchor_position(gamma).line == 2);
+}
+
+TEST_CASE("piece_table: Copy, cut and paste ranges as pieces", "[piecetable]")
+{
+    piece_table pt("one\ntwo\nthree\n");
+    pt.insert(4, "2");
+
+    const AL::piece_range range = pt.copy_range(2, 7); // "e\n2two\n", cuts the first and last pieces
+    CHECK(range.length == 7);
+    CHECK(range.pieces.size() == 3);
+
+    REQUIRE(pt.paste_range(pt.length(), range));
+    CHECK(pt.to_string() == "one\n2two\nthree\ne\n2two\n");
+    CHECK(pt.get_newline_count_before(pt.length()) == 5);
+
+    // no bytes were copied, the pasted pieces point at the same text
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    REQUIRE(pieces.size() >= 3);
+    CHECK(pieces[pieces.size() - 2].start == range.pieces[1].start);
+    CHECK(pieces[pieces.size() - 2].buf_type == AL::buffer_type::ADD);
+
+    const AL::piece_range cut = pt.cut_range(0, 4);
+    CHECK(pt.to_string() == "2two\nthree\ne\n2two\n");
+    REQUIRE(pt.paste_range(5, cut));
+    CHECK(pt.to_string() == "2two\none\nthree\ne\n2two\n");
+
+    REQUIRE(pt.move_range(0, 5, 9)); // "2two\n" after "one\n"
+    CHECK(pt.to_string() == "one\n2two\nthree\ne\n2two\n");
+    CHECK_FALSE(pt.move_range(0, 5, 2)); // into itself
+    CHECK(pt.copy_range(100, 5).length == 0);
+
+    // ranges only paste into the buffers they came from
+    piece_table other("other");
+    CHECK_FALSE(other.paste_range(0, range));
+    pt.clear();
+    CHECK_FALSE(pt.paste_range(0, range));
+    CHECK(pt.length() == 0);
+}
+
+TEST_CASE("piece_table: Random copy and paste agree with a string", "[piecetable]")
+{
+    std::mt19937 rng(5);
+    std::string expected = "line one\nline two\n";
+    piece_table pt(expected);
+
+    for (int round = 0; round < 500; ++round)
+    {
+        const size_t position = rng() % (expected.length() + 1);
+        const size_t length = rng() % 40;
+        const size_t to = rng() % (expected.length() + 1);
+        switch (rng() % 3)
+        {
+            case 0:
+            {
+                const std::string text(1 + rng() % 5, static_cast<char>(rng() % 2 ? '\n' : 'a' + rng() % 26));
+                pt.insert(position, text);
+                expected.insert(position, text);
+                break;
+            }
+            case 1:
+            {
+                const AL::piece_range range = pt.copy_range(position, length);
+                REQUIRE(pt.paste_range(to, range));
+                expected.insert(to, expected.substr(position, length));
+                break;
+            }
+            default:
+            {
+                const size_t moved = std::min(length, expected.length() - position);
+                if (to > position && to < position + moved)
+                    break;
+                REQUIRE(pt.move_range(position, moved, to));
+                std::string text = expected.substr(position, moved);
+                expected.erase(position, moved);
+                expected.insert(to > position ? to - moved : to, text);
+                break;
+            }
+        }
+
+        REQUIRE(pt.to_string() == expected);
+        REQUIRE(pt.get_newline_count_before(pt.length()) == static_cast<size_t>(std::count(expected.begin(), expected.end(), '\n')));
+    }
+}
+
+// splits on '\n' the way sort_lines counts lines, sorts, and joins again
+static std::string sorted_lines(const std::string& text, bool unique)
+{
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < text.length())
+    {
+        const size_t newline = std::min(text.find('\n', start), text.length());
+        lines.push_back(text.substr(start, newline - start));
+        start = newline + 1;
+    }
+
+    std::sort(lines.begin(), lines.end());
+    if (unique)
+        lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+    std::string out;
+    for (size_t i = 0; i < lines.size(); ++i)
+        out += lines[i] + (i + 1 < lines.size() || text.back() == '\n' ? "\n" : "");
+    return out;
+}
+
+TEST_CASE("piece_table: sort_lines", "[piecetable][thread_pool]")
+{
+    AL::thread_pool pool(2);
+
+    piece_table pt("pear\napple\nfig\napple\n");
+    CHECK(pt.sort_lines(pool) == 4);
+    CHECK(pt.to_string() == "apple\napple\nfig\npear\n");
+    CHECK(pt.sort_lines(pool, true) == 3);
+    CHECK(pt.to_string() == "apple\nfig\npear\n");
+    CHECK(pt.get_line_count() == 3);
+
+    // no '\n' at the end, and lines that cross pieces
+    piece_table split("delta\nalpha\ncharlie");
+    split.insert(8, "XX");
+    split.insert(3, "\n\nb");
+    const AL::anchor_id end = split.add_anchor(split.length());
+    CHECK(split.sort_lines(pool) == 5);
+    CHECK(split.to_string() == "\nalXXpha\nbta\ncharlie\ndel");
+    CHECK(split.get_newline_count_before(split.length()) == 4);
+    CHECK(split.sort_lines(pool, true) == 5);
+    CHECK(split.get_anchor_index(end) == split.length());
+
+    piece_table empty;
+    CHECK(empty.sort_lines(pool) == 0);
+
+    // long shared prefixes and '\0' bytes, which the sort keys pad with
+    using namespace std::string_literals;
+    const std::string tricky = "shared prefix, longer than a key b\n"s + "shared prefix, longer than a key\0\n"s + "shared prefix, longer than a key\n"s +
+                               "shared prefix, longer than a key\0\0\n"s + "shared prefix\n"s + "shared prefix, longer than a key a\n"s;
+    piece_table nul(tricky);
+    nul.sort_lines(pool);
+    CHECK(nul.to_string() == sorted_lines(tricky, false));
+
+    // big enough for several partitions, fragmented by inserts, with lots of repeats
+    std::mt19937 rng(3);
+    std::string text;
+    while (text.length() < 3 * 1024 * 1024)
+        text += std::to_string(rng() % 100'000) + (rng() % 4 ? "\n" : " x\n");
+    piece_table big(text);
+    for (int i = 0; i < 2'000; ++i)
+    {
+        const size_t position = rng() % (text.length() + 1);
+        const std::string inserted = rng() % 2 ? "\n7" : "zz";
+        big.insert(position, inserted);
+        text.insert(position, inserted);
+    }
+
+    for (const bool unique : {false, true})
+    {
+        const std::string expected = sorted_lines(text, unique);
+        big.sort_lines(pool, unique);
+        text = expected;
+        REQUIRE(big.to_string() == expected);
+        REQUIRE(big.get_newline_count_before(big.length()) == static_cast<size_t>(std::count(expected.begin(), expected.end(), '\n')));
+    }
+
+    // in a CRLF document the '\r' is part of the line break, not of the line: '\t' sorts below it, and a last line without
+    // a break is the same line as one with "\r\n"
+    piece_table crlf("a\tz\r\nb\r\na\r\nb");
+    CHECK(crlf.sort_lines(pool) == 4);
+    CHECK(crlf.to_string() == "a\r\na\tz\r\nb\r\nb");
+    CHECK(crlf.sort_lines(pool, true) == 3);
+    CHECK(crlf.to_string() == "a\r\na\tz\r\nb");
+    CHECK(crlf.get_line(3) == "b");
+
+    // and sorts like the same text with "\n", lines crossing pieces included
+    const auto to_crlf = [](const std::string& lf) {
+        std::string out;
+        for (char c : lf)
+            out += c == '\n' ? std::string("\r\n") : std::string(1, c);
+        return out;
+    };
+    std::string lf = "9\n";
+    while (lf.length() < 3 * 1024 * 1024)
+        lf += std::to_string(rng() % 100'000) + (rng() % 4 ? "\n" : "\tx\n");
+    piece_table big_crlf(to_crlf(lf));
+    for (int i = 0; i < 200; ++i)
+    {
+        const size_t position = rng() % (lf.length() + 1);
+        big_crlf.insert(position + static_cast<size_t>(std::count(lf.begin(), lf.begin() + static_cast<std::ptrdiff_t>(position), '\n')), "\n7");
+        lf.insert(position, "\n7");
+    }
+    for (const bool unique : {false, true})
+    {
+        big_crlf.sort_lines(pool, unique);
+        lf = sorted_lines(lf, unique);
+        REQUIRE(big_crlf.to_string() == to_crlf(lf));
+    }
+}
+
+TEST_CASE("piece_table: Loading in parallel", "[piecetable][thread_pool]")
+{
+    AL::thread_pool pool(3);
+    AL::thread_pool alone(0);
+
+    // several partitions, with '\r' on both sides of the piece boundaries they start on. the first line makes it an LF document
+    std::mt19937 rng(5);
+    std::string text = "first\n";
+    while (text.length() < 9 * 1024 * 1024)
+        text += std::to_string(rng()) + (rng() % 3 ? "\n" : "\r\n");
+    text[16 * 1024 - 1] = '\r';
+    text[16 * 1024] = '\r';
+    std::string expected = text;
+    expected.erase(std::remove(expected.begin(), expected.end(), '\r'), expected.end());
+    const auto newlines = static_cast<size_t>(std::count(expected.begin(), expected.end(), '\n'));
+
+    piece_table parallel(text, pool);
+    piece_table serial(text, alone);
+    for (piece_table* pt : {&parallel, &serial})
+    {
+        REQUIRE(pt->to_string() == expected);
+        CHECK(pt->get_newline_count_before(pt->length()) == newlines);
+        CHECK(pt->get_line_count() == newlines); // it ends in '\n'
+    }
+    CHECK(parallel.get_line(1000) == serial.get_line(1000));
+
+    // without '\r' the pieces are the ones a single pass cuts, whatever the partitions
+    std::vector<AL::piece> expected_pieces;
+    piece_table::cut_original(expected.data(), 0, expected.length(), expected_pieces);
+    std::vector<AL::piece> pieces;
+    CHECK(piece_table::load_original(expected.data(), 0, expected.length(), AL::line_ending::LF, pool, pieces) == 0);
+    REQUIRE(pieces.size() == expected_pieces.size());
+    for (size_t i = 0; i < pieces.size(); ++i)
+    {
+        REQUIRE(pieces[i].start == expected_pieces[i].start);
+        REQUIRE(pieces[i].length == expected_pieces[i].length);
+        REQUIRE(pieces[i].newline_count == expected_pieces[i].newline_count);
+    }
+
+    piece_table empty(std::string(), pool);
+    CHECK(empty.length() == 0);
+    CHECK(empty.to_string().empty());
+}
+
+TEST_CASE("piece_table: get_changed_ranges", "[piecetable]")
+{
+    piece_table pt("0123456789abcdef");
+    std::vector<AL::text_range> ranges;
+    CHECK(pt.get_changed_ranges(ranges));
+    CHECK(ranges.empty());
+
+    pt.remove(2, 2);
+    pt.insert(2, "XY");
+    pt.remove(10, 1);
+    pt.insert(10, "Z");
+    pt.insert(11, "W"); // next to the last change
+    pt.remove(12, 1);
+    REQUIRE(pt.get_changed_ranges(ranges));
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].start == 2);
+    CHECK(ranges[0].length == 2);
+    CHECK(ranges[1].start == 10);
+    CHECK(ranges[1].length == 2);
+
+    // the same bytes moved somewhere else are changed too
+    pt.move_range(0, 2, 16);
+    REQUIRE(pt.get_changed_ranges(ranges));
+    REQUIRE(ranges.size() == 1);
+    CHECK(ranges[0].start == 0);
+    CHECK(ranges[0].length == 16);
+
+    pt.insert(0, "+");
+    CHECK_FALSE(pt.get_changed_ranges(ranges));
+}
+
+#if MINIEDITOR_POSIX_IO
+TEST_CASE("piece_table: write_to_fd", "[piecetable]")
+{
+    // more pieces than one writev takes
+    std::string expected = "original text\n";
+    piece_table pt(expected);
+    std::mt19937 rng(9);
+    for (int i = 0; i < 5'000; ++i)
+    {
+        const size_t position = rng() % (expected.length() + 1);
+        const std::string text(1 + rng() % 3, static_cast<char>('a' + i % 26));
+        pt.insert(position, text);
+        expected.insert(position, text);
+    }
+
+    const auto path = std::filesystem::temp_directory_path() / "test_write_to_fd.txt";
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    REQUIRE(fd >= 0);
+    CHECK(pt.write_to_fd(fd));
+    ::close(fd);
+
+    std::ifstream ifs(path, std::ios::binary);
+    CHECK(std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>()) == expected);
+    std::filesystem::remove(path);
+
+    CHECK_FALSE(pt.write_to_fd(-1));
+}
+
+TEST_CASE("piece_table: write_to_fd copies from the original file", "[piecetable]")
+{
+    // long untouched stretches between the edits come from the source file, the rest from memory
+    std::string original;
+    for (int i = 0; original.length() < 600'000; ++i)
+        original += "line " + std::to_string(i) + "\n";
+    const auto source_path = std::filesystem::temp_directory_path() / "test_write_to_fd_source.txt";
+    {
+        std::ofstream ofs(source_path, std::ios::binary);
+        ofs << original;
+    }
+
+    std::string expected = original;
+    piece_table pt(original);
+    std::mt19937 rng(11);
+    for (int i = 0; i < 20; ++i)
+    {
+        const size_t position = rng() % (expected.length() + 1);
+        const std::string text(1 + rng() % 5, static_cast<char>('a' + i));
+        pt.insert(position, text);
+        expected.insert(position, text);
+    }
+    pt.remove(300'000, 1000);
+    expected.erase(300'000, 1000);
+
+    const int source_fd = ::open(source_path.c_str(), O_RDONLY);
+    REQUIRE(source_fd >= 0);
+    const auto path = std::filesystem::temp_directory_path() / "test_write_to_fd_copy.txt";
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    REQUIRE(fd >= 0);
+    CHECK(pt.write_to_fd(fd, source_fd));
+    ::close(fd);
+    ::close(source_fd);
+
+    std::ifstream ifs(path, std::ios::binary);
+    CHECK(std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>()) == expected);
+    std::filesystem::remove(path);
+    std::filesystem::remove(source_path);
+}
+TEST_CASE("piece_table: A frozen document outlives later edits", "[piecetable]")
+{
+    piece_table pt("hello world\n");
+    pt.insert(5, ",");
+    const std::string expected = pt.to_string();
+    const AL::frozen_document frozen = pt.freeze();
+    CHECK(frozen.length == expected.length());
+    const char* add = frozen.add.data();
+
+    // enough to grow the add buffer many times over, through every way in
+    for (int i = 0; i < 2'000; ++i)
+        pt.insert(pt.length(), "more text " + std::to_string(i) + "\n");
+    REQUIRE(pt.apply_edits({{.position = 0, .delete_length = 1, .insert_text = std::string(100'000, 'H')}}));
+    pt.replace_all({0}, 1, std::string(50'000, 'J'));
+    CHECK(pt.get_add_buffer().data() != add);
+
+    std::string text;
+    for (const AL::piece& p : frozen.pieces)
+        text.append((p.buf_type == AL::buffer_type::ORIGINAL ? frozen.original : frozen.add).substr(p.start, p.length));
+    CHECK(text == expected);
+
+    const auto path = std::filesystem::temp_directory_path() / "test_write_frozen.txt";
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    REQUIRE(fd >= 0);
+    std::atomic<size_t> written{0};
+    CHECK(piece_table::write_frozen(fd, frozen, -1, written));
+    ::close(fd);
+    CHECK(written == expected.length());
+    std::ifstream ifs(path, std::ios::binary);
+    CHECK(std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>()) == expected);
+    std::filesystem::remove(path);
+
+    pt.thaw();
+    CHECK(pt.to_string().starts_with(std::string(50'000, 'J')));
+}
+#endif // MINIEDITOR_POSIX_IO
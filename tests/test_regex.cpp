@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <editor.h>
+#include <piecetable.h>
+#include <random>
+#include <regex.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+using piece_table = AL::piece_table;
+
+// text cut at random points into pieces of 1-7 bytes. they are inserted back to front, so no piece
+// continues the one before it in the add buffer and the DFA has to carry its state across every cut
+static piece_table make_split_randomly(const std::string& text, unsigned seed = 11)
+{
+    std::mt19937 rng(seed);
+    std::vector<size_t> cuts = {0};
+    while (cuts.back() < text.length())
+        cuts.push_back(std::min(text.length(), cuts.back() + 1 + rng() % 7));
+
+    piece_table pt;
+    for (size_t i = cuts.size() - 1; i > 0; --i)
+        pt.insert(0, text.substr(cuts[i - 1], cuts[i] - cuts[i - 1]));
+    return pt;
+}
+
+// [begin, end) of every non overlapping match, as std::regex sees them
+static std::vector<std::pair<size_t, size_t>> std_find_all(const std::string& text, const std::string& pattern)
+{
+    std::vector<std::pair<size_t, size_t>> out;
+    const std::regex re(pattern);
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), re); it != std::sregex_iterator(); ++it)
+        out.emplace_back(it->position(), it->position() + it->length());
+    return out;
+}
+
+TEST_CASE("regex: Rejects malformed patterns", "[regex]")
+{
+    for (const char* pattern : {"(", "(ab", "ab)", "[ab", "*a", "a|+", "a{3,1}", "a{1001}", "\\q", "\\x4", "[z-a]", "a\\"})
+    {
+        const AL::regex re(pattern);
+        CHECK_FALSE(re.is_valid());
+        CHECK_FALSE(re.get_error().empty());
+
+        const piece_table pt(std::string("anything"));
+        CHECK(re.find_next(pt, 0).begin == AL::regex::npos);
+    }
+
+    // a '{' that is not a repeat is just a byte
+    const AL::regex brace("a{2");
+    REQUIRE(brace.is_valid());
+    const piece_table pt(std::string("xa{2"));
+    CHECK(brace.find_next(pt, 0).begin == 1);
+}
+
+TEST_CASE("regex: Agrees with std::regex across piece boundaries", "[regex]")
+{
+    const std::string text = "foo foobar foobarbaz 12.50 and 7. abcd x@y.com <a><bb> aaaa\n"
+                             "the quick brown fox 0042 jumps over the lazy dog\n"
+                             "mail: bob@example.com, alice@test.com; zzz xyz abab ab\n";
+    const piece_table pt = make_split_randomly(text);
+    REQUIRE(pt.to_string() == text);
+    std::vector<AL::piece> pieces;
+    pt.get_pieces(pieces);
+    REQUIRE(pieces.size() > text.length() / 7);
+
+    for (const std::string pattern : {"a", "ab|cd", "[0-9]+", "\\d+\\.\\d*", "(foo|foobar)baz", "foo(bar)?", "(a|ab)(c|bcd)",
+                                      "[^ \\n]+", "\\w+@\\w+\\.com", "o.*z", "a{2,3}", "(?:ab){2}", "<.+>", "<.+?>", "x*", "(ab)*", "\\s\\S",
+                                      "[a-c]+d", "b+?", "q[^u]", "\\x61\\x62"})
+    {
+        const AL::regex re(pattern);
+        REQUIRE(re.is_valid());
+        const std::regex oracle(pattern);
+
+        for (size_t from = 0; from <= text.length(); from += 3)
+        {
+            std::smatch m;
+            const auto flags = from > 0 ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+            const bool found = std::regex_search(text.begin() + static_cast<std::ptrdiff_t>(from), text.end(), m, oracle, flags);
+
+            const AL::regex_match match = re.find_next(pt, from);
+            INFO("pattern " << pattern << " from " << from);
+            if (!found)
+            {
+                CHECK(match.begin == AL::regex::npos);
+                continue;
+            }
+            CHECK(match.begin == from + static_cast<size_t>(m.position()));
+            CHECK(match.end == match.begin + static_cast<size_t>(m.length()));
+        }
+
+        // std::regex retries an empty match in place, so only compare the ones that cannot be empty
+        if (pattern != "x*" && pattern != "(ab)*")
+        {
+            std::vector<AL::regex_match> all;
+            re.find_all(pt, 0, pt.length(), all);
+            const auto expected = std_find_all(text, pattern);
+            REQUIRE(all.size() == expected.size());
+            for (size_t i = 0; i < all.size(); ++i)
+            {
+                CHECK(all[i].begin == expected[i].first);
+                CHECK(all[i].end == expected[i].second);
+            }
+            CHECK(re.count(pt, 0, pt.length()) == expected.size());
+        }
+    }
+}
+
+TEST_CASE("regex: Line anchors and positions", "[regex]")
+{
+    const std::string text = "foo bar\nfoo\n\nbarfoo\nfoo";
+    const piece_table pt = make_split_randomly(text);
+
+    auto begins = [&pt](const char* pattern, size_t begin = 0, size_t end = SIZE_MAX) {
+        std::vector<size_t> out;
+        std::vector<AL::regex_match> all;
+        AL::regex(pattern).find_all(pt, begin, end, all);
+        for (const auto& m : all)
+            out.push_back(m.begin);
+        return out;
+    };
+
+    CHECK(begins("^foo") == std::vector<size_t>{0, 8, 20});
+    CHECK(begins("foo$") == std::vector<size_t>{8, 16, 20});
+    CHECK(begins("^foo$") == std::vector<size_t>{8, 20});
+    CHECK(begins("^$") == std::vector<size_t>{12});
+    CHECK(begins("^\\w+$") == std::vector<size_t>{8, 13, 20});
+    CHECK(begins("r$\\n^f") == std::vector<size_t>{6});
+    CHECK(begins("o\\n^f") == std::vector<size_t>{18}); // not 10, an empty line follows it
+
+    // a range that starts mid line does not make its first byte a line start
+    CHECK(begins("^oo", 1) == std::vector<size_t>{});
+    CHECK(begins("fo$", 0, 10) == std::vector<size_t>{});
+
+    std::vector<AL::regex_match> all;
+    AL::regex("bar").find_all(pt, 0, pt.length(), all);
+    REQUIRE(all.size() == 2);
+    CHECK(all[0].position.line == 1);
+    CHECK(all[0].position.col == 5);
+    CHECK(all[1].position.line == 4);
+    CHECK(all[1].position.col == 1);
+
+    // empty matches are reported once per position
+    CHECK(AL::regex("x*").count(pt, 0, 3) == 4);
+    CHECK(AL::regex("^").count(pt, 0, pt.length()) == 5);
+}
+
+TEST_CASE("regex: find_prev", "[regex]")
+{
+    const piece_table pt = make_split_randomly("ab12 cd345 ef6\ngh78");
+    const AL::regex digits("\\d+");
+
+    CHECK(digits.find_prev(pt, pt.length()).begin == 17);
+    CHECK(digits.find_prev(pt, 17).begin == 13);
+    CHECK(digits.find_prev(pt, 10).begin == 7);
+    CHECK(digits.find_prev(pt, 9).begin == 7); // the document is cut at 9, which leaves "34"
+    CHECK(digits.find_prev(pt, 9).end == 9);
+    CHECK(digits.find_prev(pt, 2).begin == AL::regex::npos);
+
+    const AL::regex_match last = digits.find_prev(pt, pt.length());
+    CHECK(last.end == 19);
+    CHECK(last.position.line == 2);
+    CHECK(last.position.col == 3);
+
+    // far enough back that the window has to grow
+    std::string big = "needle 1";
+    big += std::string(300'000, 'x');
+    const piece_table large(big);
+    CHECK(AL::regex("needle \\d").find_prev(large, large.length()).begin == 0);
+}
+
+TEST_CASE("regex: The DFA cache is rebuilt when it fills up", "[regex]")
+{
+    // while looking for a match, the DFA tracks which of the last 13 bytes were an 'a'.
+    // that is 2^13 states, twice what the cache holds
+    std::mt19937 rng(7);
+    std::string text(40'000, 'a');
+    for (size_t i = 0; i < text.length(); ++i)
+        text[i] = i % 997 == 996 ? 'c' : ((rng() & 1) ? 'a' : 'b');
+    const piece_table pt = make_split_randomly(text);
+
+    const std::string pattern = "a[ab]{12}c";
+    std::vector<AL::regex_match> all;
+    AL::regex(pattern).find_all(pt, 0, pt.length(), all);
+
+    const auto expected = std_find_all(text, pattern);
+    REQUIRE(all.size() == expected.size());
+    bool same = true;
+    for (size_t i = 0; i < all.size(); ++i)
+        same = same && all[i].begin == expected[i].first && all[i].end == expected[i].second;
+    CHECK(same);
+}
+
+TEST_CASE("Editor: Regex find next and previous", "[editor][regex]")
+{
+    AL::editor ed;
+    ed.insert_text("id=17\nname=x\nid=2048\n");
+    ed.move_to_document_start();
+
+    const AL::regex id("^id=\\d+$");
+    REQUIRE(ed.find_next(id));
+    CHECK(ed.get_cursor_row() == 3);
+    CHECK(ed.get_cursor_col() == 1);
+
+    REQUIRE(ed.find_next(id)); // wraps
+    CHECK(ed.get_cursor_row() == 1);
+
+    REQUIRE(ed.find_prev(id)); // wraps back
+    CHECK(ed.get_cursor_row() == 3);
+
+    CHECK_FALSE(ed.find_next(AL::regex("id=\\d{5}")));
+    CHECK(ed.get_cursor_row() == 3);
+}
@@ -0,0 +1,170 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <editor.h>
+#include <piecetable.h>
+#include <search.h>
+#include <string>
+#include <thread_pool.h>
+#include <vector>
+
+using piece_table = AL::piece_table;
+using searcher = AL::searcher;
+
+// every match of pattern in text, overlapping or not, found the slow way
+static std::vector<size_t> naive_find_all(const std::string& text, const std::string& pattern)
+{
+    std::vector<size_t> out;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+        out.push_back(pos);
+    return out;
+}
+
+// a document where every few bytes live in their own piece
+static piece_table make_fragmented(const std::string& text)
+{
+    piece_table pt;
+    for (size_t i = 0; i < text.length(); i += 3)
+        pt.insert(pt.length(), text.substr(i, 3));
+    return pt;
+}
+
+TEST_CASE("searcher: Contiguous buffers", "[search]")
+{
+    const std::string text = "the quick brown fox jumps over the lazy dog, the end. xthex";
+
+    for (const std::string pattern : {"t", "th", "the", "the lazy dog", "x", "dog, the end. xthex", "missing", "fox jumps over the lazy dog, the end."})
+    {
+        const searcher search(pattern);
+        const auto expected = naive_find_all(text, pattern);
+        const size_t first = expected.empty() ? searcher::npos : expected.front();
+        const size_t last = expected.empty() ? searcher::npos : expected.back();
+        CHECK(search.find_in(text.data(), text.length()) == first);
+        CHECK(search.rfind_in(text.data(), text.length()) == last);
+    }
+
+    const searcher empty("");
+    CHECK(empty.find_in(text.data(), text.length()) == searcher::npos);
+    CHECK(searcher("longer than the text itself").find_in("short", 5) == searcher::npos);
+}
+
+TEST_CASE("searcher: Matches across piece boundaries", "[search]")
+{
+    std::string text;
+    for (int i = 0; i < 200; ++i)
+        text += "abcab" + std::to_string(i % 13) + "\n";
+
+    const piece_table pt = make_fragmented(text);
+    REQUIRE(pt.to_string() == text);
+
+    for (const std::string pattern : {"a", "ab", "cab", "abcab1", "b1\nabcab", "\nabcab12\nabcab0"})
+    {
+        const searcher search(pattern);
+        const auto expected = naive_find_all(text, pattern);
+        REQUIRE_FALSE(expected.empty());
+
+        // find_next / find_prev from every offset
+        for (size_t from = 0; from <= text.length(); from += 7)
+        {
+            const size_t pos = text.find(pattern, from);
+            CHECK(search.find_next(pt, from) == (pos == std::string::npos ? searcher::npos : pos));
+
+            const size_t rpos = from == 0 ? std::string::npos : text.rfind(pattern, from - 1);
+            CHECK(search.find_prev(pt, from) == (rpos == std::string::npos ? searcher::npos : rpos));
+        }
+
+        // find_all skips overlapping matches
+        std::vector<size_t> non_overlapping;
+        for (size_t pos : expected)
+        {
+            if (non_overlapping.empty() || pos >= non_overlapping.back() + pattern.length())
+                non_overlapping.push_back(pos);
+        }
+
+        std::vector<size_t> all;
+        search.find_all(pt, 0, pt.length(), all);
+        CHECK(all == non_overlapping);
+    }
+}
+
+TEST_CASE("searcher: find_all respects the range", "[search]")
+{
+    const piece_table pt = make_fragmented("aaaa-aaaa-aaaa");
+    const searcher search("aa");
+
+    std::vector<size_t> all;
+    search.find_all(pt, 1, 9, all); // "aaa-aaaa"
+    CHECK(all == std::vector<size_t>{1, 5, 7});
+
+    all.clear();
+    search.find_all(pt, 0, 1000, all);
+    CHECK(all == std::vector<size_t>{0, 2, 5, 7, 10, 12});
+}
+
+TEST_CASE("searcher: Parallel search matches the single threaded one", "[search][thread_pool]")
+{
+    // self overlapping pattern on a document that spans several partitions,
+    // so a match is bound to cross a partition seam
+    std::string text(3 * 1024 * 1024 + 17, 'a');
+    for (size_t i = 5; i < text.length(); i += 100'003)
+        text[i] = 'b';
+    piece_table pt(text);
+    pt.insert(1024 * 1024 - 1, "aaaa"); // fragment it a little
+
+    AL::thread_pool pool(2);
+    for (const std::string pattern : {"aaa", "ab", "ba", "aaaaaaaaab", "zzz"})
+    {
+        const searcher search(pattern);
+
+        std::vector<size_t> sequential;
+        search.find_all(pt, 0, pt.length(), sequential);
+
+        // compared as a bool, printing a million offsets on failure takes forever
+        std::vector<size_t> parallel;
+        search.find_all(pt, 0, pt.length(), parallel, pool);
+        CHECK(parallel.size() == sequential.size());
+        CHECK((parallel == sequential));
+        CHECK(search.count(pt, 0, pt.length(), pool) == sequential.size());
+        CHECK(search.count(pt, 0, pt.length()) == sequential.size());
+
+        // a sub range
+        sequential.clear();
+        parallel.clear();
+        search.find_all(pt, 12345, 2'500'000, sequential);
+        search.find_all(pt, 12345, 2'500'000, parallel, pool);
+        CHECK((parallel == sequential));
+    }
+}
+
+TEST_CASE("Editor: Find next and previous", "[editor][search]")
+{
+    AL::editor ed;
+    ed.insert_text("one two\nthree two\ntwo");
+    ed.move_to_document_start();
+
+    REQUIRE(ed.find_next("two"));
+    CHECK(ed.get_cursor_row() == 1);
+    CHECK(ed.get_cursor_col() == 5);
+
+    REQUIRE(ed.find_next("two"));
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 7);
+
+    REQUIRE(ed.find_next("two"));
+    CHECK(ed.get_cursor_row() == 3);
+    CHECK(ed.get_cursor_col() == 1);
+
+    REQUIRE(ed.find_next("two")); // wraps
+    CHECK(ed.get_cursor_row() == 1);
+    CHECK(ed.get_cursor_col() == 5);
+
+    REQUIRE(ed.find_prev("two")); // wraps back
+    CHECK(ed.get_cursor_row() == 3);
+    CHECK(ed.get_cursor_col() == 1);
+
+    REQUIRE(ed.find_prev("two"));
+    CHECK(ed.get_cursor_row() == 2);
+
+    CHECK_FALSE(ed.find_next("four"));
+    CHECK(ed.get_cursor_row() == 2);
+    CHECK(ed.get_cursor_col() == 7);
+}
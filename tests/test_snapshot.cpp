@@ -0,0 +1,113 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <piecetable.h>
+#include <random>
+#include <snapshot.h>
+#include <string>
+#include <vector>
+
+static AL::piece_table make_edited(const std::string& original, int edits)
+{
+    AL::piece_table pt(original);
+    std::mt19937 rng(3);
+    for (int i = 0; i < edits; ++i)
+    {
+        const size_t position = rng() % (pt.length() + 1);
+        if (rng() % 3 != 0 || position == pt.length())
+            pt.insert(position, std::string(1 + rng() % 6, static_cast<char>(i % 2 ? '\n' : 'a' + i % 26)));
+        else
+            pt.remove(position, 1 + rng() % std::min<size_t>(10, pt.length() - position));
+    }
+    return pt;
+}
+
+TEST_CASE("snapshot: Round trip restores pieces, lines and cursor", "[snapshot]")
+{
+    std::string original;
+    for (int i = 0; i < 5000; ++i)
+        original += "row " + std::to_string(i) + "\n";
+    const AL::piece_table pt = make_edited(original, 2000);
+    const auto path = std::filesystem::temp_directory_path() / "test_snapshot.session";
+    REQUIRE(AL::write_snapshot(path, pt, original.size(), 77, false, 1234));
+
+    std::string file_bytes = original;
+    AL::piece_table restored;
+    AL::snapshot_header header;
+    REQUIRE(AL::read_snapshot(path, file_bytes, original.size(), 77, restored, header));
+    CHECK(header.cursor == 1234);
+    CHECK(header.original_embedded == 0);
+    CHECK(restored.to_string() == pt.to_string());
+    CHECK(restored.get_line_count() == pt.get_line_count());
+    CHECK(restored.get_line(100) == pt.get_line(100));
+
+    std::vector<AL::piece> before;
+    std::vector<AL::piece> after;
+    pt.get_pieces(before);
+    restored.get_pieces(after);
+    CHECK(after.size() == before.size());
+
+    // still editable like any other table
+    restored.insert(0, "head\n");
+    CHECK(restored.get_line(1) == "head");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("snapshot: Stale or damaged snapshots are refused", "[snapshot]")
+{
+    const std::string original(100'000, 'x');
+    const AL::piece_table pt = make_edited(original, 200);
+    const auto path = std::filesystem::temp_directory_path() / "test_snapshot_stale.session";
+    REQUIRE(AL::write_snapshot(path, pt, original.size(), 5, false, 0));
+
+    AL::piece_table restored;
+    AL::snapshot_header header;
+    std::string file_bytes = original;
+    CHECK_FALSE(AL::read_snapshot(path, file_bytes, original.size(), 6, restored, header)); // touched since
+    CHECK(file_bytes == original);
+
+    std::string changed = original;
+    changed[0] = 'y'; // in a sampled block
+    CHECK_FALSE(AL::read_snapshot(path, changed, original.size(), 5, restored, header));
+    CHECK(restored.length() == 0);
+
+    // a flipped byte in the piece array
+    {
+        std::fstream fs(path, std::ios::binary | std::ios::in | std::ios::out);
+        fs.seekp(static_cast<std::streamoff>(sizeof(AL::snapshot_header) + 8));
+        fs.put('\x7f');
+    }
+    CHECK_FALSE(AL::read_snapshot(path, file_bytes, original.size(), 5, restored, header));
+    CHECK(file_bytes == original);
+
+    CHECK_FALSE(AL::read_snapshot(path.string() + ".missing", file_bytes, original.size(), 5, restored, header));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("snapshot: An embedded original does not need the file", "[snapshot]")
+{
+    AL::piece_table pt("one\ntwo\r\n"); // an LF document, so the buffer is not the file's bytes
+    pt.insert(4, "1.5\n");
+    const auto path = std::filesystem::temp_directory_path() / "test_snapshot_embedded.session";
+    REQUIRE(AL::write_snapshot(path, pt, 9, 9, true, 4));
+
+    std::string file_bytes = "one\ntwo\r\n";
+    AL::piece_table restored;
+    AL::snapshot_header header;
+    REQUIRE(AL::read_snapshot(path, file_bytes, 9, 9, restored, header));
+    CHECK(header.original_embedded == 1);
+    CHECK(restored.to_string() == "one\n1.5\ntwo\n");
+    CHECK(file_bytes == "one\ntwo\r\n");
+    std::filesystem::remove(path);
+
+    // a CRLF document comes back as one, and goes on inserting "\r\n"
+    AL::piece_table crlf("one\r\ntwo\r\n");
+    crlf.insert(5, "1.5\n");
+    REQUIRE(AL::write_snapshot(path, crlf, 10, 9, true, 0));
+    REQUIRE(AL::read_snapshot(path, file_bytes, 10, 9, restored, header));
+    CHECK(restored.get_line_ending() == AL::line_ending::CRLF);
+    restored.insert(restored.length(), "\n");
+    CHECK(restored.to_string() == "one\r\n1.5\r\ntwo\r\n\r\n");
+    std::filesystem::remove(path);
+}
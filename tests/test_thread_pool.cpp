@@ -0,0 +1,24 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <thread_pool.h>
+#include <vector>
+
+TEST_CASE("thread_pool: Runs every task exactly once", "[thread_pool]")
+{
+    for (size_t workers : {0, 1, 3})
+    {
+        AL::thread_pool pool(workers);
+        CHECK(pool.concurrency() == workers + 1);
+
+        // several jobs in a row reuse the same workers
+        for (size_t count : {0, 1, 7, 1000})
+        {
+            std::vector<std::atomic<int>> hits(count);
+            pool.run(count, [&hits](size_t i) { hits[i].fetch_add(1); });
+
+            for (auto& h : hits)
+                CHECK(h.load() == 1);
+        }
+    }
+}